@@ -0,0 +1,311 @@
+#include "AsyncLog.h"
+#include "ThreadConfig.h"
+
+#include <ctime>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+  const auto POLL_INTERVAL = std::chrono::milliseconds(2); // the drain thread's sleep with nothing to do
+  const double RATE_LIMIT_WINDOW_SEC = 1;
+  const std::uint32_t RATE_LIMIT_LINES = 10; // of each format per window
+
+  std::size_t roundUpToPowerOf2(const std::size_t n)
+  {
+    std::size_t power = 1;
+
+    while (power < n)
+    {
+      power <<= 1;
+    }
+
+    return power;
+  }
+
+  void appendTimestamp(std::string &line, const double unixSec)
+  {
+    const std::time_t seconds = unixSec;
+    const int millis = (unixSec - seconds)*1e3;
+    std::tm local;
+    char stamp[32];
+
+    localtime_r(&seconds, &local);
+
+    const std::size_t length = std::strftime(stamp, sizeof(stamp), "%H:%M:%S", &local);
+    snprintf(stamp + length, sizeof(stamp) - length, ".%03d ", millis);
+
+    line += stamp;
+  }
+}
+
+void LogRecord::addText(const char* value, const std::size_t length)
+{
+  LogArg &arg = args[numArgs++];
+
+  arg.type = LogArg::TEXT;
+
+  // Once the text is full every further string is the empty one its last
+  // byte, the '\0' of the string before, already holds
+  if (textLength >= LOG_TEXT_BYTES)
+  {
+    arg.textOffset = LOG_TEXT_BYTES - 1;
+    return;
+  }
+
+  const std::size_t copied = std::min(length, LOG_TEXT_BYTES - 1 - textLength);
+
+  arg.textOffset = textLength;
+
+  std::memcpy(&text[textLength], value, copied);
+  textLength += copied;
+  text[textLength++] = '\0';
+}
+
+AsyncLog::AsyncLog(const std::size_t capacity) :
+  cells(roundUpToPowerOf2(capacity)),
+  mask(cells.size() - 1),
+  enqueuePos(0),
+  dequeuePos(0),
+  dropped(0),
+  flushRequested(false),
+  stopping(false),
+  startTicks(readTsc()),
+  startUnixSec(std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count()),
+  droppedReported(0)
+{
+  for (std::size_t ii = 0; ii < cells.size(); ii++)
+  {
+    cells[ii].sequence.store(ii, std::memory_order_relaxed);
+  }
+
+  // Calibrated here rather than by the first record's timestamp
+  tscSecondsPerTick();
+
+  drainer = std::thread(&AsyncLog::run, this);
+}
+
+AsyncLog::~AsyncLog()
+{
+  stopping = true;
+  drainer.join();
+}
+
+// A bounded queue with a sequence number in every cell (Vyukov's): a
+// producer claims the next position with one compare-exchange and publishes
+// the record by advancing the cell's sequence, so producers on different
+// threads never wait on each other or on the drain thread
+bool AsyncLog::push(const LogRecord &record)
+{
+  std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+  while (true)
+  {
+    Cell &cell = cells[pos & mask];
+    const std::intptr_t diff = std::intptr_t(cell.sequence.load(std::memory_order_acquire)) - std::intptr_t(pos);
+
+    if (diff == 0)
+    {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        cell.record = record;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    else
+    {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// Only ever called from the drain thread
+bool AsyncLog::pop(LogRecord &record)
+{
+  const std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+  Cell &cell = cells[pos & mask];
+
+  if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+  {
+    return false;
+  }
+
+  record = cell.record;
+  cell.sequence.store(pos + cells.size(), std::memory_order_release);
+  dequeuePos.store(pos + 1, std::memory_order_release);
+
+  return true;
+}
+
+void AsyncLog::flush()
+{
+  const std::size_t target = enqueuePos.load(std::memory_order_acquire);
+
+  flushRequested = true;
+
+  while (flushRequested || dequeuePos.load(std::memory_order_acquire) < target)
+  {
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+}
+
+double AsyncLog::toUnixSec(const std::uint64_t ticks) const
+{
+  return startUnixSec + std::int64_t(ticks - startTicks)*tscSecondsPerTick();
+}
+
+void AsyncLog::run()
+{
+  LogRecord record;
+  std::string batch;
+
+  applyBackgroundPlacement("Log");
+
+  while (true)
+  {
+    // Everything already queued goes out in one write
+    const bool finalPass = stopping;
+    const bool flushing = flushRequested;
+
+    while (pop(record))
+    {
+      print(record, batch);
+    }
+
+    const std::uint64_t droppedNow = dropped.load(std::memory_order_relaxed);
+
+    if (droppedNow != droppedReported)
+    {
+      appendTimestamp(batch, toUnixSec(readTsc()));
+      batch += "Log queue full, " + std::to_string(droppedNow - droppedReported) + " messages dropped\n";
+      droppedReported = droppedNow;
+    }
+
+    reportSuppressed(batch, flushing || finalPass);
+
+    if (!batch.empty())
+    {
+      std::cout.write(batch.data(), batch.size());
+      std::cout.flush();
+      batch.clear();
+    }
+
+    if (flushing)
+    {
+      flushRequested = false;
+    }
+
+    if (finalPass)
+    {
+      break;
+    }
+
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+}
+
+void AsyncLog::print(const LogRecord &record, std::string &batch)
+{
+  const double unixSec = toUnixSec(record.ticks);
+  FormatState &state = formats.try_emplace(record.format, FormatState{unixSec, 0, 0}).first->second;
+
+  if (unixSec - state.windowStartSec >= RATE_LIMIT_WINDOW_SEC)
+  {
+    reportSuppressed(batch, record.format, state);
+
+    state.windowStartSec = unixSec;
+    state.lines = 0;
+  }
+
+  if (state.lines >= RATE_LIMIT_LINES)
+  {
+    state.suppressed++;
+    return;
+  }
+
+  state.lines++;
+
+  appendTimestamp(batch, unixSec);
+
+  std::uint32_t nextArg = 0;
+
+  for (const char* c = record.format; *c != '\0'; c++)
+  {
+    if (c[0] != '{' || c[1] != '}' || nextArg == record.numArgs)
+    {
+      batch += *c;
+      continue;
+    }
+
+    const LogArg &arg = record.args[nextArg++];
+    char number[32];
+    std::to_chars_result result = {number, std::errc()};
+
+    switch (arg.type)
+    {
+      case LogArg::INT:
+        result = std::to_chars(number, number + sizeof(number), arg.i);
+        break;
+
+      case LogArg::UINT:
+        result = std::to_chars(number, number + sizeof(number), arg.u);
+        break;
+
+      case LogArg::FLOAT:
+        result = std::to_chars(number, number + sizeof(number), arg.f);
+        break;
+
+      case LogArg::TEXT:
+        batch += &record.text[arg.textOffset];
+        break;
+    }
+
+    batch.append(number, result.ptr);
+    c++;
+  }
+
+  batch += '\n';
+}
+
+void AsyncLog::reportSuppressed(std::string &batch, const char* format, FormatState &state)
+{
+  if (state.suppressed == 0)
+  {
+    return;
+  }
+
+  appendTimestamp(batch, toUnixSec(readTsc()));
+  batch += "Suppressed " + std::to_string(state.suppressed) + " more of \"" + format + "\"\n";
+  state.suppressed = 0;
+}
+
+// With all, every count so far; otherwise only those whose window has ended
+// without another record of the format to report them
+void AsyncLog::reportSuppressed(std::string &batch, const bool all)
+{
+  const double nowSec = toUnixSec(readTsc());
+
+  for (std::pair<const char* const, FormatState> &format : formats)
+  {
+    if (all || nowSec - format.second.windowStartSec >= RATE_LIMIT_WINDOW_SEC)
+    {
+      reportSuppressed(batch, format.first, format.second);
+    }
+  }
+}
+
+AsyncLog& asyncLog()
+{
+  static AsyncLog log;
+
+  return log;
+}
@@ -0,0 +1,168 @@
+#ifndef AsyncLog_H
+#define AsyncLog_H
+
+#include "PipelineMetrics.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Logging for the receive loops that never waits on the terminal. A call
+// copies its format and arguments into a fixed size record on a lock-free
+// queue and returns; a background thread formats the records, stamps them
+// with the time they were logged and writes them out. If the queue is full
+// the record is dropped and counted rather than waiting. Each format is
+// rate limited to a handful of lines a second, the rest counted and
+// reported once things calm down, so an error repeating every dwell can't
+// flood a slow console either.
+//
+//   logAsync("Overrun detected. {} valid samples were read.", meta.actual_count);
+//
+// Formats have to be string literals, only the pointer is kept. Each {} is
+// replaced by the next argument: integers, floating point (printed exactly,
+// round-tripping), or strings, which are copied.
+
+const std::size_t MAX_LOG_ARGS = 4;
+const std::size_t LOG_TEXT_BYTES = 128; // for the string arguments of a record
+
+struct LogArg
+{
+  enum Type : std::uint8_t {INT, UINT, FLOAT, TEXT} type;
+
+  union
+  {
+    std::int64_t i;
+    std::uint64_t u;
+    double f;
+    std::uint32_t textOffset;
+  };
+};
+
+struct LogRecord
+{
+  std::uint64_t ticks;
+  const char* format;
+  std::uint32_t numArgs;
+  std::uint32_t textLength;
+  LogArg args[MAX_LOG_ARGS];
+  char text[LOG_TEXT_BYTES];
+
+  template <typename T>
+  void add(const T value)
+  {
+    LogArg &arg = args[numArgs++];
+
+    if constexpr (std::is_floating_point_v<T>)
+    {
+      arg.type = LogArg::FLOAT;
+      arg.f = value;
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+      arg.type = LogArg::INT;
+      arg.i = value;
+    }
+    else
+    {
+      arg.type = LogArg::UINT;
+      arg.u = value;
+    }
+  }
+
+  void add(const char* value) { addText(value, std::strlen(value)); }
+  void add(const std::string &value) { addText(value.data(), value.size()); }
+
+  // Truncated to what's left of the record's text
+  void addText(const char* value, const std::size_t length);
+};
+
+class AsyncLog
+{
+public:
+  AsyncLog(const std::size_t capacity = 4096);
+  ~AsyncLog();
+
+  AsyncLog(const AsyncLog &) = delete;
+  AsyncLog& operator=(const AsyncLog &) = delete;
+
+  // Never blocks, false if the queue was full
+  bool push(const LogRecord &record);
+
+  // Block until everything logged so far has been written, e.g. before
+  // printing a summary that mustn't be interleaved with it
+  void flush();
+
+private:
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence;
+    LogRecord record;
+  };
+
+  // Per format, for rate limiting
+  struct FormatState
+  {
+    double windowStartSec;
+    std::uint32_t lines;
+    std::uint64_t suppressed;
+  };
+
+  bool pop(LogRecord &record);
+  void run();
+  void print(const LogRecord &record, std::string &batch);
+  void reportSuppressed(std::string &batch, const char* format, FormatState &state);
+  void reportSuppressed(std::string &batch, const bool all);
+  double toUnixSec(const std::uint64_t ticks) const;
+
+  std::vector<Cell> cells;
+  const std::size_t mask;
+  alignas(64) std::atomic<std::size_t> enqueuePos;
+  alignas(64) std::atomic<std::size_t> dequeuePos;
+  alignas(64) std::atomic<std::uint64_t> dropped;
+  std::atomic<bool> flushRequested;
+  std::atomic<bool> stopping;
+
+  std::uint64_t startTicks;
+  double startUnixSec;
+  std::uint64_t droppedReported;
+  std::unordered_map<const char*, FormatState> formats;
+  std::thread drainer;
+};
+
+// Shared by the whole process, started the first time it's used
+AsyncLog& asyncLog();
+
+template <typename... Args>
+void logAsync(const char* format, const Args&... args)
+{
+  static_assert(sizeof...(Args) <= MAX_LOG_ARGS, "too many arguments to log");
+
+  LogRecord record;
+  record.ticks = readTsc();
+  record.format = format;
+  record.numArgs = 0;
+  record.textLength = 0;
+
+  (record.add(args), ...);
+
+  asyncLog().push(record);
+}
+
+// Starts the drain thread ahead of the first dwell rather than in it
+inline void startAsyncLog()
+{
+  asyncLog();
+}
+
+inline void flushAsyncLog()
+{
+  asyncLog().flush();
+}
+
+#endif
@@ -0,0 +1,289 @@
+#include "BladeRfDevice.h"
+#include "BladeRfSyncTuning.h"
+#include "AsyncLog.h"
+
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+  const bladerf_channel CHANNEL = BLADERF_CHANNEL_RX(0);
+
+  // See the recorders for what these configure. Used unless blade_tune_sync
+  // saved something better for this host.
+  const BladeRfSyncParams DEFAULT_SYNC = {16, 1024 * 1024, 8, 3500};
+  const std::uint32_t TIMEOUT_MS = 3500; // on top of the wait for a dwell
+
+  double hostTimeSecs()
+  {
+    return std::chrono::system_clock::now().time_since_epoch() / std::chrono::nanoseconds(1) * 1e-9;
+  }
+}
+
+BladeRfDevice::BladeRfDevice(const std::string &serial, const std::string &fpgaPath) :
+  serial(serial),
+  fpgaPath(fpgaPath),
+  dev(nullptr),
+  sampleRateSps(0),
+  referenceTicks(0),
+  referenceTimeSecs(0)
+{
+}
+
+BladeRfDevice::~BladeRfDevice()
+{
+  if (dev != nullptr)
+  {
+    bladerf_close(dev);
+  }
+}
+
+int BladeRfDevice::open()
+{
+  const std::string identifier = serial.empty() ? "" : "*:serial=" + serial;
+
+  std::int32_t status = bladerf_open(&dev, identifier.c_str());
+
+  if (status != 0)
+  {
+    std::cout << "Unable to open bladeRF " << serial << ": " << bladerf_strerror(status) << std::endl;
+    dev = nullptr;
+    return __LINE__;
+  }
+
+  // Does what loadFpgaA5 or loadFpgaA9 would otherwise have to beforehand
+  if (!fpgaPath.empty() && bladerf_is_fpga_configured(dev) != 1)
+  {
+    std::cout << "Loading FPGA image " << fpgaPath << std::endl;
+
+    status = bladerf_load_fpga(dev, fpgaPath.c_str());
+
+    if (status != 0)
+    {
+      std::cout << "Failed to load FPGA image: " << bladerf_strerror(status) << std::endl;
+      return __LINE__;
+    }
+  }
+
+  return 0;
+}
+
+int BladeRfDevice::configure(const RadioSettings &settings, IqPacket &packet)
+{
+  bladerf_serial serNo;
+  struct bladerf_version version;
+  bladerf_frequency receivedFrequencyHz = 0;
+  bladerf_sample_rate receivedSampleRate = 0;
+  bladerf_bandwidth receivedBandwidthHz = 0;
+
+  // Save off information about the device being used
+
+  packet.linkSpeed = bladerf_device_speed(dev);
+
+  bladerf_get_serial_struct(dev, &serNo);
+  strncpy(packet.serialNumber, serNo.serial, sizeof(packet.serialNumber) - 1);
+  strncpy(packet.boardName, bladerf_get_board_name(dev), sizeof(packet.boardName) - 1);
+
+  bladerf_fpga_version(dev, &version);
+  strncpy(packet.fpgaVersion, version.describe, sizeof(packet.fpgaVersion) - 1);
+
+  bladerf_fw_version(dev, &version);
+  strncpy(packet.fwVersion, version.describe, sizeof(packet.fwVersion) - 1);
+
+  std::cout << "Opened " << packet.boardName << " " << packet.serialNumber << ", FPGA " << packet.fpgaVersion << ", FW " << packet.fwVersion << std::endl;
+
+  if (packet.linkSpeed != BLADERF_DEVICE_SPEED_SUPER)
+  {
+    std::cout << packet.serialNumber << " didn't negotiate a USB 3 link" << std::endl;
+  }
+
+  // Tune and set the gain, stopping at the first setting that fails
+
+  std::int32_t status = bladerf_enable_feature(dev, BLADERF_FEATURE_DEFAULT, true);
+
+  if (status == 0)
+  {
+    status = bladerf_set_frequency(dev, CHANNEL, settings.frequencyHz);
+  }
+
+  if (status == 0)
+  {
+    status = bladerf_get_frequency(dev, CHANNEL, &receivedFrequencyHz);
+  }
+
+  if (status == 0)
+  {
+    status = bladerf_set_sample_rate(dev, CHANNEL, settings.sampleRateSps, &receivedSampleRate);
+  }
+
+  if (status == 0)
+  {
+    status = bladerf_set_bandwidth(dev, CHANNEL, settings.bandwidthHz, &receivedBandwidthHz);
+  }
+
+  if (status == 0)
+  {
+    status = bladerf_set_gain_mode(dev, CHANNEL, BLADERF_GAIN_MGC);
+  }
+
+  if (status == 0)
+  {
+    status = bladerf_set_gain(dev, CHANNEL, std::lround(settings.rxGainDb));
+  }
+
+  if (status == 0)
+  {
+    const BladeRfSyncParams sync = loadBladeRfSyncParams(dev, BLADERF_FORMAT_SC16_Q11_META, 1, receivedSampleRate, DEFAULT_SYNC);
+
+    status = bladerf_sync_config(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC16_Q11_META, sync.numBuffers, sync.bufferSize, sync.numTransfers, sync.timeoutMs);
+  }
+
+  if (status != 0)
+  {
+    std::cout << "Failed to configure " << packet.serialNumber << ": " << bladerf_strerror(status) << std::endl;
+    return __LINE__;
+  }
+
+  sampleRateSps = receivedSampleRate;
+
+  std::cout << packet.serialNumber << ": " << receivedFrequencyHz*1e-6 << " MHz, " << receivedSampleRate*1e-6 << " Msps, " << receivedBandwidthHz*1e-6 << " MHz bandwidth, " << settings.rxGainDb << " dB gain" << std::endl;
+
+  if constexpr (std::endian::native == std::endian::big)
+  {
+    packet.endianness = 0x00000000;
+  }
+  else if constexpr (std::endian::native == std::endian::little)
+  {
+    packet.endianness = 0x02020202;
+  }
+  else
+  {
+    packet.endianness = 0xFFFFFFFF;
+  }
+
+  packet.frequencyHz = receivedFrequencyHz;
+  packet.bandwidthHz = receivedBandwidthHz;
+  packet.sampleRateSps = receivedSampleRate;
+  packet.rxGainDb = std::lround(settings.rxGainDb);
+  packet.bitWidth = 12; // signed 12-bit integer
+
+  return 0;
+}
+
+int BladeRfDevice::syncTime(const bool usePps)
+{
+  if (usePps)
+  {
+    std::cout << "bladeRF has no PPS time latch, mapping its clock from the host clock" << std::endl;
+  }
+
+  const std::int32_t status = readReference(referenceTicks, referenceTimeSecs);
+
+  if (status != 0)
+  {
+    std::cout << "Failed to get timestamp: " << bladerf_strerror(status) << std::endl;
+    return __LINE__;
+  }
+
+  return 0;
+}
+
+int BladeRfDevice::trackHostClock(double &driftSec)
+{
+  bladerf_timestamp ticks = 0;
+  double hostSecs = 0;
+
+  const std::int32_t status = readReference(ticks, hostSecs);
+
+  if (status != 0)
+  {
+    logAsync("Failed to get timestamp: {}", bladerf_strerror(status));
+    return __LINE__;
+  }
+
+  driftSec = (referenceTimeSecs + (std::int64_t(ticks - referenceTicks))/sampleRateSps) - hostSecs;
+
+  referenceTicks = ticks;
+  referenceTimeSecs = hostSecs;
+
+  return 0;
+}
+
+std::int32_t BladeRfDevice::readReference(bladerf_timestamp &ticks, double &hostSecs)
+{
+  // Bracket reading the timestamp with the host clock and take the midpoint
+  const double before = hostTimeSecs();
+  const std::int32_t status = bladerf_get_timestamp(dev, BLADERF_RX, &ticks);
+  const double after = hostTimeSecs();
+
+  hostSecs = (before + after)/2;
+
+  return status;
+}
+
+int BladeRfDevice::start()
+{
+  const std::int32_t status = bladerf_enable_module(dev, CHANNEL, true);
+
+  if (status != 0)
+  {
+    std::cout << "Failed to enable RX: " << bladerf_strerror(status) << std::endl;
+    return __LINE__;
+  }
+
+  return 0;
+}
+
+void BladeRfDevice::stop()
+{
+  const std::int32_t status = bladerf_enable_module(dev, CHANNEL, false);
+
+  if (status != 0)
+  {
+    std::cout << "Failed to disable RX: " << bladerf_strerror(status) << std::endl;
+  }
+}
+
+std::size_t BladeRfDevice::receive(std::complex<std::int16_t>* iq, const std::size_t numSamples, const double startTimeSecs, double &sampleStartTime, bool &overrun)
+{
+  bladerf_metadata meta;
+
+  std::memset(&meta, 0, sizeof(meta));
+  meta.timestamp = referenceTicks + std::llround((startTimeSecs - referenceTimeSecs)*sampleRateSps);
+
+  // Long enough to wait for the start time and then the whole dwell
+  const double waitSecs = std::max(startTimeSecs - timeNow(), 0.0) + numSamples/sampleRateSps;
+  const std::uint32_t timeoutMs = waitSecs*1e3 + TIMEOUT_MS;
+
+  const std::int32_t status = bladerf_sync_rx(dev, iq, numSamples, &meta, timeoutMs);
+
+  sampleStartTime = referenceTimeSecs + (std::int64_t(meta.timestamp - referenceTicks))/sampleRateSps;
+  overrun = (meta.status & BLADERF_META_STATUS_OVERRUN) != 0;
+
+  if (status == BLADERF_ERR_TIME_PAST)
+  {
+    logAsync("Dwell at {} was already in the past", startTimeSecs);
+    return 0;
+  }
+  else if (status != 0)
+  {
+    logAsync("RX failed: {}", bladerf_strerror(status));
+    return 0;
+  }
+
+  return meta.actual_count;
+}
+
+double BladeRfDevice::timeNow()
+{
+  bladerf_timestamp ticks = 0;
+
+  bladerf_get_timestamp(dev, BLADERF_RX, &ticks);
+
+  return referenceTimeSecs + (std::int64_t(ticks - referenceTicks))/sampleRateSps;
+}
@@ -0,0 +1,48 @@
+#ifndef BladeRfDevice_H
+#define BladeRfDevice_H
+
+#include "RadioDevice.h"
+
+#include <libbladeRF.h>
+
+#include <string>
+
+// A bladeRF on RX channel 0 streaming SC16_Q11 samples. Dwells are asked for
+// by timestamp, which the sync interface waits for, so they start on the
+// requested sample. The bladeRF has no PPS time latch, so its clock is always
+// mapped onto UTC from the host clock, and has to be mapped again every so
+// often with trackHostClock() to follow the host clock rather than drifting
+// off with its own oscillator.
+class BladeRfDevice : public RadioDevice
+{
+public:
+  // An empty serial opens the first bladeRF found. The FPGA image at
+  // fpgaPath, if there is one, is loaded when the FPGA isn't configured.
+  BladeRfDevice(const std::string &serial, const std::string &fpgaPath = "");
+  ~BladeRfDevice();
+
+  int open() override;
+  int configure(const RadioSettings &settings, IqPacket &packet) override;
+  int syncTime(const bool usePps) override;
+  int trackHostClock(double &driftSec) override;
+  int start() override;
+  void stop() override;
+  std::size_t receive(std::complex<std::int16_t>* iq, const std::size_t numSamples, const double startTimeSecs, double &sampleStartTime, bool &overrun) override;
+  double timeNow() override;
+
+private:
+  std::string serial;
+  std::string fpgaPath;
+  bladerf* dev;
+  double sampleRateSps;
+
+  // Read the device timestamp and the host time it was read at, returns the
+  // bladeRF status
+  std::int32_t readReference(bladerf_timestamp &ticks, double &hostSecs);
+
+  // UTC time of device timestamp referenceTicks
+  bladerf_timestamp referenceTicks;
+  double referenceTimeSecs;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "BladeRfSyncTuning.h"
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdlib>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+  struct TuningEntry
+  {
+    std::string host;
+    std::string speed;
+    std::string format;
+    std::uint32_t numChannels;
+    std::uint64_t sampleRateSps;
+    BladeRfSyncParams params;
+
+    bool sameKey(const TuningEntry &other) const
+    {
+      return host == other.host && speed == other.speed && format == other.format && numChannels == other.numChannels;
+    }
+  };
+
+  std::string hostName()
+  {
+    char name[256] = {};
+    gethostname(name, sizeof(name) - 1);
+
+    return name;
+  }
+
+  std::vector<TuningEntry> readEntries(const std::string &path)
+  {
+    std::vector<TuningEntry> entries;
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+      std::istringstream words(line);
+      TuningEntry entry;
+
+      // Lines from before the format and channel count were kept don't parse
+      // and are dropped
+      if (words >> entry.host >> entry.speed >> entry.format >> entry.numChannels >> entry.sampleRateSps >> entry.params.numBuffers >> entry.params.bufferSize >> entry.params.numTransfers >> entry.params.timeoutMs)
+      {
+        entries.push_back(entry);
+      }
+    }
+
+    return entries;
+  }
+}
+
+std::string bladeRfSyncTuningPath()
+{
+  const char* path = getenv("BLADERF_SYNC_TUNING");
+  const char* home = getenv("HOME");
+
+  if (path != nullptr)
+  {
+    return path;
+  }
+
+  return std::string(home != nullptr ? home : ".") + "/.bladerf_sync_tuning";
+}
+
+const char* bladeRfSpeedStr(const bladerf_dev_speed speed)
+{
+  switch (speed)
+  {
+    case BLADERF_DEVICE_SPEED_SUPER:
+      return "USB3";
+    case BLADERF_DEVICE_SPEED_HIGH:
+      return "USB2";
+    default:
+      return "unknown";
+  }
+}
+
+const char* bladeRfFormatStr(const bladerf_format format)
+{
+  switch (format)
+  {
+    case BLADERF_FORMAT_SC8_Q7:
+    case BLADERF_FORMAT_SC8_Q7_META:
+      return "sc8";
+    default:
+      return "sc16";
+  }
+}
+
+BladeRfSyncParams loadBladeRfSyncParams(bladerf* dev, const bladerf_format format, const std::uint32_t numChannels, const double sampleRateSps, const BladeRfSyncParams &defaults)
+{
+  const std::string path = bladeRfSyncTuningPath();
+  const std::vector<TuningEntry> entries = readEntries(path);
+  const TuningEntry* best = nullptr;
+
+  TuningEntry wanted;
+  wanted.host = hostName();
+  wanted.speed = bladeRfSpeedStr(bladerf_device_speed(dev));
+  wanted.format = bladeRfFormatStr(format);
+  wanted.numChannels = numChannels;
+
+  for (const TuningEntry &entry : entries)
+  {
+    if (entry.sameKey(wanted) && entry.sampleRateSps >= sampleRateSps && (best == nullptr || entry.sampleRateSps < best->sampleRateSps))
+    {
+      best = &entry;
+    }
+  }
+
+  const BladeRfSyncParams &params = (best != nullptr) ? best->params : defaults;
+
+  if (best != nullptr)
+  {
+    std::cout << "Sync settings tuned on " << wanted.host << " over " << wanted.speed << " for " << numChannels << " channel(s) of " << wanted.format << " at " << best->sampleRateSps*1e-6 << " Msps: ";
+  }
+  else
+  {
+    std::cout << "No sync settings tuned on " << wanted.host << " over " << wanted.speed << " for " << numChannels << " channel(s) of " << wanted.format << " at " << sampleRateSps*1e-6 << " Msps in " << path << ", defaults: ";
+  }
+
+  std::cout << params.numBuffers << " buffers of " << params.bufferSize << " samples, " << params.numTransfers << " transfers, " << params.timeoutMs << " ms timeout" << std::endl;
+
+  return params;
+}
+
+bool saveBladeRfSyncParams(bladerf* dev, const bladerf_format format, const std::uint32_t numChannels, const double sampleRateSps, const BladeRfSyncParams &params)
+{
+  const std::string path = bladeRfSyncTuningPath();
+
+  TuningEntry tuned;
+  tuned.host = hostName();
+  tuned.speed = bladeRfSpeedStr(bladerf_device_speed(dev));
+  tuned.format = bladeRfFormatStr(format);
+  tuned.numChannels = numChannels;
+  tuned.sampleRateSps = std::llround(sampleRateSps);
+  tuned.params = params;
+
+  std::vector<TuningEntry> entries;
+
+  for (const TuningEntry &entry : readEntries(path))
+  {
+    if (!entry.sameKey(tuned) || entry.sampleRateSps != tuned.sampleRateSps)
+    {
+      entries.push_back(entry);
+    }
+  }
+
+  entries.push_back(tuned);
+
+  std::ofstream file(path, std::ios::trunc);
+
+  for (const TuningEntry &entry : entries)
+  {
+    file << entry.host << " " << entry.speed << " " << entry.format << " " << entry.numChannels << " " << entry.sampleRateSps << " " << entry.params.numBuffers << " " << entry.params.bufferSize << " " << entry.params.numTransfers << " " << entry.params.timeoutMs << std::endl;
+  }
+
+  if (!file)
+  {
+    std::cout << "Failed to save sync settings to " << path << std::endl;
+    return false;
+  }
+
+  return true;
+}
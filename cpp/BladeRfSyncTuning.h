@@ -0,0 +1,47 @@
+#ifndef BladeRfSyncTuning_H
+#define BladeRfSyncTuning_H
+
+#include <libbladeRF.h>
+
+#include <cstdint>
+#include <string>
+
+// Buffering of the stream behind bladerf_sync_rx(), as given to
+// bladerf_sync_config()
+struct BladeRfSyncParams
+{
+  std::uint32_t numBuffers;
+  std::uint32_t bufferSize; // samples, a multiple of 1024
+  std::uint32_t numTransfers;
+  std::uint32_t timeoutMs;
+};
+
+// Settings found by blade_tune_sync are kept per host, USB link speed, sample
+// format and channel count in a text file, one line for every sample rate
+// they were tuned at:
+//
+//   <host> <USB2|USB3> <sc8|sc16> <numChannels> <sampleRateSps> <numBuffers> <bufferSize> <numTransfers> <timeoutMs>
+//
+// bufferSize is in samples, which are a different number of bytes in each
+// format and interleave both channels in two channel mode, so settings are
+// only ever used for the format and channel count they were tuned with. The
+// file is $BLADERF_SYNC_TUNING if that's set and ~/.bladerf_sync_tuning
+// otherwise.
+std::string bladeRfSyncTuningPath();
+
+const char* bladeRfSpeedStr(const bladerf_dev_speed speed);
+
+// sc8 or sc16
+const char* bladeRfFormatStr(const bladerf_format format);
+
+// The settings tuned on this host at the device's link speed, for this format
+// and channel count, at the least sample rate that's still at least
+// sampleRateSps, or defaults if nothing that fast was tuned. Says which it
+// went with.
+BladeRfSyncParams loadBladeRfSyncParams(bladerf* dev, const bladerf_format format, const std::uint32_t numChannels, const double sampleRateSps, const BladeRfSyncParams &defaults);
+
+// Adds the settings for this host, link speed, format, channel count and
+// sample rate, replacing any already there
+bool saveBladeRfSyncParams(bladerf* dev, const bladerf_format format, const std::uint32_t numChannels, const double sampleRateSps, const BladeRfSyncParams &params);
+
+#endif
@@ -0,0 +1,154 @@
+#include "BufferPool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+  const std::size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+  std::size_t roundUp(const std::size_t bytes, const std::size_t alignment)
+  {
+    return (bytes + alignment - 1)/alignment*alignment;
+  }
+}
+
+BufferPool::BufferPool(const std::size_t blockBytes, const std::size_t maxBlocks, const bool useHugePages) :
+  bytesPerBlock(blockBytes),
+  mappedBytesPerBlock(roundUp(std::max<std::size_t>(blockBytes, 1), HUGE_PAGE_SIZE)),
+  maxBlocks(maxBlocks),
+  useHugePages(useHugePages),
+  hugeTlbBlocks(0)
+{
+}
+
+BufferPool::~BufferPool()
+{
+  for (Block &block : blocks)
+  {
+    munmap(block.data, block.mappedBytes);
+  }
+}
+
+void BufferPool::preallocate()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  while (blocks.size() < maxBlocks)
+  {
+    void* block = allocateBlock();
+
+    if (block == nullptr)
+    {
+      break;
+    }
+
+    freeBlocks.push_back(block);
+  }
+}
+
+void* BufferPool::acquire()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (freeBlocks.empty() && blocks.size() < maxBlocks)
+  {
+    return allocateBlock();
+  }
+
+  blockReleased.wait(lock, [this] { return !freeBlocks.empty(); });
+
+  void* block = freeBlocks.back();
+  freeBlocks.pop_back();
+
+  return block;
+}
+
+void* BufferPool::tryAcquire()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (freeBlocks.empty())
+  {
+    return (blocks.size() < maxBlocks) ? allocateBlock() : nullptr;
+  }
+
+  void* block = freeBlocks.back();
+  freeBlocks.pop_back();
+
+  return block;
+}
+
+void BufferPool::release(void* block)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBlocks.push_back(block);
+  }
+
+  blockReleased.notify_one();
+}
+
+void* BufferPool::allocateBlock()
+{
+  // Explicit huge pages first, which only exist if some were reserved in
+  // /proc/sys/vm/nr_hugepages, populated so they're all faulted in now
+  if (useHugePages)
+  {
+    void* data = mmap(nullptr, mappedBytesPerBlock, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+
+    if (data != MAP_FAILED)
+    {
+      blocks.push_back({data, mappedBytesPerBlock});
+      hugeTlbBlocks++;
+      return data;
+    }
+  }
+
+  // Otherwise map an extra huge page's worth and trim it down to a 2 MB
+  // aligned range, which transparent huge pages can back
+  const std::size_t overMappedBytes = mappedBytesPerBlock + HUGE_PAGE_SIZE;
+  std::uint8_t* mapped = static_cast<std::uint8_t*>(mmap(nullptr, overMappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+  if (mapped == MAP_FAILED)
+  {
+    std::cout << "Failed to allocate a " << mappedBytesPerBlock << " byte buffer" << std::endl;
+    return nullptr;
+  }
+
+  std::uint8_t* data = reinterpret_cast<std::uint8_t*>(roundUp(reinterpret_cast<std::uintptr_t>(mapped), HUGE_PAGE_SIZE));
+  const std::size_t headBytes = data - mapped;
+  const std::size_t tailBytes = overMappedBytes - headBytes - mappedBytesPerBlock;
+
+  if (headBytes > 0)
+  {
+    munmap(mapped, headBytes);
+  }
+
+  if (tailBytes > 0)
+  {
+    munmap(data + mappedBytesPerBlock, tailBytes);
+  }
+
+  if (useHugePages)
+  {
+    madvise(data, mappedBytesPerBlock, MADV_HUGEPAGE);
+  }
+
+  // Fault every page in now, from this thread
+  const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+
+  for (std::size_t offset = 0; offset < mappedBytesPerBlock; offset += pageSize)
+  {
+    data[offset] = 0;
+  }
+
+  blocks.push_back({data, mappedBytesPerBlock});
+
+  return data;
+}
@@ -0,0 +1,69 @@
+#ifndef BufferPool_H
+#define BufferPool_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Fixed-size sample buffers that are handed out and given back instead of
+// being allocated for every dwell. Blocks are 2 MB aligned and rounded up to a
+// whole number of 2 MB pages, backed by explicit huge pages when the system
+// has them reserved and otherwise by transparent huge pages, so streaming
+// through a dwell of GBs doesn't miss the TLB every 4 KB and the blocks are
+// aligned enough for O_DIRECT. Every page is touched when its block is
+// allocated, so the page faults happen up front rather than mid-dwell, and
+// the pages land on the NUMA node of the thread that allocated them; calling
+// preallocate() from a pinned receive thread keeps its buffers local to it.
+class BufferPool
+{
+public:
+  // At most maxBlocks are allocated, acquire() waits for one to be released
+  // after that
+  BufferPool(const std::size_t blockBytes, const std::size_t maxBlocks, const bool useHugePages = true);
+  ~BufferPool();
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool& operator=(const BufferPool &) = delete;
+
+  // Allocate every block now, on this thread
+  void preallocate();
+
+  // Returns nullptr if a new block was needed and couldn't be allocated
+  void* acquire();
+  void release(void* block);
+
+  // Returns nullptr rather than waiting if every block is in use
+  void* tryAcquire();
+
+  template <typename T>
+  T* acquire() { return static_cast<T*>(acquire()); }
+
+  template <typename T>
+  T* tryAcquire() { return static_cast<T*>(tryAcquire()); }
+
+  std::size_t blockBytes() const { return bytesPerBlock; }
+  std::size_t numHugeTlbBlocks() const { return hugeTlbBlocks; } // blocks on explicit huge pages
+
+private:
+  struct Block
+  {
+    void* data;
+    std::size_t mappedBytes;
+  };
+
+  void* allocateBlock();
+
+  std::size_t bytesPerBlock;
+  std::size_t mappedBytesPerBlock;
+  std::size_t maxBlocks;
+  bool useHugePages;
+  std::size_t hugeTlbBlocks;
+
+  std::mutex mutex;
+  std::condition_variable blockReleased;
+  std::vector<Block> blocks;
+  std::vector<void*> freeBlocks;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "CfarDetector.h"
+#include "SlidingWindowQuantile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+CfarDetector::CfarDetector(const std::size_t trainingCells, const std::size_t guardCells, const float snrThresholdDb, const Mode mode, const double osQuantile) :
+  trainingCells(std::max<std::size_t>(trainingCells, 1)),
+  guardCells(guardCells),
+  mode(mode),
+  osQuantile(osQuantile)
+{
+  // SNR is expressed as a magnitude ratio everywhere else so square it for power
+  const float magnitudeScale = std::pow(10.0f, snrThresholdDb/10);
+  scale = magnitudeScale*magnitudeScale;
+}
+
+void CfarDetector::computeThreshold(const std::complex<float>* iq, const std::size_t numSamples, const std::size_t begin, const std::size_t count, float* thresholdPower, const std::size_t stride)
+{
+  const std::size_t reach = guardCells + trainingCells;
+  const std::size_t first = (begin > reach) ? begin - reach : 0;
+  const std::size_t last = std::min(numSamples, begin + count + reach);
+  const std::size_t length = last - first;
+
+  power.resize(length);
+
+  for (std::size_t ii = 0; ii < length; ii++)
+  {
+    power[ii] = std::norm(iq[(first + ii)*stride]);
+  }
+
+  if (mode == Mode::CellAveraging)
+  {
+    prefix.resize(length + 1);
+    prefix[0] = 0;
+
+    for (std::size_t ii = 0; ii < length; ii++)
+    {
+      prefix[ii+1] = prefix[ii] + power[ii];
+    }
+
+    cellAveraging(first, begin, count, thresholdPower);
+  }
+  else
+  {
+    orderStatistic(first, last, begin, count, thresholdPower);
+  }
+}
+
+void CfarDetector::cellAveraging(const std::size_t first, const std::size_t begin, const std::size_t count, float* thresholdPower)
+{
+  const std::ptrdiff_t length = power.size();
+  const std::ptrdiff_t guard = guardCells;
+  const std::ptrdiff_t training = trainingCells;
+  const std::ptrdiff_t offset = begin - first;
+  const double* sums = prefix.data();
+
+  // Reference cells that fall off either end of the buffer are left out, and
+  // a cell with none left can't be detected
+  const auto edgeThreshold = [&](const std::ptrdiff_t cut)
+  {
+    const std::ptrdiff_t lagStart = std::clamp<std::ptrdiff_t>(cut - guard - training, 0, length);
+    const std::ptrdiff_t lagEnd = std::clamp<std::ptrdiff_t>(cut - guard, 0, length);
+    const std::ptrdiff_t leadStart = std::clamp<std::ptrdiff_t>(cut + guard + 1, 0, length);
+    const std::ptrdiff_t leadEnd = std::clamp<std::ptrdiff_t>(cut + guard + training + 1, 0, length);
+
+    const double sum = (sums[lagEnd] - sums[lagStart]) + (sums[leadEnd] - sums[leadStart]);
+    const double cells = (lagEnd - lagStart) + (leadEnd - leadStart);
+
+    return (cells > 0) ? float(scale*sum/cells) : std::numeric_limits<float>::infinity();
+  };
+
+  // Cells under test whose reference cells are all in the buffer
+  const std::ptrdiff_t interiorStart = std::clamp<std::ptrdiff_t>(guard + training - offset, 0, count);
+  const std::ptrdiff_t interiorEnd = std::clamp<std::ptrdiff_t>(length - guard - training - offset, interiorStart, count);
+
+  for (std::ptrdiff_t ii = 0; ii < interiorStart; ii++)
+  {
+    thresholdPower[ii] = edgeThreshold(offset + ii);
+  }
+
+  // A straight line of shifted loads from the running sum that vectorizes
+  const double cellScale = scale/(2.0*training);
+  const std::ptrdiff_t cut = offset + interiorStart;
+  const double* lagStart = &sums[cut - guard - training];
+  const double* lagEnd = &sums[cut - guard];
+  const double* leadStart = &sums[cut + guard + 1];
+  const double* leadEnd = &sums[cut + guard + training + 1];
+  float* interior = &thresholdPower[interiorStart];
+
+  for (std::ptrdiff_t ii = 0; ii < interiorEnd - interiorStart; ii++)
+  {
+    interior[ii] = cellScale*((lagEnd[ii] - lagStart[ii]) + (leadEnd[ii] - leadStart[ii]));
+  }
+
+  for (std::ptrdiff_t ii = interiorEnd; ii < std::ptrdiff_t(count); ii++)
+  {
+    thresholdPower[ii] = edgeThreshold(offset + ii);
+  }
+}
+
+void CfarDetector::orderStatistic(const std::size_t first, const std::size_t last, const std::size_t begin, const std::size_t count, float* thresholdPower)
+{
+  const std::ptrdiff_t length = last - first;
+  const std::ptrdiff_t guard = guardCells;
+  const std::ptrdiff_t training = trainingCells;
+  const std::ptrdiff_t offset = begin - first;
+
+  // Reference cells that are in the window when the block starts
+  SlidingWindowQuantile reference(2*trainingCells, osQuantile);
+
+  for (std::ptrdiff_t kk = offset - guard - training; kk < offset - guard; kk++)
+  {
+    if (kk >= 0 && kk < length)
+    {
+      reference.insert(power[kk]);
+    }
+  }
+
+  for (std::ptrdiff_t kk = offset + guard + 1; kk <= offset + guard + training; kk++)
+  {
+    if (kk >= 0 && kk < length)
+    {
+      reference.insert(power[kk]);
+    }
+  }
+
+  for (std::ptrdiff_t ii = 0; ii < std::ptrdiff_t(count); ii++)
+  {
+    const std::ptrdiff_t cut = offset + ii;
+
+    thresholdPower[ii] = reference.empty() ? std::numeric_limits<float>::infinity() : scale*reference.value();
+
+    // Slide both halves of the reference window along by one cell
+    const std::ptrdiff_t lagOut = cut - guard - training;
+    const std::ptrdiff_t lagIn = cut - guard;
+    const std::ptrdiff_t leadOut = cut + guard + 1;
+    const std::ptrdiff_t leadIn = cut + guard + training + 1;
+
+    if (lagOut >= 0 && lagOut < length)
+    {
+      reference.erase(power[lagOut]);
+    }
+
+    if (lagIn >= 0 && lagIn < length)
+    {
+      reference.insert(power[lagIn]);
+    }
+
+    if (leadOut >= 0 && leadOut < length)
+    {
+      reference.erase(power[leadOut]);
+    }
+
+    if (leadIn >= 0 && leadIn < length)
+    {
+      reference.insert(power[leadIn]);
+    }
+  }
+}
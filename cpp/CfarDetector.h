@@ -0,0 +1,50 @@
+#ifndef CfarDetector_H
+#define CfarDetector_H
+
+#include <cstddef>
+#include <complex>
+#include <vector>
+
+// Sliding window constant false alarm rate threshold. For every sample the
+// noise power is estimated from trainingCells samples on each side, skipping
+// guardCells samples either side of the cell under test so the pulse itself
+// doesn't raise its own threshold. Cell averaging (CA) uses the mean of the
+// reference cells computed from running sums so the cost per sample is O(1);
+// order statistic (OS) uses a quantile of the reference cells instead, which
+// holds up better when another pulse lands in the reference window.
+class CfarDetector
+{
+public:
+  enum class Mode
+  {
+    CellAveraging,
+    OrderStatistic
+  };
+
+  CfarDetector(const std::size_t trainingCells, const std::size_t guardCells, const float snrThresholdDb, const Mode mode = Mode::CellAveraging, const double osQuantile = 0.75);
+
+  // Compute the threshold power (to compare against |iq|^2) of samples
+  // [begin, begin+count) of a buffer numSamples long. The whole buffer is
+  // passed so reference cells on either side of the block can be used, which
+  // lets a large buffer be thresholded in small cache resident blocks. Sample
+  // k of the stream is iq[k*stride], e.g. stride = M for one bin of M
+  // interleaved channelizer outputs. A sample with no reference cells in the
+  // buffer (one shorter than the guard cells) gets an infinite threshold, as
+  // there's nothing to tell its noise from.
+  void computeThreshold(const std::complex<float>* iq, const std::size_t numSamples, const std::size_t begin, const std::size_t count, float* thresholdPower, const std::size_t stride = 1);
+
+private:
+  void cellAveraging(const std::size_t first, const std::size_t begin, const std::size_t count, float* thresholdPower);
+  void orderStatistic(const std::size_t first, const std::size_t last, const std::size_t begin, const std::size_t count, float* thresholdPower);
+
+  std::size_t trainingCells;
+  std::size_t guardCells;
+  float scale; // threshold power relative to the noise power
+  Mode mode;
+  double osQuantile;
+
+  std::vector<float> power;    // |iq|^2 of the block plus its reference cells
+  std::vector<double> prefix;  // running sum of power, prefix[k] = sum of power[0..k-1]
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "ChannelDeinterleave.h"
+
+namespace
+{
+  // Word is an unsigned integer the size of one I/Q pair. Straight from the
+  // interleaved buffer into the channel buffers; __restrict lets the compiler
+  // vectorize it without checking whether they overlap.
+  template <typename Word>
+  void split(const Word* __restrict iq, const std::size_t numSamples, Word* __restrict ch0, Word* __restrict ch1)
+  {
+    for (std::size_t ii = 0; ii < numSamples; ii++)
+    {
+      ch0[ii] = iq[2*ii];
+      ch1[ii] = iq[2*ii + 1];
+    }
+  }
+}
+
+void deinterleaveChannels(const std::complex<std::int16_t>* iq, const std::size_t numSamples, std::complex<std::int16_t>* ch0, std::complex<std::int16_t>* ch1)
+{
+  static_assert(sizeof(std::complex<std::int16_t>) == sizeof(std::uint32_t));
+
+  split(reinterpret_cast<const std::uint32_t*>(iq), numSamples, reinterpret_cast<std::uint32_t*>(ch0), reinterpret_cast<std::uint32_t*>(ch1));
+}
+
+void deinterleaveChannels(const std::complex<std::int8_t>* iq, const std::size_t numSamples, std::complex<std::int8_t>* ch0, std::complex<std::int8_t>* ch1)
+{
+  static_assert(sizeof(std::complex<std::int8_t>) == sizeof(std::uint16_t));
+
+  split(reinterpret_cast<const std::uint16_t*>(iq), numSamples, reinterpret_cast<std::uint16_t*>(ch0), reinterpret_cast<std::uint16_t*>(ch1));
+}
@@ -0,0 +1,15 @@
+#ifndef ChannelDeinterleave_H
+#define ChannelDeinterleave_H
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+
+// Split a buffer of two channels' samples, interleaved one sample of each in
+// turn as a bladeRF streams them in RX_X2 mode, into a buffer per channel.
+// numSamples is the number of samples per channel. Each I/Q pair is moved as
+// a single word, so the split is one pass of vector loads and shuffles.
+void deinterleaveChannels(const std::complex<std::int16_t>* iq, const std::size_t numSamples, std::complex<std::int16_t>* ch0, std::complex<std::int16_t>* ch1);
+void deinterleaveChannels(const std::complex<std::int8_t>* iq, const std::size_t numSamples, std::complex<std::int8_t>* ch0, std::complex<std::int8_t>* ch1);
+
+#endif
@@ -0,0 +1,122 @@
+#include "Channelizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+Channelizer::Channelizer(const std::size_t numBins, const std::size_t tapsPerBin) :
+  M(std::max<std::size_t>(numBins, 1)),
+  P(std::max<std::size_t>(tapsPerBin, 1))
+{
+  const std::size_t L = M*P;
+
+  // Kaiser windowed sinc with its cutoff at the edge of a bin, beta is set
+  // for roughly 80 dB of stopband attenuation like dsp.Channelizer
+  const double beta = 7.857;
+  const double cutoff = 0.5/M;
+  double sum = 0;
+
+  taps.resize(L);
+
+  for (std::size_t n = 0; n < L; n++)
+  {
+    const double t = n - (L - 1)/2.0;
+    const double sinc = (t == 0) ? 2*cutoff : std::sin(2*M_PI*cutoff*t)/(M_PI*t);
+    const double r = 2.0*n/(L - 1) - 1;
+    const double window = (L > 1) ? std::cyl_bessel_i(0.0, beta*std::sqrt(std::max(0.0, 1 - r*r)))/std::cyl_bessel_i(0.0, beta) : 1.0;
+
+    taps[n] = sinc*window;
+    sum += taps[n];
+  }
+
+  // Unity gain at DC
+  for (float &tap : taps)
+  {
+    tap /= sum;
+  }
+
+  history.resize(L);
+  incoming.reserve(M);
+  branch.resize(M);
+  spectrum.resize(M);
+
+  fft.SetFlag(Eigen::FFT<float>::Unscaled);
+
+  reset();
+}
+
+void Channelizer::reset()
+{
+  std::fill(history.begin(), history.end(), std::complex<float>(0));
+  incoming.clear();
+}
+
+double Channelizer::binOffset(const std::size_t bin) const
+{
+  return (double(bin) - double(M/2))/M;
+}
+
+std::size_t Channelizer::process(const std::complex<float>* iq, const std::size_t numSamples, std::complex<float>* out, const std::size_t outStride)
+{
+  std::size_t k = 0;
+  std::size_t ii = 0;
+
+  // Finish off a block left over from the last call
+  if (!incoming.empty())
+  {
+    const std::size_t needed = std::min(M - incoming.size(), numSamples);
+    incoming.insert(incoming.end(), iq, iq + needed);
+    ii = needed;
+
+    if (incoming.size() < M)
+    {
+      return 0;
+    }
+
+    std::move(history.begin() + M, history.end(), history.begin());
+    std::copy(incoming.begin(), incoming.end(), history.end() - M);
+    incoming.clear();
+
+    outputSample(out, outStride, k++);
+  }
+
+  for (; ii + M <= numSamples; ii += M)
+  {
+    std::move(history.begin() + M, history.end(), history.begin());
+    std::copy(&iq[ii], &iq[ii + M], history.end() - M);
+
+    outputSample(out, outStride, k++);
+  }
+
+  incoming.insert(incoming.end(), &iq[ii], &iq[numSamples]);
+
+  return k;
+}
+
+void Channelizer::outputSample(std::complex<float>* out, const std::size_t outStride, const std::size_t k)
+{
+  const std::size_t L = M*P;
+  const std::complex<float>* newest = &history[L - 1];
+
+  // Branch m of the polyphase filter sees every M'th sample starting m
+  // samples back from the newest one
+  for (std::size_t m = 0; m < M; m++)
+  {
+    std::complex<float> v = 0;
+
+    for (std::size_t p = 0; p < P; p++)
+    {
+      v += taps[p*M + m]*newest[-std::ptrdiff_t(p*M + m)];
+    }
+
+    branch[m] = v;
+  }
+
+  // Bin b is the sum over m of branch[m]*exp(+j*2*pi*b*m/M), i.e. an unscaled inverse DFT
+  fft.inv(spectrum, branch);
+
+  // Put the most negative frequency bin first
+  for (std::size_t bin = 0; bin < M; bin++)
+  {
+    out[bin*outStride + k] = spectrum[(bin + M - M/2) % M];
+  }
+}
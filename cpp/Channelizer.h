@@ -0,0 +1,55 @@
+#ifndef Channelizer_H
+#define Channelizer_H
+
+#include <cstddef>
+#include <complex>
+#include <vector>
+
+#include <unsupported/Eigen/FFT>
+
+// Critically sampled polyphase FFT channelizer, the C++ counterpart of
+// dsp.Channelizer in the MATLAB tools. The input is split into numBins
+// channels, each decimated by numBins, using a windowed sinc prototype
+// filter of tapsPerBin*numBins taps. Filter history carries over between
+// calls so a stream can be channelized in blocks of any size.
+class Channelizer
+{
+public:
+  Channelizer(const std::size_t numBins, const std::size_t tapsPerBin = 12);
+
+  void reset();
+
+  std::size_t numBins() const { return M; }
+
+  // Offset of each output bin from the input center frequency as a fraction
+  // of the input sample rate, bins are ordered from most negative to most
+  // positive (i.e. already fftshift'ed)
+  double binOffset(const std::size_t bin) const;
+
+  // Channelize numSamples input samples. Output is bin major: bin b's
+  // samples are at out[b*outStride + k] for k < the returned count of
+  // samples per bin. Input left over from a partial final block of numBins
+  // samples is kept for the next call.
+  std::size_t process(const std::complex<float>* iq, const std::size_t numSamples, std::complex<float>* out, const std::size_t outStride);
+
+  // Time of output sample 0 relative to input sample 0 in input samples,
+  // i.e. the latency of the prototype filter less the block length
+  double outputTimeOffset() const { return (M - 1) - (M*P - 1)/2.0; }
+
+  // Upper bound on the samples per bin process() returns for numSamples input samples
+  std::size_t maxOutputSamples(const std::size_t numSamples) const { return (numSamples + M - 1)/M + 1; }
+
+private:
+  void outputSample(std::complex<float>* out, const std::size_t outStride, const std::size_t k);
+
+  std::size_t M;
+  std::size_t P;
+  std::vector<float> taps;                   // prototype lowpass filter, length M*P
+  std::vector<std::complex<float>> history;  // last M*P input samples, most recent last
+  std::vector<std::complex<float>> incoming; // input samples waiting for a full block of M
+  std::vector<std::complex<float>> branch;   // polyphase branch outputs for one output sample
+  std::vector<std::complex<float>> spectrum;
+  Eigen::FFT<float> fft;
+};
+
+#endif
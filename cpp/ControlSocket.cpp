@@ -0,0 +1,248 @@
+#include "ControlSocket.h"
+#include "Helper.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <iostream>
+
+namespace
+{
+  const int LISTEN_BACKLOG = 8; // clients left waiting while a job runs
+
+  bool makeAddress(const std::string &path, sockaddr_un &address)
+  {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+    {
+      std::cout << "Socket path " << path << " is too long" << std::endl;
+      return false;
+    }
+
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    return true;
+  }
+}
+
+ControlConnection::ControlConnection(const int fd) : fd(fd), numDropped(0)
+{
+}
+
+ControlConnection::~ControlConnection()
+{
+  close(fd);
+}
+
+bool ControlConnection::readLine(std::string &line)
+{
+  std::size_t newline;
+
+  while ((newline = pending.find('\n')) == std::string::npos)
+  {
+    char buffer[256];
+
+    const ssize_t numRead = recv(fd, buffer, sizeof(buffer), 0);
+
+    if (numRead < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else if (numRead <= 0)
+    {
+      return false;
+    }
+
+    pending.append(buffer, numRead);
+  }
+
+  line = pending.substr(0, newline);
+  pending.erase(0, newline + 1);
+
+  return true;
+}
+
+bool ControlConnection::setTimeout(const double sec)
+{
+  timeval timeout;
+  timeout.tv_sec = std::floor(sec);
+  timeout.tv_usec = (sec - std::floor(sec))*1e6;
+
+  return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0 && setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+bool ControlConnection::writeLine(const std::string &line)
+{
+  unsent += line;
+  unsent += '\n';
+
+  return sendUnsent(0) && unsent.empty();
+}
+
+bool ControlConnection::offerLine(const std::string &line)
+{
+  // Finish the line the socket last took part of before starting another,
+  // so a dropped line never leaves half a line behind
+  if (!sendUnsent(MSG_DONTWAIT))
+  {
+    return false;
+  }
+
+  if (!unsent.empty())
+  {
+    numDropped++;
+    return true;
+  }
+
+  unsent = line;
+  unsent += '\n';
+
+  return sendUnsent(MSG_DONTWAIT);
+}
+
+bool ControlConnection::sendUnsent(const int flags)
+{
+  std::size_t numSent = 0;
+
+  while (numSent < unsent.size())
+  {
+    // A client that has hung up mustn't take the daemon down with SIGPIPE
+    const ssize_t status = send(fd, &unsent[numSent], unsent.size() - numSent, MSG_NOSIGNAL | flags);
+
+    if (status < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else if (status < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && (flags & MSG_DONTWAIT) != 0)
+    {
+      break;
+    }
+    else if (status <= 0)
+    {
+      return false;
+    }
+
+    numSent += status;
+  }
+
+  unsent.erase(0, numSent);
+
+  return true;
+}
+
+int listenControlSocket(const std::string &path)
+{
+  sockaddr_un address;
+
+  if (!makeAddress(path, address))
+  {
+    return -1;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  unlink(path.c_str());
+
+  if (fd < 0 || bind(fd, (const sockaddr*)&address, sizeof(address)) != 0 || listen(fd, LISTEN_BACKLOG) != 0)
+  {
+    std::cout << "Failed to listen on " << path << ": " << strerror(errno) << std::endl;
+
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+
+    return -1;
+  }
+
+  return fd;
+}
+
+int connectControlSocket(const std::string &path)
+{
+  sockaddr_un address;
+
+  if (!makeAddress(path, address))
+  {
+    return -1;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+  {
+    std::cout << "Failed to connect to the recorder daemon at " << path << ": " << strerror(errno) << std::endl;
+
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+
+    return -1;
+  }
+
+  return fd;
+}
+
+int runDaemonJob(const std::string &path, const int argc, const char* const argv[])
+{
+  for (int ii = countPositionalArgs(argc, argv); ii < argc; ii++)
+  {
+    if (std::strncmp(argv[ii], "--daemon=", 9) != 0)
+    {
+      std::cout << argv[ii] << " only applies when recording here, the daemon doesn't take it" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  const int fd = connectControlSocket(path);
+
+  if (fd < 0)
+  {
+    return __LINE__;
+  }
+
+  ControlConnection connection(fd);
+
+  std::string job = "record";
+
+  for (int ii = 1; ii < countPositionalArgs(argc, argv); ii++)
+  {
+    job += " ";
+    job += argv[ii];
+  }
+
+  if (!connection.writeLine(job))
+  {
+    std::cout << "Lost the recorder daemon sending the job" << std::endl;
+    return __LINE__;
+  }
+
+  std::string reply;
+
+  while (connection.readLine(reply))
+  {
+    std::cout << reply << std::endl;
+
+    if (reply.compare(0, 4, "done") == 0)
+    {
+      return 0;
+    }
+    else if (reply.compare(0, 5, "error") == 0)
+    {
+      return __LINE__;
+    }
+  }
+
+  std::cout << "Lost the recorder daemon before the job was done" << std::endl;
+
+  return __LINE__;
+}
@@ -0,0 +1,60 @@
+#ifndef ControlSocket_H
+#define ControlSocket_H
+
+#include <cstdint>
+#include <string>
+
+// One end of a connection on a Unix domain socket carrying lines of text, the
+// control protocol between recorder_daemon and its clients. A client sends a
+// job as one line and the daemon replies with any number of progress lines
+// followed by one starting "done" or "error".
+class ControlConnection
+{
+public:
+  ControlConnection(const int fd);
+  ~ControlConnection();
+
+  ControlConnection(const ControlConnection &) = delete;
+  ControlConnection& operator=(const ControlConnection &) = delete;
+
+  // Reads and blocking writes that wait longer than this fail as if the other
+  // end had gone away, so a client that connects and says nothing can't hold
+  // up the next one
+  bool setTimeout(const double sec);
+
+  // Both return false once the other end has gone away
+  bool readLine(std::string &line);
+  bool writeLine(const std::string &line);
+
+  // Never blocks: the line is sent if the socket has room for it and dropped
+  // otherwise, for progress lines from a loop that can't wait on a slow
+  // client. Returns false once the other end has gone away.
+  bool offerLine(const std::string &line);
+  std::uint64_t linesDropped() const { return numDropped; }
+
+private:
+  // Send as much of unsent as the socket takes, false if the other end has
+  // gone away
+  bool sendUnsent(const int flags);
+
+  int fd;
+  std::string pending; // read but not yet handed out
+  std::string unsent;  // the rest of a line the socket only took part of
+  std::uint64_t numDropped;
+};
+
+// Returns the listening socket, or -1 having printed why. Any stale socket
+// file left at path by a daemon that didn't exit cleanly is replaced.
+int listenControlSocket(const std::string &path);
+
+// Returns the connected socket, or -1 having printed why
+int connectControlSocket(const std::string &path);
+
+// Sends the positional arguments of a recorder as a record job to the daemon
+// listening at path and prints its replies as they come. Any option other
+// than --daemon= is refused, since it would only have applied to recording
+// here. Returns 0 once the job is done, otherwise the line that failed, like
+// main() does.
+int runDaemonJob(const std::string &path, const int argc, const char* const argv[]);
+
+#endif
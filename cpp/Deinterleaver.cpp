@@ -0,0 +1,521 @@
+#include "Deinterleaver.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // SDIF detection threshold x0*(E - c)*exp(-tau/(k*N)) for E pulses at
+  // difference level c, tau and N being the bin and number of bins
+  const double THRESHOLD_SCALE = 0.2;
+  const double THRESHOLD_DECAY = 0.3;
+
+  // Pulses tried as the start of a sequence search
+  const std::size_t MAX_SEQUENCE_STARTS = 16;
+
+  // PRI relative tolerance when matching a pulse to a train
+  const double PRI_TOLERANCE = 0.01;
+
+  // Weight of a new PDW in a cluster's running mean once it has this many
+  const std::uint64_t MAX_MEAN_LENGTH = 256;
+}
+
+Deinterleaver::Deinterleaver(const double freqToleranceHz, const double pwTolerance, const double maxPriSec, const double priResolutionSec, const std::size_t historyLength, const std::size_t maxClusters) :
+  freqToleranceHz(freqToleranceHz),
+  pwTolerance(pwTolerance),
+  maxPriSec(maxPriSec),
+  priResolutionSec(priResolutionSec),
+  historyLength(std::max(historyLength, MIN_TRAIN_PULSES)),
+  maxClusters(std::max<std::size_t>(maxClusters, 1))
+{
+  clear();
+}
+
+void Deinterleaver::clear()
+{
+  clusters.clear();
+  nextId = 1;
+}
+
+double Deinterleaver::priTolerance(const double priSec) const
+{
+  return std::max(priResolutionSec, PRI_TOLERANCE*priSec);
+}
+
+std::size_t Deinterleaver::findCluster(const Pdw &pdw)
+{
+  // Closest cluster that's within tolerance in both frequency and pulse width
+  std::size_t best = clusters.size();
+  double bestDistance = INFINITY;
+
+  for (std::size_t ii = 0; ii < clusters.size(); ii++)
+  {
+    const double freqDistance = std::abs(pdw.freqHz - clusters[ii].freqHz)/freqToleranceHz;
+    const double pwDistance = std::abs(pdw.pwSec - clusters[ii].pwSec)/(pwTolerance*clusters[ii].pwSec);
+
+    if (freqDistance <= 1 && pwDistance <= 1 && freqDistance + pwDistance < bestDistance)
+    {
+      best = ii;
+      bestDistance = freqDistance + pwDistance;
+    }
+  }
+
+  if (best < clusters.size())
+  {
+    return best;
+  }
+
+  // Start a new cluster, taking the place of the one heard from least recently if there's no room
+  if (clusters.size() < maxClusters)
+  {
+    clusters.emplace_back();
+    best = clusters.size() - 1;
+  }
+  else
+  {
+    best = std::min_element(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.lastToa < b.lastToa; }) - clusters.begin();
+  }
+
+  Cluster &cluster = clusters[best];
+
+  cluster.id = nextId++;
+  cluster.freqHz = pdw.freqHz;
+  cluster.pwSec = pdw.pwSec;
+  cluster.lastToa = pdw.toa;
+  cluster.numPdws = 0;
+  cluster.totalPdws = 0;
+  cluster.toas.clear();
+  cluster.head = 0;
+  cluster.sinceSearch = 0;
+  cluster.trains.clear();
+
+  return best;
+}
+
+// Index of the train a PDW at toa lands closest to a whole number of PRIs
+// after, cluster.trains.size() if none
+std::size_t Deinterleaver::matchTrain(const Cluster &cluster, const double toa) const
+{
+  std::size_t bestTrain = cluster.trains.size();
+  double bestResidual = INFINITY;
+
+  for (std::size_t ii = 0; ii < cluster.trains.size(); ii++)
+  {
+    const PulseTrain &train = cluster.trains[ii];
+    const double tolerance = priTolerance(train.priSec);
+    double residual = INFINITY;
+
+    if (toa - train.lastToa <= (MAX_MISSED_PULSES + 1)*train.priSec)
+    {
+      const double numPris = std::round((toa - train.lastToa)/train.priSec);
+
+      if (numPris >= 1)
+      {
+        residual = std::abs(toa - train.lastToa - numPris*train.priSec);
+      }
+    }
+    else
+    {
+      // The train hasn't been heard from in a while (e.g. between dwells), so
+      // pick its phase back up from the most recent pulses of the cluster
+      for (std::size_t back = 1; back <= std::min(MAX_LEVEL, cluster.toas.size()); back++)
+      {
+        const double previousToa = cluster.toas[(cluster.head + cluster.toas.size() - back) % cluster.toas.size()];
+        const double numPris = std::round((toa - previousToa)/train.priSec);
+
+        if (numPris >= 1 && numPris <= MAX_MISSED_PULSES + 1)
+        {
+          residual = std::min(residual, std::abs(toa - previousToa - numPris*train.priSec));
+        }
+      }
+    }
+
+    if (residual <= tolerance && residual < bestResidual)
+    {
+      bestTrain = ii;
+      bestResidual = residual;
+    }
+  }
+
+  return bestTrain;
+}
+
+std::uint32_t Deinterleaver::add(const Pdw &pdw)
+{
+  Cluster &cluster = clusters[findCluster(pdw)];
+  const std::size_t bestTrain = matchTrain(cluster, pdw.toa);
+
+  cluster.totalPdws++;
+
+  const double weight = 1.0/std::min(cluster.totalPdws, MAX_MEAN_LENGTH);
+  cluster.freqHz += (pdw.freqHz - cluster.freqHz)*weight;
+  cluster.pwSec += (pdw.pwSec - cluster.pwSec)*weight;
+  cluster.lastToa = pdw.toa;
+
+  if (cluster.toas.size() < historyLength)
+  {
+    cluster.toas.push_back(pdw.toa);
+  }
+  else
+  {
+    cluster.toas[cluster.head] = pdw.toa;
+    cluster.head = (cluster.head + 1) % historyLength;
+  }
+
+  cluster.sinceSearch++;
+
+  if (bestTrain < cluster.trains.size())
+  {
+    PulseTrain &train = cluster.trains[bestTrain];
+
+    train.lastToa = pdw.toa;
+    train.numPdws++;
+    train.missedSearches = 0;
+
+    return train.id;
+  }
+
+  cluster.numPdws++;
+
+  return cluster.id;
+}
+
+void Deinterleaver::add(const std::vector<Pdw> &pdws, std::vector<std::uint32_t> &emitterIds)
+{
+  emitterIds.resize(pdws.size());
+
+  for (std::size_t ii = 0; ii < pdws.size(); ii++)
+  {
+    emitterIds[ii] = add(pdws[ii]);
+  }
+}
+
+void Deinterleaver::update(ThreadPool* pool)
+{
+  // Search a cluster again once its history has grown by an eighth, which
+  // keeps the cost per PDW constant
+  std::vector<Cluster*> due;
+
+  for (Cluster &cluster : clusters)
+  {
+    if (cluster.toas.size() >= MIN_TRAIN_PULSES && 8*cluster.sinceSearch >= cluster.toas.size())
+    {
+      due.push_back(&cluster);
+    }
+  }
+
+  if (pool != nullptr && due.size() > 1)
+  {
+    for (Cluster* cluster : due)
+    {
+      pool->submit([this, cluster] { searchCluster(*cluster); });
+    }
+
+    pool->wait();
+  }
+  else
+  {
+    for (Cluster* cluster : due)
+    {
+      searchCluster(*cluster);
+    }
+  }
+
+  // Trains that weren't around before the search, and clusters whose id went
+  // to one, get their ids here so the search itself doesn't touch any shared
+  // state
+  for (Cluster* cluster : due)
+  {
+    if (cluster->id == 0)
+    {
+      cluster->id = nextId++;
+    }
+
+    for (PulseTrain &train : cluster->trains)
+    {
+      if (train.id == 0)
+      {
+        train.id = nextId++;
+      }
+    }
+  }
+}
+
+void Deinterleaver::relabel(const std::vector<Pdw> &pdws, std::vector<std::uint32_t> &emitterIds) const
+{
+  for (std::size_t ii = 0; ii < pdws.size(); ii++)
+  {
+    // The cluster the PDW went to, by its id or the id of one of its trains
+    const auto hasId = [&](const Cluster &cluster)
+    {
+      return cluster.id == emitterIds[ii] || std::any_of(cluster.trains.begin(), cluster.trains.end(), [&](const PulseTrain &train) { return train.id == emitterIds[ii]; });
+    };
+
+    const auto cluster = std::find_if(clusters.begin(), clusters.end(), hasId);
+
+    if (cluster == clusters.end())
+    {
+      continue;
+    }
+
+    // Trains have moved on past these PDWs, so match them a whole number of
+    // PRIs either side of each train's last pulse
+    double bestResidual = INFINITY;
+    emitterIds[ii] = cluster->id;
+
+    for (const PulseTrain &train : cluster->trains)
+    {
+      const double residual = std::abs(std::remainder(pdws[ii].toa - train.lastToa, train.priSec));
+
+      if (residual <= priTolerance(train.priSec) && residual < bestResidual)
+      {
+        emitterIds[ii] = train.id;
+        bestResidual = residual;
+      }
+    }
+  }
+}
+
+void Deinterleaver::searchCluster(Cluster &cluster) const
+{
+  // TOAs of the cluster in time order
+  std::vector<double> toas(cluster.toas.begin() + cluster.head, cluster.toas.end());
+  toas.insert(toas.end(), cluster.toas.begin(), cluster.toas.begin() + cluster.head);
+  std::sort(toas.begin(), toas.end());
+
+  // Indices of the TOAs not yet pulled out in to a train
+  std::vector<std::size_t> remaining(toas.size());
+
+  for (std::size_t ii = 0; ii < remaining.size(); ii++)
+  {
+    remaining[ii] = ii;
+  }
+
+  const std::size_t numBins = std::max<std::size_t>(maxPriSec/priResolutionSec, 3);
+  std::vector<std::uint32_t> histogram(numBins);
+  std::vector<std::uint32_t> cumulative(numBins);
+  std::vector<std::size_t> peaks;
+  std::vector<std::size_t> sequence;
+  std::vector<std::size_t> bestSequence;
+  std::vector<PulseTrain> found;
+
+  const auto threshold = [&](const std::size_t bin, const std::size_t level)
+  {
+    return THRESHOLD_SCALE*(remaining.size() - level)*std::exp(-double(bin)/(THRESHOLD_DECAY*numBins));
+  };
+
+  bool searching = true;
+
+  while (searching && found.size() < MAX_TRAINS && remaining.size() >= MIN_TRAIN_PULSES)
+  {
+    searching = false;
+    std::fill(cumulative.begin(), cumulative.end(), 0);
+
+    for (std::size_t level = 1; level <= MAX_LEVEL && level < remaining.size() && !searching; level++)
+    {
+      // Histogram of the differences between each TOA and the one level before it
+      std::fill(histogram.begin(), histogram.end(), 0);
+
+      for (std::size_t ii = level; ii < remaining.size(); ii++)
+      {
+        const std::size_t bin = (toas[remaining[ii]] - toas[remaining[ii-level]])/priResolutionSec;
+
+        if (bin < numBins)
+        {
+          histogram[bin]++;
+          cumulative[bin]++;
+        }
+      }
+
+      // Peaks of the differences up to this level over the threshold, counting
+      // a bin along with its neighbours so a PRI that falls on a bin edge isn't
+      // split in two. Taking them from the cumulative histogram keeps a PRI
+      // that turned up at a lower level in the running while its harmonic
+      // builds up at the higher ones, which it does when another train's
+      // pulses fall between its own.
+      peaks.clear();
+
+      for (std::size_t bin = 1; bin + 1 < numBins; bin++)
+      {
+        const std::uint32_t count = cumulative[bin-1] + cumulative[bin] + cumulative[bin+1];
+
+        if (count > threshold(bin, level) && cumulative[bin] >= cumulative[bin-1] && cumulative[bin] > cumulative[bin+1])
+        {
+          peaks.push_back(bin);
+        }
+      }
+
+      for (const std::size_t bin : peaks)
+      {
+        // A lone peak at the first level is the PRI, otherwise it has to have
+        // its second harmonic in the CDIF as well to rule out the difference
+        // between two other trains
+        if (level > 1 || peaks.size() > 1)
+        {
+          const std::size_t harmonic = 2*bin;
+
+          if (harmonic + 1 < numBins && cumulative[harmonic-1] + cumulative[harmonic] + cumulative[harmonic+1] <= threshold(harmonic, level))
+          {
+            continue;
+          }
+        }
+
+        const double weight = cumulative[bin-1] + cumulative[bin] + cumulative[bin+1];
+        const double priSec = priResolutionSec*(bin + 0.5 + (double(cumulative[bin+1]) - cumulative[bin-1])/weight);
+        const double tolerance = priTolerance(priSec);
+
+        // Sequence search, following the PRI from each of the earliest pulses
+        // and bridging a few missing pulses, keeping the longest sequence
+        bestSequence.clear();
+
+        for (std::size_t start = 0; start < std::min(MAX_SEQUENCE_STARTS, remaining.size()); start++)
+        {
+          sequence.assign(1, start);
+
+          double expected = toas[remaining[start]] + priSec;
+          std::size_t missed = 0;
+          std::size_t next = start + 1;
+
+          while (next < remaining.size() && missed <= MAX_MISSED_PULSES)
+          {
+            while (next < remaining.size() && toas[remaining[next]] < expected - tolerance)
+            {
+              next++;
+            }
+
+            if (next < remaining.size() && toas[remaining[next]] <= expected + tolerance)
+            {
+              sequence.push_back(next);
+              expected = toas[remaining[next]] + priSec;
+              missed = 0;
+              next++;
+            }
+            else
+            {
+              expected += priSec;
+              missed++;
+            }
+          }
+
+          if (sequence.size() > bestSequence.size())
+          {
+            bestSequence.swap(sequence);
+          }
+        }
+
+        if (bestSequence.size() < MIN_TRAIN_PULSES)
+        {
+          continue;
+        }
+
+        // Refine the PRI over the whole sequence and pull it out. The number of
+        // PRIs is counted a step at a time since the histogram estimate isn't
+        // good enough to divide in to the whole span.
+        const double firstToa = toas[remaining[bestSequence.front()]];
+        const double lastToa = toas[remaining[bestSequence.back()]];
+        double numPris = 0;
+
+        for (std::size_t ii = 1; ii < bestSequence.size(); ii++)
+        {
+          numPris += std::round((toas[remaining[bestSequence[ii]]] - toas[remaining[bestSequence[ii-1]]])/priSec);
+        }
+
+        PulseTrain train;
+        train.id = 0;
+        train.priSec = (lastToa - firstToa)/numPris;
+        train.lastToa = lastToa;
+        train.numPdws = 0;
+        train.missedSearches = 0;
+
+        found.push_back(train);
+
+        for (std::size_t ii = bestSequence.size(); ii-- > 0;)
+        {
+          remaining.erase(remaining.begin() + bestSequence[ii]);
+        }
+
+        // Start again from the first level with what's left
+        searching = true;
+        break;
+      }
+    }
+  }
+
+  // A sequence search can't bridge the gap between dwells, so a train heard
+  // in several of them is found once per dwell; those are all the one train
+  for (std::size_t ii = 0; ii < found.size(); ii++)
+  {
+    for (std::size_t jj = found.size(); jj-- > ii + 1;)
+    {
+      if (std::abs(found[jj].priSec - found[ii].priSec) <= priTolerance(found[ii].priSec))
+      {
+        found[ii].lastToa = std::max(found[ii].lastToa, found[jj].lastToa);
+        found.erase(found.begin() + jj);
+      }
+    }
+  }
+
+  // Trains that were already known keep their id and count
+  for (PulseTrain &train : found)
+  {
+    for (PulseTrain &previous : cluster.trains)
+    {
+      if (previous.id != 0 && std::abs(train.priSec - previous.priSec) <= priTolerance(previous.priSec))
+      {
+        train.id = previous.id;
+        train.numPdws = previous.numPdws;
+        train.lastToa = std::max(train.lastToa, previous.lastToa);
+        previous.id = 0;
+        break;
+      }
+    }
+  }
+
+  // The PDWs that fit no train so far were most likely the first new train's,
+  // so it takes over the cluster's id and the cluster gets a new one
+  for (PulseTrain &train : found)
+  {
+    if (train.id == 0 && cluster.numPdws > 0)
+    {
+      train.id = cluster.id;
+      train.numPdws = cluster.numPdws;
+      cluster.id = 0;
+      cluster.numPdws = 0;
+      break;
+    }
+  }
+
+  // Known trains this search missed are kept, while there's room, until
+  // they've been missed too many times in a row
+  for (PulseTrain &previous : cluster.trains)
+  {
+    if (previous.id != 0 && found.size() < MAX_TRAINS && ++previous.missedSearches < MAX_MISSED_SEARCHES)
+    {
+      found.push_back(previous);
+    }
+  }
+
+  cluster.trains.swap(found);
+  cluster.sinceSearch = 0;
+}
+
+std::vector<Emitter> Deinterleaver::emitters() const
+{
+  std::vector<Emitter> result;
+
+  for (const Cluster &cluster : clusters)
+  {
+    if (cluster.numPdws > 0 || cluster.trains.empty())
+    {
+      result.push_back({cluster.id, cluster.freqHz, cluster.pwSec, 0, cluster.lastToa, cluster.numPdws});
+    }
+
+    for (const PulseTrain &train : cluster.trains)
+    {
+      result.push_back({train.id, cluster.freqHz, cluster.pwSec, train.priSec, train.lastToa, train.numPdws});
+    }
+  }
+
+  return result;
+}
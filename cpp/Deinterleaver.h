@@ -0,0 +1,110 @@
+#ifndef Deinterleaver_H
+#define Deinterleaver_H
+
+#include "Pdw.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+struct Emitter
+{
+  std::uint32_t id;
+  double freqHz;         // mean frequency of the cluster the emitter belongs to (Hz)
+  double pwSec;          // mean pulse width of the cluster (sec)
+  double priSec;         // 0 until a pulse train has been found for it (sec)
+  double lastToa;        // TOA of the last PDW assigned to it (sec from the epoch)
+  std::uint64_t numPdws; // PDWs assigned to it since it was created
+};
+
+// Separates interleaved emitters in a stream of PDWs. Each PDW is first put
+// in a cluster of PDWs with a similar frequency and pulse width, then matched
+// against the pulse trains (PRIs) found in that cluster so far. Those trains
+// come from a sequential difference (SDIF) histogram of the cluster's recent
+// TOAs with the cumulative (CDIF) subharmonic check, followed by a sequence
+// search that pulls each train out before looking for the next one. Every
+// train is reported as its own emitter, as is whatever in a cluster doesn't
+// fit a train.
+//
+// PDWs are added as they arrive, in TOA order. Each cluster only keeps its
+// last historyLength TOAs and there are at most maxClusters clusters, so
+// memory stays bounded however many PDWs go through. update() reruns the PRI
+// search on the clusters that have taken enough new PDWs since their last
+// search; clusters are independent so they can be searched in parallel.
+//
+// An emitter keeps its id from its first PDW: the first train found in a
+// cluster takes over the cluster's id, since the cluster's PDWs so far were
+// that emitter's, and a train a search misses (e.g. it was masked for a
+// dwell) is kept for a few more searches so it keeps its id if it's found
+// again. PDWs added before the search that found their train can be given
+// that train's id with relabel().
+class Deinterleaver
+{
+public:
+  Deinterleaver(const double freqToleranceHz, const double pwTolerance, const double maxPriSec, const double priResolutionSec, const std::size_t historyLength = 4096, const std::size_t maxClusters = 64);
+
+  // Returns the id of the emitter the PDW was assigned to
+  std::uint32_t add(const Pdw &pdw);
+  void add(const std::vector<Pdw> &pdws, std::vector<std::uint32_t> &emitterIds);
+
+  // Search for pulse trains in the clusters that need it, on pool if given
+  void update(ThreadPool* pool = nullptr);
+
+  // Match PDWs given ids by add() against the trains of their clusters as they
+  // are after update(), so the PDWs a new train was found from get its id
+  void relabel(const std::vector<Pdw> &pdws, std::vector<std::uint32_t> &emitterIds) const;
+
+  void clear();
+
+  std::vector<Emitter> emitters() const;
+  std::size_t numClusters() const { return clusters.size(); }
+
+private:
+  static constexpr std::size_t MAX_LEVEL = 4;         // highest difference level of the SDIF
+  static constexpr std::size_t MAX_TRAINS = 8;        // pulse trains kept per cluster
+  static constexpr std::size_t MIN_TRAIN_PULSES = 5;  // pulses in a sequence before it counts as a train
+  static constexpr std::size_t MAX_MISSED_PULSES = 3; // consecutive missing pulses a sequence search will bridge
+  static constexpr std::size_t MAX_MISSED_SEARCHES = 4; // searches in a row a known train can go unfound before it's dropped
+
+  struct PulseTrain
+  {
+    std::uint32_t id;
+    double priSec;
+    double lastToa;
+    std::uint64_t numPdws;
+    std::size_t missedSearches; // searches in a row that didn't find it
+  };
+
+  struct Cluster
+  {
+    std::uint32_t id; // emitter id of the PDWs that don't fit any train, 0 until update() gives it a new one
+    double freqHz;
+    double pwSec;
+    double lastToa;
+    std::uint64_t numPdws;       // PDWs assigned to the cluster but to none of its trains
+    std::uint64_t totalPdws;     // every PDW assigned to the cluster, for the running means
+    std::vector<double> toas;    // ring of the last historyLength TOAs
+    std::size_t head;            // index of the oldest TOA once the ring is full
+    std::size_t sinceSearch;     // TOAs added since the last PRI search
+    std::vector<PulseTrain> trains;
+  };
+
+  std::size_t findCluster(const Pdw &pdw);
+  std::size_t matchTrain(const Cluster &cluster, const double toa) const;
+  void searchCluster(Cluster &cluster) const;
+  double priTolerance(const double priSec) const;
+
+  double freqToleranceHz;
+  double pwTolerance; // fraction of the cluster's pulse width
+  double maxPriSec;
+  double priResolutionSec;
+  std::size_t historyLength;
+  std::size_t maxClusters;
+
+  std::vector<Cluster> clusters;
+  std::uint32_t nextId;
+};
+
+#endif
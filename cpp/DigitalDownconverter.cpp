@@ -0,0 +1,330 @@
+#include "DigitalDownconverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  // Stopband attenuation the FIR is designed for
+  const double FIR_ATTENUATION_DB = 60;
+
+  // Output rate relative to the bandwidth, leaving room for the transition band
+  const double OVERSAMPLING = 1.25;
+
+  const std::size_t MIN_TAPS = 15;
+  const std::size_t MAX_TAPS = 255;
+
+  // Zeroth order modified Bessel function of the first kind, for the Kaiser window
+  double besselI0(const double x)
+  {
+    double sum = 1;
+    double term = 1;
+
+    for (int k = 1; k < 50 && term > 1e-12*sum; k++)
+    {
+      term *= (x/(2*k))*(x/(2*k));
+      sum += term;
+    }
+
+    return sum;
+  }
+}
+
+DigitalDownconverter::DigitalDownconverter(const double sampleRateSps, const double offsetHz, const double bandwidthHz, const float outputScale) :
+  sampleRateSps(sampleRateSps),
+  outputScale(outputScale),
+  rotationRe(CHUNK_SIZE),
+  rotationIm(CHUNK_SIZE),
+  mixedRe(CHUNK_SIZE),
+  mixedIm(CHUNK_SIZE)
+{
+  // The NCO runs at -offsetHz so the sub-band lands on DC. Wrapping the
+  // frequency into [0, fs) makes it a plain unsigned phase step.
+  const double cycles = -offsetHz/sampleRateSps;
+  const double wrapped = cycles - std::floor(cycles);
+  phaseIncrement = std::uint64_t(std::ldexp(wrapped, 64));
+
+  for (std::size_t k = 0; k < CHUNK_SIZE; k++)
+  {
+    // Multiply in integers modulo 2^64 so the table agrees exactly with the
+    // phase accumulator
+    const double angle = 2*M_PI*std::ldexp(double(phaseIncrement*k), -64);
+
+    rotationRe[k] = std::cos(angle);
+    rotationIm[k] = std::sin(angle);
+  }
+
+  const double bandwidth = std::min(bandwidthHz, maxBandwidth(sampleRateSps));
+
+  cicDecimation = std::size_t(sampleRateSps/(FIR_DECIMATION*OVERSAMPLING*bandwidth));
+  cicDecimation = std::clamp<std::size_t>(cicDecimation, 1, MAX_CIC_DECIMATION);
+
+  // Back off to a decimation that divides the sample rate if there's one
+  // close by, so the output rate is a whole number of samples per second,
+  // which is all an IqPacket can hold
+  for (std::size_t r = cicDecimation; r > cicDecimation/2; r--)
+  {
+    if (std::fmod(sampleRateSps, double(r*FIR_DECIMATION)) == 0)
+    {
+      cicDecimation = r;
+      break;
+    }
+  }
+
+  cicScale = 1/(std::pow(double(cicDecimation), double(CIC_ORDER))*MIXER_SCALE);
+
+  designFir(bandwidth);
+  reset();
+}
+
+void DigitalDownconverter::reset()
+{
+  phase = 0;
+  cicPhase = 0;
+
+  std::fill(integratorRe, integratorRe + CIC_ORDER, 0);
+  std::fill(integratorIm, integratorIm + CIC_ORDER, 0);
+  std::fill(combRe, combRe + CIC_ORDER, 0);
+  std::fill(combIm, combIm + CIC_ORDER, 0);
+
+  firRe.assign(taps.size() - 1, 0);
+  firIm.assign(taps.size() - 1, 0);
+  firPhase = 0;
+}
+
+double DigitalDownconverter::maxBandwidth(const double sampleRateSps)
+{
+  return sampleRateSps/(FIR_DECIMATION*OVERSAMPLING);
+}
+
+double DigitalDownconverter::offsetHz() const
+{
+  const double cycles = std::ldexp(double(phaseIncrement), -64);
+
+  return -(cycles < 0.5 ? cycles : cycles - 1)*sampleRateSps;
+}
+
+double DigitalDownconverter::outputTimeOffset() const
+{
+  // The first output is the FIR centered (taps-1)/2 CIC outputs before the
+  // first one, which is itself centered N*(R-1)/2 inputs before its last input
+  const double R = cicDecimation;
+
+  return (R - 1) - CIC_ORDER*(R - 1)/2 - R*(taps.size() - 1)/2.0;
+}
+
+void DigitalDownconverter::designFir(const double bandwidthHz)
+{
+  // The FIR runs at the CIC output rate. Everything up to the band edge is
+  // passed with the CIC droop taken out and everything that would alias back
+  // into the band after the final decimation is stopped.
+  const double inputRate = sampleRateSps/cicDecimation;
+  const double outputRate = inputRate/FIR_DECIMATION;
+  const double passEdge = bandwidthHz/2;
+  const double stopEdge = std::max(outputRate - passEdge, passEdge*1.05);
+
+  // Kaiser's estimate of the length needed, kept odd so the filter has a
+  // whole sample of delay
+  const double transition = 2*M_PI*(stopEdge - passEdge)/inputRate;
+  std::size_t numTaps = std::size_t(std::ceil((FIR_ATTENUATION_DB - 8)/(2.285*transition))) + 1;
+  numTaps = std::clamp(numTaps | 1, MIN_TAPS, MAX_TAPS);
+
+  const double R = cicDecimation;
+  auto cicResponse = [&](const double f)
+  {
+    const double x = M_PI*f/sampleRateSps;
+    const double response = (x == 0) ? 1 : std::sin(R*x)/(R*std::sin(x));
+
+    return std::pow(std::abs(response), double(CIC_ORDER));
+  };
+
+  // Desired response: inverse CIC in the passband, falling linearly to 0
+  // across the transition band
+  auto desired = [&](const double f)
+  {
+    if (f <= passEdge)
+    {
+      return 1/cicResponse(f);
+    }
+    else if (f < stopEdge)
+    {
+      return (stopEdge - f)/(stopEdge - passEdge)/cicResponse(passEdge);
+    }
+
+    return 0.0;
+  };
+
+  // Frequency sampling: integrate the desired response against a cosine for
+  // each tap, then taper with a Kaiser window
+  const std::size_t GRID_SIZE = 4096;
+  const double beta = 0.1102*(FIR_ATTENUATION_DB - 8.7);
+  const double center = (numTaps - 1)/2.0;
+
+  std::vector<double> response(GRID_SIZE + 1);
+
+  for (std::size_t g = 0; g <= GRID_SIZE; g++)
+  {
+    response[g] = desired(g*inputRate/(2*GRID_SIZE));
+  }
+
+  taps.resize(numTaps);
+  double sum = 0;
+
+  for (std::size_t n = 0; n < numTaps; n++)
+  {
+    const double t = n - center;
+    double h = 0;
+
+    for (std::size_t g = 0; g <= GRID_SIZE; g++)
+    {
+      const double weight = (g == 0 || g == GRID_SIZE) ? 0.5 : 1;
+
+      h += weight*response[g]*std::cos(M_PI*g*t/GRID_SIZE);
+    }
+
+    const double r = t/center;
+    const double window = besselI0(beta*std::sqrt(std::max(0.0, 1 - r*r)))/besselI0(beta);
+
+    taps[n] = h*window;
+    sum += taps[n];
+  }
+
+  // Unity gain at DC
+  for (float &tap : taps)
+  {
+    tap /= sum;
+  }
+}
+
+std::size_t DigitalDownconverter::process(const std::complex<std::int16_t>* iq, const std::size_t numSamples, std::complex<std::int16_t>* out)
+{
+  std::size_t numOutputs = 0;
+
+  for (std::size_t blockStart = 0; blockStart < numSamples; blockStart += BLOCK_SIZE)
+  {
+    numOutputs += processBlock(&iq[blockStart], std::min(BLOCK_SIZE, numSamples - blockStart), &out[numOutputs]);
+  }
+
+  return numOutputs;
+}
+
+std::size_t DigitalDownconverter::process(const std::complex<std::int8_t>* iq, const std::size_t numSamples, std::complex<std::int16_t>* out)
+{
+  std::size_t numOutputs = 0;
+
+  for (std::size_t blockStart = 0; blockStart < numSamples; blockStart += BLOCK_SIZE)
+  {
+    numOutputs += processBlock(&iq[blockStart], std::min(BLOCK_SIZE, numSamples - blockStart), &out[numOutputs]);
+  }
+
+  return numOutputs;
+}
+
+template <typename T>
+std::size_t DigitalDownconverter::processBlock(const std::complex<T>* iq, const std::size_t numSamples, std::complex<std::int16_t>* out)
+{
+  const T* values = reinterpret_cast<const T*>(iq);
+
+  for (std::size_t chunkStart = 0; chunkStart < numSamples; chunkStart += CHUNK_SIZE)
+  {
+    const std::size_t count = std::min(CHUNK_SIZE, numSamples - chunkStart);
+    const T* v = &values[2*chunkStart];
+
+    // Phasor of the first sample of the chunk straight from the accumulator
+    const double angle = 2*M_PI*std::ldexp(double(phase), -64);
+    const float phasorRe = MIXER_SCALE*std::cos(angle);
+    const float phasorIm = MIXER_SCALE*std::sin(angle);
+
+    phase += phaseIncrement*count;
+
+    // Mix to DC and keep MIXER_SCALE worth of fraction bits as integers
+    for (std::size_t ii = 0; ii < count; ii++)
+    {
+      const float rotRe = phasorRe*rotationRe[ii] - phasorIm*rotationIm[ii];
+      const float rotIm = phasorRe*rotationIm[ii] + phasorIm*rotationRe[ii];
+      const float re = v[2*ii];
+      const float im = v[2*ii + 1];
+
+      mixedRe[ii] = std::int32_t(re*rotRe - im*rotIm);
+      mixedIm[ii] = std::int32_t(re*rotIm + im*rotRe);
+    }
+
+    // CIC integrators at the input rate, combs at the decimated rate. The
+    // arithmetic is modulo 2^64 which the combs undo exactly.
+    for (std::size_t ii = 0; ii < count; ii++)
+    {
+      std::uint64_t re = std::uint64_t(std::int64_t(mixedRe[ii]));
+      std::uint64_t im = std::uint64_t(std::int64_t(mixedIm[ii]));
+
+      for (std::size_t s = 0; s < CIC_ORDER; s++)
+      {
+        integratorRe[s] += re;
+        integratorIm[s] += im;
+        re = integratorRe[s];
+        im = integratorIm[s];
+      }
+
+      if (++cicPhase == cicDecimation)
+      {
+        cicPhase = 0;
+
+        for (std::size_t s = 0; s < CIC_ORDER; s++)
+        {
+          const std::uint64_t previousRe = combRe[s];
+          const std::uint64_t previousIm = combIm[s];
+
+          combRe[s] = re;
+          combIm[s] = im;
+          re -= previousRe;
+          im -= previousIm;
+        }
+
+        firRe.push_back(std::int64_t(re)*cicScale);
+        firIm.push_back(std::int64_t(im)*cicScale);
+      }
+    }
+  }
+
+  // FIR outputs at every FIR_DECIMATION'th CIC output. Looping over the taps
+  // outside and the outputs inside keeps the inner loop free of reductions.
+  const std::size_t history = taps.size() - 1;
+  const std::size_t available = firRe.size() - history;
+  const std::size_t numOutputs = (available > firPhase) ? (available - firPhase + FIR_DECIMATION - 1)/FIR_DECIMATION : 0;
+
+  outRe.assign(numOutputs, 0);
+  outIm.assign(numOutputs, 0);
+
+  for (std::size_t k = 0; k < taps.size(); k++)
+  {
+    const float tap = taps[k];
+    const float* xRe = &firRe[firPhase + k];
+    const float* xIm = &firIm[firPhase + k];
+
+    for (std::size_t m = 0; m < numOutputs; m++)
+    {
+      outRe[m] += tap*xRe[FIR_DECIMATION*m];
+      outIm[m] += tap*xIm[FIR_DECIMATION*m];
+    }
+  }
+
+  const float limit = std::numeric_limits<std::int16_t>::max();
+
+  for (std::size_t m = 0; m < numOutputs; m++)
+  {
+    const float re = std::clamp(std::nearbyint(outRe[m]*outputScale), -limit, limit);
+    const float im = std::clamp(std::nearbyint(outIm[m]*outputScale), -limit, limit);
+
+    out[m] = std::complex<std::int16_t>(re, im);
+  }
+
+  // Keep the history the next block's first outputs need
+  const std::size_t consumed = firPhase + numOutputs*FIR_DECIMATION;
+  const std::size_t keepFrom = std::min(consumed, firRe.size() - history);
+
+  firPhase = consumed - keepFrom;
+  firRe.erase(firRe.begin(), firRe.begin() + keepFrom);
+  firIm.erase(firIm.begin(), firIm.begin() + keepFrom);
+
+  return numOutputs;
+}
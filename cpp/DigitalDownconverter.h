@@ -0,0 +1,85 @@
+#ifndef DigitalDownconverter_H
+#define DigitalDownconverter_H
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <vector>
+
+// Pulls a narrow sub-band out of a wide I/Q stream without retuning the LO.
+// An NCO mixes the sub-band at offsetHz down to DC, a CIC filter decimates it
+// by most of the way and a short FIR, whose passband undoes the CIC droop,
+// takes off the last factor of 2 and sets the band edges. The NCO phase is a
+// 64-bit accumulator that's only turned into a phasor once per chunk, with a
+// fixed table of rotations within the chunk, so mixing is one vectorized
+// complex multiply per sample and the phase stays continuous across calls
+// without ever drifting. The CIC runs on integers, where its wrap around is
+// harmless, and the FIR is evaluated across outputs so it vectorizes too.
+class DigitalDownconverter
+{
+public:
+  // outputScale converts input ADC counts to output counts, e.g. 256 to put
+  // 8-bit samples in the top of the 16-bit output
+  DigitalDownconverter(const double sampleRateSps, const double offsetHz, const double bandwidthHz, const float outputScale = 1);
+
+  // Forget the filter history and restart the NCO at zero phase, e.g.
+  // between dwells that aren't contiguous
+  void reset();
+
+  // Returns the number of samples written to out, which must have room for
+  // maxOutputSamples(numSamples)
+  std::size_t process(const std::complex<std::int16_t>* iq, const std::size_t numSamples, std::complex<std::int16_t>* out);
+  std::size_t process(const std::complex<std::int8_t>* iq, const std::size_t numSamples, std::complex<std::int16_t>* out);
+
+  std::size_t maxOutputSamples(const std::size_t numSamples) const { return numSamples/decimation() + 1; }
+  std::size_t decimation() const { return cicDecimation*FIR_DECIMATION; }
+  double outputSampleRate() const { return sampleRateSps/decimation(); }
+  double offsetHz() const; // the NCO frequency actually used
+
+  // Input samples from the time of the first input sample after a reset to
+  // the time the first output sample represents, like Channelizer's
+  double outputTimeOffset() const;
+
+  // Widest band that can be pulled out of a stream at this rate
+  static double maxBandwidth(const double sampleRateSps);
+
+private:
+  static constexpr std::size_t CIC_ORDER = 4;
+  static constexpr std::size_t FIR_DECIMATION = 2;
+  static constexpr std::size_t MAX_CIC_DECIMATION = 512; // keeps the CIC's bit growth inside 64 bits
+  static constexpr std::size_t CHUNK_SIZE = 256;          // samples mixed per NCO phasor
+  static constexpr std::size_t BLOCK_SIZE = 65536;        // input samples filtered at a time
+  static constexpr float MIXER_SCALE = 256;               // fraction bits kept when the mixer output goes to integers
+
+  template <typename T>
+  std::size_t processBlock(const std::complex<T>* iq, const std::size_t numSamples, std::complex<std::int16_t>* out);
+
+  void designFir(const double bandwidthHz);
+
+  double sampleRateSps;
+  float outputScale;
+  std::uint64_t phaseIncrement; // NCO step per sample, in 2^-64 cycles
+  std::uint64_t phase;
+
+  std::vector<float> rotationRe; // e^(-j*2*pi*f*k/fs) for k < CHUNK_SIZE
+  std::vector<float> rotationIm;
+  std::vector<std::int32_t> mixedRe;
+  std::vector<std::int32_t> mixedIm;
+
+  std::size_t cicDecimation;
+  std::size_t cicPhase; // inputs integrated since the last CIC output
+  std::uint64_t integratorRe[CIC_ORDER];
+  std::uint64_t integratorIm[CIC_ORDER];
+  std::uint64_t combRe[CIC_ORDER];
+  std::uint64_t combIm[CIC_ORDER];
+  float cicScale; // undoes the CIC gain and the mixer scale
+
+  std::vector<float> taps;
+  std::vector<float> firRe; // last taps.size()-1 CIC outputs followed by this block's
+  std::vector<float> firIm;
+  std::size_t firPhase;     // CIC outputs to skip before the next FIR output
+  std::vector<float> outRe;
+  std::vector<float> outIm;
+};
+
+#endif
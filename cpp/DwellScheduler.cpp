@@ -0,0 +1,55 @@
+#include "DwellScheduler.h"
+
+#include <algorithm>
+
+DwellScheduler::DwellScheduler(const double maxDwellSec, const double minGapSec) :
+  maxDwellSec(maxDwellSec),
+  minGapSec(minGapSec)
+{
+}
+
+void DwellScheduler::schedule(const std::vector<EventPrediction> &predictions, std::vector<ScheduledDwell> &dwells)
+{
+  dwells.clear();
+
+  byConfidence = predictions;
+  std::stable_sort(byConfidence.begin(), byConfidence.end(), [](const EventPrediction &a, const EventPrediction &b) { return a.confidence > b.confidence; });
+
+  for (const EventPrediction &prediction : byConfidence)
+  {
+    // A window longer than a whole dwell keeps its middle
+    const double halfWidth = std::min(prediction.halfWidthSec, maxDwellSec/2);
+    double start = prediction.time - halfWidth;
+    double end = prediction.time + halfWidth;
+
+    // Dwells this window would have to be merged with
+    std::vector<ScheduledDwell>::iterator first = std::lower_bound(dwells.begin(), dwells.end(), start - minGapSec, [](const ScheduledDwell &dwell, const double t) { return dwell.endTime < t; });
+    std::vector<ScheduledDwell>::iterator last = first;
+
+    while (last != dwells.end() && last->startTime <= end + minGapSec)
+    {
+      start = std::min(start, last->startTime);
+      end = std::max(end, last->endTime);
+      last++;
+    }
+
+    if (end - start > maxDwellSec)
+    {
+      // Every dwell already placed is for a more confident track
+      continue;
+    }
+
+    ScheduledDwell merged;
+    merged.startTime = start;
+    merged.endTime = end;
+    merged.trackIds.push_back(prediction.trackId);
+
+    for (std::vector<ScheduledDwell>::iterator it = first; it != last; it++)
+    {
+      merged.trackIds.insert(merged.trackIds.end(), it->trackIds.begin(), it->trackIds.end());
+    }
+
+    first = dwells.erase(first, last);
+    dwells.insert(first, merged);
+  }
+}
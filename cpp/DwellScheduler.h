@@ -0,0 +1,38 @@
+#ifndef DwellScheduler_H
+#define DwellScheduler_H
+
+#include "EventTracker.h"
+
+#include <cstdint>
+#include <vector>
+
+struct ScheduledDwell
+{
+  double startTime; // UTC time of the first sample
+  double endTime;
+  std::vector<std::uint32_t> trackIds; // tracks whose predicted event this dwell covers
+
+  double duration() const { return endTime - startTime; }
+};
+
+// Turns the predicted event windows of every track in to as few short, timed
+// dwells as possible. Windows that overlap, or sit closer together than the
+// time it takes to set up another dwell, share one dwell so long as it stays
+// under the longest dwell the receive buffer holds. When they can't all fit,
+// windows are placed in order of confidence and the less confident ones that
+// clash with a dwell already placed are dropped.
+class DwellScheduler
+{
+public:
+  DwellScheduler(const double maxDwellSec, const double minGapSec);
+
+  // Dwells come out in time order
+  void schedule(const std::vector<EventPrediction> &predictions, std::vector<ScheduledDwell> &dwells);
+
+private:
+  double maxDwellSec;
+  double minGapSec;
+  std::vector<EventPrediction> byConfidence;
+};
+
+#endif
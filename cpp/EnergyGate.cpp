@@ -0,0 +1,90 @@
+#include "EnergyGate.h"
+
+#include <algorithm>
+#include <cmath>
+
+EnergyGate::EnergyGate(const float snrThresholdDb, const std::size_t blockSize) :
+  blockSize(std::max<std::size_t>(blockSize, 1)),
+  noiseMagnitude(0),
+  peakMagnitude(0)
+{
+  // SNR is expressed as a magnitude ratio everywhere else so square it for power
+  const float magnitudeScale = std::pow(10.0f, snrThresholdDb/10);
+  powerScale = magnitudeScale*magnitudeScale;
+}
+
+bool EnergyGate::process(const std::complex<std::int16_t>* iq, const std::size_t numSamples)
+{
+  return processSamples(iq, numSamples);
+}
+
+bool EnergyGate::process(const std::complex<std::int8_t>* iq, const std::size_t numSamples)
+{
+  return processSamples(iq, numSamples);
+}
+
+template <typename T>
+bool EnergyGate::processSamples(const std::complex<T>* iq, const std::size_t numSamples)
+{
+  const std::size_t numBlocks = (numSamples + blockSize - 1)/blockSize;
+
+  blockMeans.resize(numBlocks);
+  blockPeaks.resize(numBlocks);
+
+  // Work on the interleaved I and Q values so the loops are plain integer
+  // multiply/add/max that the compiler turns into SIMD. I^2 + Q^2 of 16-bit
+  // values needs all 32 bits, so the sums are unsigned.
+  const T* values = reinterpret_cast<const T*>(iq);
+
+  for (std::size_t block = 0; block < numBlocks; block++)
+  {
+    const std::size_t first = block*blockSize;
+    const std::size_t count = std::min(blockSize, numSamples - first);
+    const T* v = &values[2*first];
+
+    std::uint64_t sum = 0;
+    std::uint32_t peak = 0;
+
+    for (std::size_t ii = 0; ii < count; ii++)
+    {
+      const std::int32_t i = v[2*ii];
+      const std::int32_t q = v[2*ii + 1];
+      const std::uint32_t power = std::uint32_t(i*i) + std::uint32_t(q*q);
+
+      sum += power;
+      peak = std::max(peak, power);
+    }
+
+    blockMeans[block] = float(sum)/count;
+    blockPeaks[block] = peak;
+  }
+
+  if (numBlocks == 0)
+  {
+    noiseMagnitude = 0;
+    peakMagnitude = 0;
+    return false;
+  }
+
+  const std::uint32_t peakPower = *std::max_element(blockPeaks.begin(), blockPeaks.end());
+
+  std::nth_element(blockMeans.begin(), blockMeans.begin() + numBlocks/2, blockMeans.end());
+  const float noisePower = blockMeans[numBlocks/2];
+
+  noiseMagnitude = std::sqrt(noisePower);
+  peakMagnitude = std::sqrt(float(peakPower));
+
+  return peakPower > powerScale*noisePower;
+}
+
+float EnergyGate::peakSnrDb() const
+{
+  return (noiseMagnitude > 0 && peakMagnitude > 0) ? 10*std::log10(peakMagnitude/noiseMagnitude) : 0;
+}
+
+float EnergyGate::noisePeakSnrDb(const std::size_t numSamples)
+{
+  // Expected largest of numSamples exponentially distributed powers over
+  // their mean, log(N) + Euler's constant, as a magnitude ratio
+  return (numSamples > 1) ? 5*std::log10(std::log(double(numSamples)) + 0.5772) : 0;
+}
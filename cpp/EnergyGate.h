@@ -0,0 +1,51 @@
+#ifndef EnergyGate_H
+#define EnergyGate_H
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <vector>
+
+// Cheap check of whether a dwell holds anything but noise, run on the raw
+// integer samples before they're written. The dwell is split into blocks and
+// each block's mean and peak power are found in one pass of integer math that
+// vectorizes. The noise floor is the median of the block means, which a few
+// blocks with pulses in them don't move, and the dwell passes if the peak of
+// any block is snrThresholdDb above it. SNR is a magnitude ratio, the same as
+// the SNR of a PDW.
+//
+// The peak is of single samples but the floor is a mean, so even a dwell of
+// pure noise peaks well above it: the largest of N noise powers averages
+// ln(N) + 0.577 times their mean, about 5.8 dB for 10^6 samples. The
+// threshold has to clear that, noisePeakSnrDb() gives it for a dwell length.
+class EnergyGate
+{
+public:
+  EnergyGate(const float snrThresholdDb, const std::size_t blockSize = 1024);
+
+  // Returns true if the dwell should be kept
+  bool process(const std::complex<std::int16_t>* iq, const std::size_t numSamples);
+  bool process(const std::complex<std::int8_t>* iq, const std::size_t numSamples);
+
+  // RMS magnitude of the median block and peak magnitude of the last dwell,
+  // in ADC counts
+  float noiseFloor() const { return noiseMagnitude; }
+  float peak() const { return peakMagnitude; }
+  float peakSnrDb() const;
+
+  // peakSnrDb() a dwell of numSamples of pure noise averages
+  static float noisePeakSnrDb(const std::size_t numSamples);
+
+private:
+  template <typename T>
+  bool processSamples(const std::complex<T>* iq, const std::size_t numSamples);
+
+  float powerScale; // peak power over noise power needed to pass
+  std::size_t blockSize;
+  std::vector<float> blockMeans;
+  std::vector<std::uint32_t> blockPeaks;
+  float noiseMagnitude;
+  float peakMagnitude;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "EventTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // Confidence of a track once it starts predicting, and how much it's pulled
+  // towards 1 by a hit and towards 0 by a miss
+  const float INITIAL_CONFIDENCE = 0.5;
+  const float HIT_GAIN = 0.25;
+  const float MISS_FACTOR = 0.5;
+  const float MIN_CONFIDENCE = 0.05;
+
+  // Events in a row the filter can reject before the track starts over, e.g.
+  // after the emitter changes its scan rate
+  const std::size_t MAX_REJECTS = 3;
+
+  // How quickly the event extent follows the events that weren't cut short
+  const double HALF_WIDTH_LEARNING_RATE = 0.25;
+
+  // Periods looked ahead for a window that hasn't started yet before giving up
+  const std::uint64_t MAX_LOOKAHEAD_PERIODS = 1000;
+}
+
+EventTracker::EventTracker(const std::size_t windowLength, const std::size_t minIntervals, const std::size_t maxTracks, const double measurementSigmaSec, const double periodDriftSec) :
+  windowLength(windowLength),
+  minIntervals(std::max<std::size_t>(minIntervals, 1)),
+  maxTracks(std::max<std::size_t>(maxTracks, 1)),
+  measurementSigmaSec(measurementSigmaSec),
+  periodDriftSec(periodDriftSec)
+{
+}
+
+EventTracker::Track* EventTracker::find(const std::uint32_t trackId)
+{
+  for (Track &track : tracks)
+  {
+    if (track.id == trackId)
+    {
+      return &track;
+    }
+  }
+
+  return nullptr;
+}
+
+const EventTracker::Track* EventTracker::find(const std::uint32_t trackId) const
+{
+  return const_cast<EventTracker*>(this)->find(trackId);
+}
+
+void EventTracker::addEvent(const std::uint32_t trackId, const double eventTime, const double halfWidthSec, const bool truncated)
+{
+  Track* track = find(trackId);
+
+  if (track == nullptr)
+  {
+    // Make room by dropping the least confident track
+    if (tracks.size() >= maxTracks)
+    {
+      tracks.erase(std::min_element(tracks.begin(), tracks.end(), [](const Track &a, const Track &b) { return a.confidence < b.confidence; }));
+    }
+
+    tracks.push_back({trackId, eventTime, 1, SlidingWindowQuantile(windowLength), PeriodTracker(measurementSigmaSec, periodDriftSec), 0, halfWidthSec, 0});
+    return;
+  }
+
+  // An event cut short by the dwell only says the events are at least this
+  // wide, otherwise follow the measured width both ways
+  if (truncated)
+  {
+    track->halfWidthSec = std::max(track->halfWidthSec, halfWidthSec);
+  }
+  else if (halfWidthSec > 0)
+  {
+    track->halfWidthSec += HALF_WIDTH_LEARNING_RATE*(halfWidthSec - track->halfWidthSec);
+  }
+
+  if (!track->filter.initialized())
+  {
+    const double interval = eventTime - track->lastEventTime;
+
+    if (interval <= 0)
+    {
+      return;
+    }
+
+    track->intervals.push(interval);
+
+    // Start the filter from the median so one bad interval early on can't
+    // throw it off
+    if (track->intervals.size() >= minIntervals)
+    {
+      track->filter.reset(eventTime, track->intervals.value(), measurementSigmaSec);
+      track->confidence = INITIAL_CONFIDENCE;
+    }
+  }
+  else if (track->filter.update(eventTime))
+  {
+    track->rejects = 0;
+    track->confidence += (1 - track->confidence)*HIT_GAIN;
+  }
+  else if (eventTime - track->filter.lastEventTime() < track->filter.period()/2)
+  {
+    return; // the same event seen twice
+  }
+  else if (++track->rejects >= MAX_REJECTS)
+  {
+    // The events no longer fit the period being tracked so start over from
+    // this event
+    track->intervals.clear();
+    track->filter = PeriodTracker(measurementSigmaSec, periodDriftSec);
+    track->rejects = 0;
+    track->confidence = 0;
+  }
+
+  track->lastEventTime = eventTime;
+  track->eventCount++;
+}
+
+void EventTracker::missed(const std::uint32_t trackId)
+{
+  Track* track = find(trackId);
+
+  if (track == nullptr)
+  {
+    return;
+  }
+
+  track->confidence *= MISS_FACTOR;
+
+  if (track->filter.initialized() && track->confidence < MIN_CONFIDENCE)
+  {
+    tracks.erase(tracks.begin() + (track - tracks.data()));
+  }
+}
+
+void EventTracker::predict(const double after, const double minHalfWidthSec, const double numSigma, std::vector<EventPrediction> &predictions) const
+{
+  for (const Track &track : tracks)
+  {
+    if (!track.filter.initialized() || track.filter.period() <= 0)
+    {
+      continue;
+    }
+
+    const double lastEventTime = track.filter.lastEventTime();
+    const double extent = std::max(minHalfWidthSec, track.halfWidthSec);
+
+    // First whole number of periods on from the last event whose window
+    // hasn't started yet. The window widens the further out it is, so step
+    // on from the first event after 'after' until one fits.
+    const std::uint64_t firstPeriod = std::max(1.0, std::ceil((after - lastEventTime)/track.filter.period()));
+
+    for (std::uint64_t numPeriods = firstPeriod; numPeriods < firstPeriod + MAX_LOOKAHEAD_PERIODS; numPeriods++)
+    {
+      double sigma;
+      const double time = track.filter.predict(numPeriods, sigma);
+      const double halfWidthSec = extent + numSigma*sigma;
+
+      if (time - halfWidthSec >= after)
+      {
+        predictions.push_back({track.id, time, halfWidthSec, sigma, track.confidence});
+        break;
+      }
+    }
+  }
+}
+
+double EventTracker::period(const std::uint32_t trackId) const
+{
+  const Track* track = find(trackId);
+
+  return (track != nullptr && track->filter.initialized()) ? track->filter.period() : 0;
+}
+
+double EventTracker::periodSigma(const std::uint32_t trackId) const
+{
+  const Track* track = find(trackId);
+
+  return (track != nullptr && track->filter.initialized()) ? track->filter.periodSigma() : 0;
+}
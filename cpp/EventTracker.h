@@ -0,0 +1,78 @@
+#ifndef EventTracker_H
+#define EventTracker_H
+
+#include "PeriodTracker.h"
+#include "SlidingWindowQuantile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct EventPrediction
+{
+  std::uint32_t trackId;
+  double time;         // UTC time the next event is expected
+  double halfWidthSec; // a dwell should cover time +/- halfWidthSec
+  double sigmaSec;     // 1 sigma uncertainty of time
+  float confidence;    // 0 to 1
+};
+
+// Keeps an independent periodic event track per emitter. Each track starts
+// from the median of its first event intervals and from then on follows the
+// event times with a PeriodTracker, whose prediction uncertainty together
+// with how long the events themselves last sets how wide a window its next
+// event needs. A track also has a confidence that rises when a predicted
+// event shows up and falls when a dwell over the predicted time comes back
+// empty. Tracks whose confidence drops away are forgotten, as is the least
+// confident track when a new one needs room, and a track whose events keep
+// landing outside the filter's gate is started again from scratch.
+class EventTracker
+{
+public:
+  EventTracker(const std::size_t windowLength = 64, const std::size_t minIntervals = 5, const std::size_t maxTracks = 32, const double measurementSigmaSec = 1e-3, const double periodDriftSec = 1e-4);
+
+  // halfWidthSec is how far the event extended either side of eventTime. If
+  // the dwell cut the event short it's only a lower bound, so say so with
+  // truncated.
+  void addEvent(const std::uint32_t trackId, const double eventTime, const double halfWidthSec = 0, const bool truncated = false);
+
+  // A dwell covered the predicted event of this track but no event was seen
+  void missed(const std::uint32_t trackId);
+
+  // Append the next event after 'after' of every track whose period is known.
+  // Its window is the extent of the track's events, at least minHalfWidthSec,
+  // plus numSigma of the prediction uncertainty.
+  void predict(const double after, const double minHalfWidthSec, const double numSigma, std::vector<EventPrediction> &predictions) const;
+
+  // Period of a track and its 1 sigma uncertainty, 0 if it isn't known yet
+  double period(const std::uint32_t trackId) const;
+  double periodSigma(const std::uint32_t trackId) const;
+
+  void clear() { tracks.clear(); }
+  std::size_t size() const { return tracks.size(); }
+
+private:
+  struct Track
+  {
+    std::uint32_t id;
+    double lastEventTime;
+    std::uint64_t eventCount;
+    SlidingWindowQuantile intervals; // only until the filter is started
+    PeriodTracker filter;
+    std::size_t rejects;             // consecutive events the filter rejected
+    double halfWidthSec;             // how far events extend either side of their peak
+    float confidence;
+  };
+
+  Track* find(const std::uint32_t trackId);
+  const Track* find(const std::uint32_t trackId) const;
+
+  std::size_t windowLength;
+  std::size_t minIntervals; // intervals needed before a track makes predictions
+  std::size_t maxTracks;
+  double measurementSigmaSec;
+  double periodDriftSec;
+  std::vector<Track> tracks;
+};
+
+#endif
@@ -2,8 +2,9 @@
 
 #include <ctime>
 #include <cstdio>
+#include <cstring>
 
-void getFilenameStr(const std::chrono::system_clock::time_point now, char* filenameStr, const int filenameLength)
+void getFilenameStr(const std::chrono::system_clock::time_point now, char* filenameStr, const int filenameLength, const char* extension)
 {
   // Convert current time from chrono to time_t which goes down to second precision
   const std::time_t tt = std::chrono::system_clock::to_time_t(now);
@@ -19,5 +20,32 @@ void getFilenameStr(const std::chrono::system_clock::time_point now, char* filen
   std::uint8_t second = utc_tm.tm_sec;
   std::uint16_t millisecond = (now-nowSec)/std::chrono::milliseconds(1);
 
-  snprintf(filenameStr, filenameLength, "%04d_%02d_%02d_%02d_%02d_%02d_%03d.iq", year, month, day, hour, minute, second, millisecond);
+  snprintf(filenameStr, filenameLength, "%04d_%02d_%02d_%02d_%02d_%02d_%03d.%s", year, month, day, hour, minute, second, millisecond, extension);
+}
+
+int countPositionalArgs(const int argc, const char* const argv[])
+{
+  int count = 0;
+
+  while (count < argc && strncmp(argv[count], "--", 2) != 0)
+  {
+    count++;
+  }
+
+  return count;
+}
+
+const char* findOption(const int argc, const char* const argv[], const char* name)
+{
+  const std::size_t nameLength = strlen(name);
+
+  for (int ii = countPositionalArgs(argc, argv); ii < argc; ii++)
+  {
+    if (strncmp(argv[ii], "--", 2) == 0 && strncmp(&argv[ii][2], name, nameLength) == 0 && argv[ii][2 + nameLength] == '=')
+    {
+      return &argv[ii][3 + nameLength];
+    }
+  }
+
+  return nullptr;
 }
@@ -1,4 +1,3 @@
-
 #ifndef Helper_H
 #define Helper_H
 
@@ -6,6 +5,13 @@
 
 #define FILENAME_LENGTH 80
 
-void getFilenameStr(const std::chrono::system_clock::time_point now, char* filenameStr, const int filenameLength);
+void getFilenameStr(const std::chrono::system_clock::time_point now, char* filenameStr, const int filenameLength, const char* extension = "iq");
+
+// Number of arguments, including the program name, before the first of any
+// trailing --name=value options
+int countPositionalArgs(const int argc, const char* const argv[]);
+
+// Value of the trailing --name=value option, nullptr if it wasn't given
+const char* findOption(const int argc, const char* const argv[], const char* name);
 
 #endif
@@ -0,0 +1,331 @@
+#include "IntrapulseAnalyzer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // Run lengths (in chips) between the phase transitions of each Barker code
+  struct BarkerRuns
+  {
+    std::uint16_t length;
+    std::vector<std::size_t> runs;
+  };
+
+  const std::vector<BarkerRuns> BARKER_CODES =
+  {
+    {2, {1, 1}},
+    {3, {2, 1}},
+    {4, {2, 1, 1}},
+    {4, {3, 1}},
+    {5, {3, 1, 1}},
+    {7, {3, 2, 1, 1}},
+    {11, {3, 3, 1, 2, 1, 1}},
+    {13, {5, 2, 2, 1, 1, 1, 1}}
+  };
+
+  // Sum of re[begin..end) and im[begin..end) accumulated in float lanes a
+  // chunk at a time so the inner loop vectorizes without losing precision
+  // over long pulses
+  std::complex<double> sumSteps(const float* re, const float* im, const std::size_t begin, const std::size_t end)
+  {
+    const std::size_t CHUNK_SIZE = 256;
+    const std::size_t LANES = 8;
+
+    double sumRe = 0;
+    double sumIm = 0;
+
+    for (std::size_t chunk = begin; chunk < end; chunk += CHUNK_SIZE)
+    {
+      const std::size_t chunkEnd = std::min(chunk + CHUNK_SIZE, end);
+
+      float reLane[LANES] = {};
+      float imLane[LANES] = {};
+
+      std::size_t ii = chunk;
+
+      for (; ii + LANES <= chunkEnd; ii += LANES)
+      {
+        for (std::size_t kk = 0; kk < LANES; kk++)
+        {
+          reLane[kk] += re[ii+kk];
+          imLane[kk] += im[ii+kk];
+        }
+      }
+
+      for (; ii < chunkEnd; ii++)
+      {
+        reLane[0] += re[ii];
+        imLane[0] += im[ii];
+      }
+
+      for (std::size_t kk = 0; kk < LANES; kk++)
+      {
+        sumRe += reLane[kk];
+        sumIm += imLane[kk];
+      }
+    }
+
+    return {sumRe, sumIm};
+  }
+}
+
+IntrapulseAnalyzer::IntrapulseAnalyzer(const double sampleRateSps, const FrequencyEstimate frequencyEstimate) :
+  sampleRateSps(sampleRateSps),
+  frequencyEstimate(frequencyEstimate)
+{
+}
+
+IntrapulseFeatures IntrapulseAnalyzer::analyze(const std::complex<float>* iq, const std::size_t numSamples)
+{
+  IntrapulseFeatures features;
+  features.freqOffsetHz = 0;
+  features.chirpRateHzPerSec = 0;
+  features.modulation = PulseModulation::Unmodulated;
+  features.numChips = 0;
+
+  if (numSamples < 2)
+  {
+    return features;
+  }
+
+  // Phase step of every sample, step[k] = x[k+1]*conj(x[k])
+  const std::size_t numSteps = numSamples - 1;
+  const float* samples = reinterpret_cast<const float*>(iq);
+
+  stepRe.resize(numSteps);
+  stepIm.resize(numSteps);
+
+  for (std::size_t ii = 0; ii < numSteps; ii++)
+  {
+    const float re = samples[2*ii+2];
+    const float im = samples[2*ii+3];
+    const float prevRe = samples[2*ii];
+    const float prevIm = samples[2*ii+1];
+
+    stepRe[ii] = re*prevRe + im*prevIm;
+    stepIm[ii] = im*prevRe - re*prevIm;
+  }
+
+  // Sum the steps over each segment. Segment angles are taken relative to the
+  // mean step so they don't wrap for a carrier near +/- fs/2.
+  const std::size_t numSegments = std::clamp<std::size_t>(numSteps/MIN_SEGMENT_SAMPLES, 1, MAX_SEGMENTS);
+
+  std::complex<double> segmentSum[MAX_SEGMENTS];
+  double segmentCenter[MAX_SEGMENTS];
+  double segmentAngle[MAX_SEGMENTS];
+  double segmentWeight[MAX_SEGMENTS];
+  std::complex<double> totalSum = 0;
+
+  for (std::size_t ss = 0; ss < numSegments; ss++)
+  {
+    const std::size_t begin = ss*numSteps/numSegments;
+    const std::size_t end = (ss+1)*numSteps/numSegments;
+
+    segmentSum[ss] = sumSteps(stepRe.data(), stepIm.data(), begin, end);
+    segmentCenter[ss] = 0.5*(begin + end - 1);
+    totalSum += segmentSum[ss];
+  }
+
+  const double meanAngle = std::arg(totalSum);
+  const std::complex<double> meanDirection = std::conj(std::polar(1.0, meanAngle));
+
+  for (std::size_t ss = 0; ss < numSegments; ss++)
+  {
+    segmentAngle[ss] = meanAngle + std::arg(segmentSum[ss]*meanDirection);
+    segmentWeight[ss] = std::abs(segmentSum[ss]);
+  }
+
+  double stepAngle = meanAngle;
+
+  if (frequencyEstimate == FrequencyEstimate::SegmentMedian)
+  {
+    double sortedAngle[MAX_SEGMENTS];
+    std::copy(segmentAngle, segmentAngle + numSegments, sortedAngle);
+    std::nth_element(sortedAngle, sortedAngle + numSegments/2, sortedAngle + numSegments);
+
+    stepAngle = sortedAngle[numSegments/2];
+  }
+
+  features.freqOffsetHz = stepAngle*sampleRateSps/(2*M_PI);
+
+  // Weighted least squares line through the segment angles, the slope being
+  // the change in phase step per sample
+  if (numSegments >= 3)
+  {
+    double sumW = 0;
+    double sumT = 0;
+    double sumA = 0;
+
+    for (std::size_t ss = 0; ss < numSegments; ss++)
+    {
+      sumW += segmentWeight[ss];
+      sumT += segmentWeight[ss]*segmentCenter[ss];
+      sumA += segmentWeight[ss]*segmentAngle[ss];
+    }
+
+    if (sumW > 0)
+    {
+      const double meanT = sumT/sumW;
+      const double meanA = sumA/sumW;
+
+      double sumTT = 0;
+      double sumTA = 0;
+
+      for (std::size_t ss = 0; ss < numSegments; ss++)
+      {
+        sumTT += segmentWeight[ss]*(segmentCenter[ss] - meanT)*(segmentCenter[ss] - meanT);
+        sumTA += segmentWeight[ss]*(segmentCenter[ss] - meanT)*(segmentAngle[ss] - meanA);
+      }
+
+      const double slope = sumTA/sumTT;
+
+      double sumResidual = 0;
+
+      for (std::size_t ss = 0; ss < numSegments; ss++)
+      {
+        const double residual = segmentAngle[ss] - meanA - slope*(segmentCenter[ss] - meanT);
+        sumResidual += segmentWeight[ss]*residual*residual;
+      }
+
+      const double slopeError = std::sqrt(sumResidual/(numSegments - 2)/sumTT);
+
+      features.chirpRateHzPerSec = slope*sampleRateSps*sampleRateSps/(2*M_PI);
+
+      // Call it a chirp if the slope is well clear of the fit error and the
+      // frequency sweeps more than a couple of resolution cells (1/PW)
+      const double extentHz = std::abs(features.chirpRateHzPerSec)*numSamples/sampleRateSps;
+
+      if (std::abs(slope) > 4*slopeError && extentHz > 2*sampleRateSps/numSamples)
+      {
+        features.modulation = PulseModulation::Lfm;
+
+        // The carrier of a chirp is the frequency at the middle of the pulse
+        features.freqOffsetHz = (meanA + slope*(0.5*(numSteps - 1) - meanT))*sampleRateSps/(2*M_PI);
+      }
+    }
+  }
+
+  // A phase jump is where consecutive pairs of steps both turn more than 90
+  // degrees off the direction of their segment, which follows the carrier
+  // along a chirp as well. Pairing the steps catches a transition a filter
+  // has smeared over two samples with no more noise than a single step.
+  jumps.clear();
+
+  bool previousFlagged = false;
+
+  for (std::size_t ss = 0; ss < numSegments; ss++)
+  {
+    const std::size_t begin = std::max<std::size_t>(ss*numSteps/numSegments, 1);
+    const std::size_t end = (ss+1)*numSteps/numSegments;
+    const std::complex<float> direction(segmentSum[ss]*segmentSum[ss]/std::max(segmentWeight[ss], 1e-30));
+
+    for (std::size_t chunk = begin; chunk < end; chunk += CHUNK_SIZE)
+    {
+      const std::size_t chunkLength = std::min(CHUNK_SIZE, end - chunk);
+
+      // Only look sample by sample at the chunks where some pair turned
+      alignas(64) float turn[CHUNK_SIZE];
+      float minTurn = 0;
+
+      for (std::size_t kk = 0; kk < chunkLength; kk++)
+      {
+        const std::size_t ii = chunk + kk;
+        const float pairRe = stepRe[ii]*stepRe[ii-1] - stepIm[ii]*stepIm[ii-1];
+        const float pairIm = stepRe[ii]*stepIm[ii-1] + stepIm[ii]*stepRe[ii-1];
+
+        turn[kk] = pairRe*direction.real() + pairIm*direction.imag();
+        minTurn = std::min(minTurn, turn[kk]);
+      }
+
+      if (minTurn >= 0)
+      {
+        previousFlagged = false;
+        continue;
+      }
+
+      for (std::size_t kk = 0; kk < chunkLength; kk++)
+      {
+        const bool flagged = (turn[kk] < 0);
+
+        // A transition turns the two pairs either side of it, a noise spike
+        // on one sample turns the pairs one sample apart
+        if (flagged && previousFlagged)
+        {
+          jumps.push_back(chunk + kk); // first sample of the new chip
+        }
+
+        previousFlagged = flagged;
+      }
+    }
+  }
+
+  findChips(numSamples, features);
+
+  return features;
+}
+
+void IntrapulseAnalyzer::findChips(const std::size_t numSamples, IntrapulseFeatures &features)
+{
+  if (jumps.empty())
+  {
+    return;
+  }
+
+  // Run lengths between the jumps, dropping jumps too close to the last one
+  // which are the same transition flagged twice
+  runs.clear();
+
+  std::size_t chipStart = 0;
+
+  for (const std::size_t jump : jumps)
+  {
+    if (jump - chipStart >= MIN_CHIP_SAMPLES)
+    {
+      runs.push_back(jump - chipStart);
+      chipStart = jump;
+    }
+  }
+
+  if (runs.empty() || numSamples - chipStart < MIN_CHIP_SAMPLES)
+  {
+    return;
+  }
+
+  runs.push_back(numSamples - chipStart);
+
+  const std::size_t shortestRun = *std::min_element(runs.begin(), runs.end());
+  const std::size_t numChips = std::lround(double(numSamples)/shortestRun);
+
+  if (numChips > 255)
+  {
+    return;
+  }
+
+  // Every run has to be a whole number of chips
+  const double chipSamples = double(numSamples)/numChips;
+  const double tolerance = std::max(2.0, 0.25*chipSamples);
+
+  for (std::size_t &run : runs)
+  {
+    const std::size_t chips = std::lround(run/chipSamples);
+
+    if (chips == 0 || std::abs(run - chips*chipSamples) > tolerance)
+    {
+      return;
+    }
+
+    run = chips;
+  }
+
+  features.modulation = PulseModulation::PhaseCoded;
+  features.numChips = numChips;
+
+  for (const BarkerRuns &code : BARKER_CODES)
+  {
+    if (code.length == numChips && (std::equal(runs.begin(), runs.end(), code.runs.begin(), code.runs.end()) || std::equal(runs.rbegin(), runs.rend(), code.runs.begin(), code.runs.end())))
+    {
+      features.modulation = PulseModulation::Barker;
+    }
+  }
+}
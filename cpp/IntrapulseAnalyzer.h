@@ -0,0 +1,63 @@
+#ifndef IntrapulseAnalyzer_H
+#define IntrapulseAnalyzer_H
+
+#include "Pdw.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <vector>
+
+struct IntrapulseFeatures
+{
+  double freqOffsetHz;      // carrier frequency relative to the center of the data (Hz)
+  double chirpRateHzPerSec; // LFM slope (Hz/sec)
+  PulseModulation modulation;
+  std::uint16_t numChips;   // number of phase code chips, 0 if not phase coded
+};
+
+// Measures the modulation on a pulse from the conjugate products
+// d[n] = x[n]*conj(x[n-1]), whose angle is the phase step from one sample to
+// the next, without taking the angle of every sample. The pulse is split in to
+// a handful of segments and only the sum of d over each segment has its angle
+// taken:
+//
+//   - the carrier frequency is the angle of the sum over the whole pulse or
+//     the median of the segment angles, which isn't pulled off by phase code
+//     transitions or the ends of the pulse
+//   - the LFM slope is a least squares line through the segment frequencies
+//   - a phase code shows up as samples whose d points more than 90 degrees
+//     away from the sum of its segment, and the run lengths between those
+//     jumps give the chip width and whether the code is a Barker code
+class IntrapulseAnalyzer
+{
+public:
+  enum class FrequencyEstimate
+  {
+    Mean,
+    SegmentMedian
+  };
+
+  IntrapulseAnalyzer(const double sampleRateSps, const FrequencyEstimate frequencyEstimate = FrequencyEstimate::SegmentMedian);
+
+  IntrapulseFeatures analyze(const std::complex<float>* iq, const std::size_t numSamples);
+
+private:
+  static constexpr std::size_t MAX_SEGMENTS = 16;
+  static constexpr std::size_t MIN_SEGMENT_SAMPLES = 16;
+  static constexpr std::size_t MIN_CHIP_SAMPLES = 4;
+  static constexpr std::size_t CHUNK_SIZE = 64;
+
+  void findChips(const std::size_t numSamples, IntrapulseFeatures &features);
+
+  double sampleRateSps;
+  FrequencyEstimate frequencyEstimate;
+
+  // Real and imaginary parts of d kept apart so the loops over them vectorize
+  std::vector<float> stepRe;
+  std::vector<float> stepIm;
+  std::vector<std::size_t> jumps;
+  std::vector<std::size_t> runs;
+};
+
+#endif
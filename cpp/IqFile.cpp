@@ -0,0 +1,99 @@
+#include "IqFile.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+  template <typename T>
+  void convertSamples(const char* raw, const std::size_t numSamples, const float scale, std::complex<float>* iq)
+  {
+    const std::complex<T>* samples = reinterpret_cast<const std::complex<T>*>(raw);
+
+    for (std::size_t ii = 0; ii < numSamples; ii++)
+    {
+      iq[ii] = std::complex<float>(samples[ii].real()*scale, samples[ii].imag()*scale);
+    }
+  }
+}
+
+bool readIqHeader(const std::string &filename, IqPacket &packet)
+{
+  std::ifstream fin(filename, std::ifstream::binary);
+
+  if (!fin.read((char*)&packet, sizeof(packet)))
+  {
+    return false;
+  }
+
+  // Every byte of the endianness word is the same, so a big endian marker is
+  // all zeros no matter which way round it's read
+  const bool bigEndian = (packet.endianness == 0x00000000);
+  const bool knownEndian = (packet.endianness != 0xFFFFFFFF);
+
+  return knownEndian && bigEndian == (std::endian::native == std::endian::big) && packet.bitWidth > 0 && packet.bitWidth <= 16;
+}
+
+bool readIqFile(const std::string &filename, IqPacket &packet, std::vector<std::complex<float>> &iq)
+{
+  IqFileReader reader;
+
+  if (!reader.open(filename, packet))
+  {
+    return false;
+  }
+
+  iq.resize(packet.numSamples);
+  iq.resize(reader.read(iq.data(), iq.size()));
+
+  return !iq.empty();
+}
+
+IqFileReader::IqFileReader() : bitWidth(0), scale(0), samplesLeft(0)
+{
+}
+
+bool IqFileReader::open(const std::string &filename, IqPacket &packet)
+{
+  fin.close();
+  samplesLeft = 0;
+
+  if (!readIqHeader(filename, packet))
+  {
+    return false;
+  }
+
+  fin.open(filename, std::ifstream::binary);
+  fin.seekg(sizeof(packet));
+
+  bitWidth = packet.bitWidth;
+  scale = 1.0f/(1 << (bitWidth - 1)); // Normalize from -1 to 1
+  samplesLeft = packet.numSamples;
+
+  return fin.good();
+}
+
+std::size_t IqFileReader::read(std::complex<float>* iq, const std::size_t maxSamples)
+{
+  const std::size_t sampleBytes = (bitWidth <= 8) ? sizeof(std::complex<std::int8_t>) : sizeof(std::complex<std::int16_t>);
+  const std::size_t numSamples = std::min<std::uint64_t>(maxSamples, samplesLeft);
+
+  raw.resize(numSamples*sampleBytes);
+  fin.read(raw.data(), raw.size());
+
+  const std::size_t numRead = fin.gcount()/sampleBytes;
+
+  if (bitWidth <= 8)
+  {
+    convertSamples<std::int8_t>(raw.data(), numRead, scale, iq);
+  }
+  else
+  {
+    convertSamples<std::int16_t>(raw.data(), numRead, scale, iq);
+  }
+
+  // A short read means the recording was cut off
+  samplesLeft = (numRead == numSamples) ? samplesLeft - numRead : 0;
+
+  return numRead;
+}
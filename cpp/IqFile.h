@@ -0,0 +1,41 @@
+#ifndef IqFile_H
+#define IqFile_H
+
+#include "IqPacket.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Read the IqPacket header at the top of a recording, returns false if the
+// file can't be read or was recorded on a machine of the other endianness
+bool readIqHeader(const std::string &filename, IqPacket &packet);
+
+// Read a whole recording and convert it to complex floats normalized to +/-1,
+// the same scaling the MATLAB tools use (i.e. divided by 2^(bitWidth-1))
+bool readIqFile(const std::string &filename, IqPacket &packet, std::vector<std::complex<float>> &iq);
+
+// Reads a recording a block at a time with the same conversion as
+// readIqFile, so a recording needn't fit in memory
+class IqFileReader
+{
+public:
+  IqFileReader();
+
+  bool open(const std::string &filename, IqPacket &packet);
+
+  // Read up to maxSamples of the samples left, returns how many were read, 0 at the end
+  std::size_t read(std::complex<float>* iq, const std::size_t maxSamples);
+
+private:
+  std::ifstream fin;
+  std::uint32_t bitWidth;
+  float scale;
+  std::uint64_t samplesLeft;
+  std::vector<char> raw;
+};
+
+#endif
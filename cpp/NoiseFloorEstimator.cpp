@@ -0,0 +1,93 @@
+#include "NoiseFloorEstimator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+NoiseFloorEstimator::NoiseFloorEstimator()
+{
+  clear();
+}
+
+void NoiseFloorEstimator::update(const std::complex<float>* iq, const std::size_t numSamples, const std::size_t stride)
+{
+  std::memset(blockCounts, 0, sizeof(blockCounts));
+
+  const std::size_t step = std::max<std::size_t>(stride, 1);
+  std::size_t used = 0;
+
+  for (std::size_t ii = 0; ii < numSamples; ii += step, used++)
+  {
+    // Power is never negative so the sign bit is always clear and the top
+    // bits of the float map monotonically onto the histogram bins
+    const float p = std::norm(iq[ii]);
+    blockCounts[std::bit_cast<std::uint32_t>(p) >> BIN_SHIFT]++;
+
+    // Flush before the 32-bit counters could possibly wrap
+    if ((used & 0x7FFFFFFF) == 0x7FFFFFFF)
+    {
+      for (std::size_t bin = 0; bin < NUM_BINS; bin++)
+      {
+        histogram[bin] += blockCounts[bin];
+        blockCounts[bin] = 0;
+      }
+    }
+  }
+
+  for (std::size_t bin = 0; bin < NUM_BINS; bin++)
+  {
+    histogram[bin] += blockCounts[bin];
+  }
+
+  total += used;
+}
+
+void NoiseFloorEstimator::decay(const double factor)
+{
+  for (double &h : histogram)
+  {
+    h *= factor;
+  }
+
+  total *= factor;
+}
+
+void NoiseFloorEstimator::clear()
+{
+  for (double &h : histogram)
+  {
+    h = 0;
+  }
+
+  total = 0;
+}
+
+float NoiseFloorEstimator::quantile(const double q) const
+{
+  if (total <= 0)
+  {
+    return 0;
+  }
+
+  const double target = q*total;
+  double cumulative = 0;
+
+  for (std::size_t bin = 0; bin < NUM_BINS; bin++)
+  {
+    if (histogram[bin] > 0 && cumulative + histogram[bin] >= target)
+    {
+      // Interpolate within the bin, the float bit pattern is close to linear in log(power)
+      const double frac = std::clamp((target - cumulative)/histogram[bin], 0.0, 1.0);
+      const std::uint32_t bits = (std::uint32_t(bin) << BIN_SHIFT) + std::uint32_t(frac*((1u << BIN_SHIFT) - 1));
+      const float p = std::bit_cast<float>(bits);
+
+      return std::isfinite(p) ? std::sqrt(p) : std::numeric_limits<float>::max();
+    }
+
+    cumulative += histogram[bin];
+  }
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef NoiseFloorEstimator_H
+#define NoiseFloorEstimator_H
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+
+// Streaming quantile estimate of the magnitude of I/Q samples. Every sample's
+// power is dropped into a fixed log spaced histogram that's indexed straight
+// from the bits of the float (exponent plus the top mantissa bits), so one
+// pass costs no log, no sqrt and no sort, and the memory is fixed no matter
+// how many samples have been seen. Use one estimator per channelizer bin and
+// call decay() between dwells to let the estimate follow a changing floor.
+class NoiseFloorEstimator
+{
+public:
+  NoiseFloorEstimator();
+
+  // Add every stride'th sample of the block to the histogram, e.g. stride = M
+  // to follow one bin of M interleaved channelizer outputs. A stride of 0 is
+  // taken as 1.
+  void update(const std::complex<float>* iq, const std::size_t numSamples, const std::size_t stride = 1);
+
+  // Scale down the weight of everything seen so far, 0 forgets it all
+  void decay(const double factor);
+  void clear();
+
+  double count() const { return total; }
+
+  // Approximate magnitude at quantile q (0 to 1), 0 if nothing has been seen
+  float quantile(const double q) const;
+  float median() const { return quantile(0.5); }
+
+private:
+  static constexpr std::uint32_t MANTISSA_BITS = 3; // 8 bins per octave of power, ~0.19 dB of magnitude
+  static constexpr std::uint32_t BIN_SHIFT = 23 - MANTISSA_BITS;
+  static constexpr std::size_t NUM_BINS = std::size_t(1) << (8 + MANTISSA_BITS);
+
+  double histogram[NUM_BINS];
+  std::uint32_t blockCounts[NUM_BINS];
+  double total;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef Pdw_H
+#define Pdw_H
+
+#include <cstdint>
+
+enum class PulseModulation : std::uint8_t
+{
+  Unmodulated = 0,
+  Lfm = 1,        // linear frequency modulated chirp
+  Barker = 2,     // binary phase code whose chip run lengths match a Barker code
+  PhaseCoded = 3  // phase jumps at a regular chip spacing that isn't a Barker code
+};
+
+// Pulse descriptor word, the C++ counterpart of the pdw struct the MATLAB tools build
+struct Pdw
+{
+  double toa;         // time of arrival of the leading edge from the recording's epoch (sec)
+  double freqHz;      // carrier frequency estimated from the phase steps over the pulse (Hz)
+  double pwSec;       // pulse width (sec)
+  float snrDb;        // amplitude relative to the noise floor (dB)
+  float amp;          // RMS magnitude over the pulse
+  bool saturated;     // whether I or Q ever hit the saturation limit during the pulse
+  std::uint16_t bin;  // channelizer bin the pulse was found in, 0 for wideband data
+  float chirpRateHzPerSec;    // LFM slope, 0 unless intrapulse analysis was run
+  PulseModulation modulation; // Unmodulated unless intrapulse analysis was run
+  std::uint8_t numChips;      // number of phase code chips, 0 if not phase coded
+};
+
+#endif
@@ -0,0 +1,444 @@
+#include "PdwFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  // Bytes of every column of a single PDW
+  std::size_t pdwColumnBytes(const std::uint32_t version)
+  {
+    if (version == 1)
+    {
+      return 2*sizeof(double) + 3*sizeof(float) + sizeof(std::uint16_t) + sizeof(std::uint8_t);
+    }
+
+    return 2*sizeof(double) + 4*sizeof(float) + sizeof(std::uint16_t) + 3*sizeof(std::uint8_t);
+  }
+
+  // Bytes of column data for a block of n PDWs, padded so the next block header stays 8-byte aligned
+  std::size_t columnBytes(const std::size_t n, const std::uint32_t version = PDW_FILE_FORMAT)
+  {
+    return (n*pdwColumnBytes(version) + 7) & ~std::size_t(7);
+  }
+}
+
+PdwFileWriter::PdwFileWriter() : failed(false), blockCapacity(0), numPdws(0)
+{
+}
+
+PdwFileWriter::~PdwFileWriter()
+{
+  close();
+}
+
+bool PdwFileWriter::open(const std::string &filename, const std::uint32_t epochSec, const std::uint32_t blockCapacity)
+{
+  close();
+
+  fout.open(filename, std::ofstream::binary | std::ofstream::trunc);
+
+  if (!fout.is_open())
+  {
+    return false;
+  }
+
+  failed = false;
+  this->blockCapacity = std::clamp<std::uint32_t>(blockCapacity, 1, PDW_MAX_BLOCK_CAPACITY);
+  numPdws = 0;
+  index.clear();
+
+  toa.reserve(this->blockCapacity);
+  freqHz.reserve(this->blockCapacity);
+  pwSec.reserve(this->blockCapacity);
+  snrDb.reserve(this->blockCapacity);
+  amp.reserve(this->blockCapacity);
+  chirpRateHzPerSec.reserve(this->blockCapacity);
+  bin.reserve(this->blockCapacity);
+  saturated.reserve(this->blockCapacity);
+  modulation.reserve(this->blockCapacity);
+  numChips.reserve(this->blockCapacity);
+
+  PdwFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = PDW_FILE_MAGIC;
+  header.version = PDW_FILE_FORMAT;
+  header.blockCapacity = this->blockCapacity;
+  header.epochSec = epochSec;
+
+  fout.write((const char*)&header, sizeof(header));
+  failed = !fout.good();
+
+  return !failed;
+}
+
+bool PdwFileWriter::write(const Pdw &pdw)
+{
+  if (failed)
+  {
+    return false;
+  }
+
+  toa.push_back(pdw.toa);
+  freqHz.push_back(pdw.freqHz);
+  pwSec.push_back(pdw.pwSec);
+  snrDb.push_back(pdw.snrDb);
+  amp.push_back(pdw.amp);
+  chirpRateHzPerSec.push_back(pdw.chirpRateHzPerSec);
+  bin.push_back(pdw.bin);
+  saturated.push_back(pdw.saturated);
+  modulation.push_back(static_cast<std::uint8_t>(pdw.modulation));
+  numChips.push_back(pdw.numChips);
+
+  numPdws++;
+
+  if (toa.size() >= blockCapacity)
+  {
+    return flushBlock();
+  }
+
+  return true;
+}
+
+bool PdwFileWriter::write(const std::vector<Pdw> &pdws)
+{
+  for (const Pdw &pdw : pdws)
+  {
+    if (!write(pdw))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool PdwFileWriter::flushBlock()
+{
+  const std::size_t n = toa.size();
+
+  if (n == 0 || !fout.is_open() || failed)
+  {
+    return !failed;
+  }
+
+  PdwBlockIndex entry;
+  std::memset(&entry, 0, sizeof(entry));
+  entry.offset = fout.tellp();
+  entry.header.numPdws = n;
+  entry.header.blockBytes = sizeof(PdwBlockHeader) + columnBytes(n);
+
+  const auto toaRange = std::minmax_element(toa.begin(), toa.end());
+  const auto freqRange = std::minmax_element(freqHz.begin(), freqHz.end());
+  entry.header.minToa = *toaRange.first;
+  entry.header.maxToa = *toaRange.second;
+  entry.header.minFreqHz = *freqRange.first;
+  entry.header.maxFreqHz = *freqRange.second;
+
+  fout.write((const char*)&entry.header, sizeof(entry.header));
+  fout.write((const char*)toa.data(), n*sizeof(double));
+  fout.write((const char*)freqHz.data(), n*sizeof(double));
+  fout.write((const char*)pwSec.data(), n*sizeof(float));
+  fout.write((const char*)snrDb.data(), n*sizeof(float));
+  fout.write((const char*)amp.data(), n*sizeof(float));
+  fout.write((const char*)chirpRateHzPerSec.data(), n*sizeof(float));
+  fout.write((const char*)bin.data(), n*sizeof(std::uint16_t));
+  fout.write((const char*)saturated.data(), n*sizeof(std::uint8_t));
+  fout.write((const char*)modulation.data(), n*sizeof(std::uint8_t));
+  fout.write((const char*)numChips.data(), n*sizeof(std::uint8_t));
+
+  const char padding[8] = {0};
+  fout.write(padding, columnBytes(n) - n*pdwColumnBytes(PDW_FILE_FORMAT));
+
+  // Only blocks that made it out go in the index
+  if (fout.good())
+  {
+    index.push_back(entry);
+  }
+  else
+  {
+    failed = true;
+  }
+
+  toa.clear();
+  freqHz.clear();
+  pwSec.clear();
+  snrDb.clear();
+  amp.clear();
+  chirpRateHzPerSec.clear();
+  bin.clear();
+  saturated.clear();
+  modulation.clear();
+  numChips.clear();
+
+  return !failed;
+}
+
+bool PdwFileWriter::close()
+{
+  if (!fout.is_open())
+  {
+    return true;
+  }
+
+  // Without the index a reader rebuilds it from the blocks that were written
+  if (!flushBlock())
+  {
+    fout.close();
+    index.clear();
+    return false;
+  }
+
+  PdwFileTrailer trailer;
+  std::memset(&trailer, 0, sizeof(trailer));
+  trailer.indexOffset = fout.tellp();
+  trailer.numBlocks = index.size();
+  trailer.numPdws = numPdws;
+  trailer.magic = PDW_INDEX_MAGIC;
+
+  fout.write((const char*)index.data(), index.size()*sizeof(PdwBlockIndex));
+  fout.write((const char*)&trailer, sizeof(trailer));
+  fout.close();
+
+  // Closing flushes what's still buffered, so it can fail too
+  failed = fout.fail();
+  index.clear();
+
+  return !failed;
+}
+
+Pdw PdwBlockView::at(const std::size_t ii) const
+{
+  Pdw pdw;
+
+  pdw.toa = toa[ii];
+  pdw.freqHz = freqHz[ii];
+  pdw.pwSec = pwSec[ii];
+  pdw.snrDb = snrDb[ii];
+  pdw.amp = amp[ii];
+  pdw.bin = bin[ii];
+  pdw.saturated = saturated[ii] != 0;
+  pdw.chirpRateHzPerSec = (chirpRateHzPerSec != nullptr) ? chirpRateHzPerSec[ii] : 0;
+  pdw.modulation = (modulation != nullptr) ? static_cast<PulseModulation>(modulation[ii]) : PulseModulation::Unmodulated;
+  pdw.numChips = (numChips != nullptr) ? numChips[ii] : 0;
+
+  return pdw;
+}
+
+PdwFileReader::PdwFileReader() : data(nullptr), dataSize(0), version(0), epoch(0), isTruncated(false), numPdws(0)
+{
+}
+
+PdwFileReader::~PdwFileReader()
+{
+  close();
+}
+
+bool PdwFileReader::open(const std::string &filename)
+{
+  close();
+
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(PdwFileHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+
+  data = static_cast<const std::uint8_t*>(mapping);
+  dataSize = st.st_size;
+
+  const PdwFileHeader* header = reinterpret_cast<const PdwFileHeader*>(data);
+
+  if (header->magic != PDW_FILE_MAGIC || header->version < 1 || header->version > PDW_FILE_FORMAT)
+  {
+    close();
+    return false;
+  }
+
+  version = header->version;
+
+  // TOAs only became relative to epochSec in version 3
+  epoch = (version >= 3) ? header->epochSec : 0;
+
+  // Use the index at the end of the file if the writer got to write it
+  if (!readIndex())
+  {
+    isTruncated = !rebuildIndex();
+  }
+
+  return true;
+}
+
+// False if there's no index at the end of the file, or it has blocks that
+// don't fit between the file header and the index
+bool PdwFileReader::readIndex()
+{
+  index.clear();
+  numPdws = 0;
+
+  if (dataSize < sizeof(PdwFileHeader) + sizeof(PdwFileTrailer))
+  {
+    return false;
+  }
+
+  const PdwFileTrailer* trailer = reinterpret_cast<const PdwFileTrailer*>(data + dataSize - sizeof(PdwFileTrailer));
+  const std::uint64_t maxBlocks = (dataSize - sizeof(PdwFileHeader) - sizeof(PdwFileTrailer))/sizeof(PdwBlockIndex);
+
+  if (trailer->magic != PDW_INDEX_MAGIC || trailer->numBlocks > maxBlocks || trailer->indexOffset % alignof(PdwBlockIndex) != 0 || trailer->indexOffset + trailer->numBlocks*sizeof(PdwBlockIndex) + sizeof(PdwFileTrailer) != dataSize)
+  {
+    return false;
+  }
+
+  const PdwBlockIndex* entries = reinterpret_cast<const PdwBlockIndex*>(data + trailer->indexOffset);
+  std::uint64_t total = 0;
+
+  for (std::uint64_t ii = 0; ii < trailer->numBlocks; ii++)
+  {
+    const PdwBlockIndex &entry = entries[ii];
+    const std::size_t blockBytes = entry.header.blockBytes;
+
+    // block() maps the columns from the offset and count alone, so both
+    // have to agree with a block that lies wholly inside the file
+    if (entry.header.numPdws == 0 || entry.header.numPdws > PDW_MAX_BLOCK_CAPACITY || blockBytes != sizeof(PdwBlockHeader) + columnBytes(entry.header.numPdws, version) ||
+        entry.offset < sizeof(PdwFileHeader) || entry.offset % alignof(PdwBlockHeader) != 0 || blockBytes > trailer->indexOffset || entry.offset > trailer->indexOffset - blockBytes)
+    {
+      return false;
+    }
+
+    total += entry.header.numPdws;
+  }
+
+  if (total != trailer->numPdws)
+  {
+    return false;
+  }
+
+  index.assign(entries, entries + trailer->numBlocks);
+  numPdws = total;
+
+  return true;
+}
+
+// False if it stopped short of the end of the file
+bool PdwFileReader::rebuildIndex()
+{
+  std::size_t offset = sizeof(PdwFileHeader);
+
+  index.clear();
+  numPdws = 0;
+
+  while (offset + sizeof(PdwBlockHeader) <= dataSize)
+  {
+    const PdwBlockHeader* header = reinterpret_cast<const PdwBlockHeader*>(data + offset);
+
+    // Stop at the first block that was only partly written
+    if (header->numPdws == 0 || header->blockBytes != sizeof(PdwBlockHeader) + columnBytes(header->numPdws, version) || offset + header->blockBytes > dataSize)
+    {
+      break;
+    }
+
+    index.push_back({offset, *header});
+    numPdws += header->numPdws;
+    offset += header->blockBytes;
+  }
+
+  return offset == dataSize;
+}
+
+void PdwFileReader::close()
+{
+  if (data != nullptr)
+  {
+    munmap(const_cast<std::uint8_t*>(data), dataSize);
+  }
+
+  data = nullptr;
+  dataSize = 0;
+  version = 0;
+  epoch = 0;
+  isTruncated = false;
+  numPdws = 0;
+  index.clear();
+}
+
+PdwBlockView PdwFileReader::block(const std::size_t block) const
+{
+  const std::size_t n = index[block].header.numPdws;
+  const std::uint8_t* column = data + index[block].offset + sizeof(PdwBlockHeader);
+  PdwBlockView view;
+
+  view.numPdws = n;
+  view.toa = reinterpret_cast<const double*>(column);
+  column += n*sizeof(double);
+  view.freqHz = reinterpret_cast<const double*>(column);
+  column += n*sizeof(double);
+  view.pwSec = reinterpret_cast<const float*>(column);
+  column += n*sizeof(float);
+  view.snrDb = reinterpret_cast<const float*>(column);
+  column += n*sizeof(float);
+  view.amp = reinterpret_cast<const float*>(column);
+  column += n*sizeof(float);
+  view.chirpRateHzPerSec = nullptr;
+
+  if (version >= 2)
+  {
+    view.chirpRateHzPerSec = reinterpret_cast<const float*>(column);
+    column += n*sizeof(float);
+  }
+
+  view.bin = reinterpret_cast<const std::uint16_t*>(column);
+  column += n*sizeof(std::uint16_t);
+  view.saturated = column;
+  column += n*sizeof(std::uint8_t);
+  view.modulation = nullptr;
+  view.numChips = nullptr;
+
+  if (version >= 2)
+  {
+    view.modulation = column;
+    column += n*sizeof(std::uint8_t);
+    view.numChips = column;
+  }
+
+  return view;
+}
+
+std::size_t PdwFileReader::query(const double toaMin, const double toaMax, const double freqMinHz, const double freqMaxHz, std::vector<Pdw> &pdws) const
+{
+  const std::size_t startSize = pdws.size();
+
+  forEachBlock(toaMin, toaMax, freqMinHz, freqMaxHz, [&](const PdwBlockView &view)
+  {
+    for (std::size_t ii = 0; ii < view.numPdws; ii++)
+    {
+      if (view.toa[ii] >= toaMin && view.toa[ii] <= toaMax && view.freqHz[ii] >= freqMinHz && view.freqHz[ii] <= freqMaxHz)
+      {
+        pdws.push_back(view.at(ii));
+      }
+    }
+  });
+
+  return pdws.size() - startSize;
+}
@@ -0,0 +1,186 @@
+#ifndef PdwFile_H
+#define PdwFile_H
+
+#include "Pdw.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Columnar binary PDW store. PDWs are written in blocks, each block holding
+// every column of its PDWs back to back (TOA, frequency, PW, SNR, amplitude,
+// chirp rate, bin, saturation, modulation, chips) behind a small header with the block's TOA and frequency
+// extents. An index of the block headers goes at the end of the file so a
+// reader can skip every block that can't satisfy a time/frequency query
+// without touching its columns.
+//
+//   PdwFileHeader
+//   PdwBlockHeader, toa[n], freqHz[n], pwSec[n], snrDb[n], amp[n], chirpRateHzPerSec[n], bin[n], saturated[n], modulation[n], numChips[n], padding
+//   ...
+//   PdwBlockIndex[numBlocks]
+//   PdwFileTrailer
+//
+// If the writer never got to write the index (e.g. the recorder was killed)
+// the reader rebuilds it by walking the block headers, up to the first block
+// that was only partly written. Version 1 files have
+// no chirp rate, modulation or chips columns and read back as unmodulated.
+//
+// From version 3, TOAs are seconds from the UTC second in the header's
+// epochSec, so they keep sub-nanosecond resolution. Earlier versions hold
+// absolute UTC TOAs and read back with an epoch of 0.
+
+#define PDW_FILE_MAGIC 0x31574450   // "PDW1"
+#define PDW_INDEX_MAGIC 0x49574450  // "PDWI"
+#define PDW_FILE_FORMAT 3
+#define PDW_MAX_BLOCK_CAPACITY (1 << 24) // PDWs per block, so blockBytes fits in 32 bits
+
+struct PdwFileHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t blockCapacity;
+  std::uint32_t epochSec; // UTC second the TOAs are measured from, unused before version 3
+};
+
+struct PdwBlockHeader
+{
+  std::uint32_t numPdws;
+  std::uint32_t blockBytes; // size of the block including this header
+  std::double_t minToa;
+  std::double_t maxToa;
+  std::double_t minFreqHz;
+  std::double_t maxFreqHz;
+};
+
+struct PdwBlockIndex
+{
+  std::uint64_t offset; // file offset of the block header
+  PdwBlockHeader header;
+};
+
+struct PdwFileTrailer
+{
+  std::uint64_t indexOffset;
+  std::uint64_t numBlocks;
+  std::uint64_t numPdws;
+  std::uint32_t magic;
+  std::uint32_t spare0;
+};
+
+class PdwFileWriter
+{
+public:
+  PdwFileWriter();
+  ~PdwFileWriter();
+
+  // blockCapacity is clamped to [1, PDW_MAX_BLOCK_CAPACITY]
+  bool open(const std::string &filename, const std::uint32_t epochSec, const std::uint32_t blockCapacity = 65536);
+  bool isOpen() const { return fout.is_open(); }
+
+  // These return false once writing to the file has failed, after which
+  // nothing more is written to it
+  bool write(const Pdw &pdw);
+  bool write(const std::vector<Pdw> &pdws);
+
+  // Write out the last partial block and the index, returns false if any
+  // of the file failed to write
+  bool close();
+
+  std::uint64_t size() const { return numPdws; }
+
+private:
+  bool flushBlock();
+
+  std::ofstream fout;
+  bool failed;
+  std::uint32_t blockCapacity;
+  std::uint64_t numPdws;
+  std::vector<PdwBlockIndex> index;
+
+  // Columns of the block being built
+  std::vector<double> toa;
+  std::vector<double> freqHz;
+  std::vector<float> pwSec;
+  std::vector<float> snrDb;
+  std::vector<float> amp;
+  std::vector<float> chirpRateHzPerSec;
+  std::vector<std::uint16_t> bin;
+  std::vector<std::uint8_t> saturated;
+  std::vector<std::uint8_t> modulation;
+  std::vector<std::uint8_t> numChips;
+};
+
+// Columns of one block, pointing straight into the mapped file
+struct PdwBlockView
+{
+  std::size_t numPdws;
+  const double* toa;
+  const double* freqHz;
+  const float* pwSec;
+  const float* snrDb;
+  const float* amp;
+  const float* chirpRateHzPerSec;  // null in version 1 files
+  const std::uint16_t* bin;
+  const std::uint8_t* saturated;
+  const std::uint8_t* modulation;  // null in version 1 files
+  const std::uint8_t* numChips;    // null in version 1 files
+
+  Pdw at(const std::size_t ii) const;
+};
+
+class PdwFileReader
+{
+public:
+  PdwFileReader();
+  ~PdwFileReader();
+
+  bool open(const std::string &filename);
+  bool isOpen() const { return data != nullptr; }
+  void close();
+
+  std::uint64_t size() const { return numPdws; }
+  std::uint32_t epochSec() const { return epoch; }
+
+  // Whether the index had to be rebuilt and stopped at a partly written or
+  // corrupt block before the end of the file, losing whatever came after it
+  bool truncated() const { return isTruncated; }
+  std::size_t numBlocks() const { return index.size(); }
+  const PdwBlockIndex& blockIndex(const std::size_t block) const { return index[block]; }
+  PdwBlockView block(const std::size_t block) const;
+
+  // Append every PDW with toaMin <= toa <= toaMax and freqMin <= freqHz <= freqMax
+  // to pdws, only looking inside the blocks whose extents overlap the query
+  std::size_t query(const double toaMin, const double toaMax, const double freqMinHz, const double freqMaxHz, std::vector<Pdw> &pdws) const;
+
+  // Call fn(const PdwBlockView&) for each block that overlaps the query
+  template <typename Fn>
+  void forEachBlock(const double toaMin, const double toaMax, const double freqMinHz, const double freqMaxHz, Fn fn) const
+  {
+    for (std::size_t ii = 0; ii < index.size(); ii++)
+    {
+      const PdwBlockHeader &header = index[ii].header;
+
+      if (header.maxToa >= toaMin && header.minToa <= toaMax && header.maxFreqHz >= freqMinHz && header.minFreqHz <= freqMaxHz)
+      {
+        fn(block(ii));
+      }
+    }
+  }
+
+private:
+  bool readIndex();
+  bool rebuildIndex();
+
+  const std::uint8_t* data;
+  std::size_t dataSize;
+  std::uint32_t version;
+  std::uint32_t epoch;
+  bool isTruncated;
+  std::uint64_t numPdws;
+  std::vector<PdwBlockIndex> index;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "PeriodTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // Innovations beyond this many sigma are rejected as outliers
+  const double GATE_SIGMA = 5;
+
+  // Weight of each new innovation in the measurement noise estimate
+  const double NOISE_LEARNING_RATE = 0.1;
+}
+
+PeriodTracker::PeriodTracker(const double measurementSigmaSec, const double periodDriftSec) :
+  minMeasurementVar(measurementSigmaSec*measurementSigmaSec),
+  driftVar(periodDriftSec*periodDriftSec),
+  measurementVar(measurementSigmaSec*measurementSigmaSec),
+  isInitialized(false),
+  eventTime(0),
+  periodSec(0),
+  p00(0),
+  p01(0),
+  p11(0)
+{
+}
+
+void PeriodTracker::reset(const double eventTime, const double period, const double periodSigma)
+{
+  this->eventTime = eventTime;
+  periodSec = period;
+  p00 = measurementVar;
+  p01 = 0;
+  p11 = periodSigma*periodSigma;
+  isInitialized = true;
+}
+
+void PeriodTracker::propagate(const double n, double p[3]) const
+{
+  // F = [1 n; 0 1] plus a period random walk accumulated over n periods
+  p[0] = p00 + 2*n*p01 + n*n*p11 + driftVar*n*n*n/3;
+  p[1] = p01 + n*p11 + driftVar*n*n/2;
+  p[2] = p11 + driftVar*n;
+}
+
+bool PeriodTracker::update(const double measuredTime)
+{
+  if (!isInitialized)
+  {
+    return false;
+  }
+
+  const double numPeriods = std::round((measuredTime - eventTime)/periodSec);
+
+  if (numPeriods < 1)
+  {
+    return false;
+  }
+
+  double p[3];
+  propagate(numPeriods, p);
+
+  const double innovation = measuredTime - (eventTime + numPeriods*periodSec);
+  const double innovationVar = p[0] + measurementVar;
+
+  if (innovation*innovation > GATE_SIGMA*GATE_SIGMA*innovationVar)
+  {
+    return false;
+  }
+
+  const double k0 = p[0]/innovationVar;
+  const double k1 = p[1]/innovationVar;
+
+  eventTime += numPeriods*periodSec + k0*innovation;
+  periodSec += k1*innovation;
+
+  p00 = (1 - k0)*p[0];
+  p01 = (1 - k0)*p[1];
+  p11 = p[2] - k1*p[1];
+
+  // The part of the innovation the state uncertainty doesn't explain is
+  // measurement noise
+  measurementVar += NOISE_LEARNING_RATE*(innovation*innovation - p[0] - measurementVar);
+  measurementVar = std::max(measurementVar, minMeasurementVar);
+
+  return true;
+}
+
+double PeriodTracker::predict(const std::uint64_t numPeriods, double &sigma) const
+{
+  double p[3];
+  propagate(numPeriods, p);
+
+  // An event lands off the predicted time by the error of the prediction plus
+  // its own jitter, which is indistinguishable from measurement noise
+  sigma = std::sqrt(std::max(p[0], 0.0) + measurementVar);
+
+  return eventTime + numPeriods*periodSec;
+}
+
+double PeriodTracker::periodSigma() const
+{
+  return std::sqrt(std::max(p11, 0.0));
+}
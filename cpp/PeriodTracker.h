@@ -0,0 +1,52 @@
+#ifndef PeriodTracker_H
+#define PeriodTracker_H
+
+#include <cstdint>
+
+// Two state Kalman filter over the time of the last event and the period of
+// a periodic event. Each new event is matched to the whole number of periods
+// since the last one, so missed events don't throw it off, and the state is
+// propagated that many periods before the update. The period is allowed to
+// drift as a random walk, and the measurement noise is learnt from the
+// innovations so the prediction uncertainty tracks how well the event times
+// are actually being measured rather than a guess.
+class PeriodTracker
+{
+public:
+  // measurementSigmaSec is the smallest event time error assumed and
+  // periodDriftSec how much the period may wander (1 sigma) per period
+  PeriodTracker(const double measurementSigmaSec, const double periodDriftSec);
+
+  // Start tracking from an event time and a rough period
+  void reset(const double eventTime, const double period, const double periodSigma);
+
+  // Returns false, leaving the state alone, if the event is too far from any
+  // predicted event to be believed or is the last event seen again
+  bool update(const double eventTime);
+
+  // Time of the event numPeriods on from the last one, and the 1 sigma spread
+  // of where it will actually be seen
+  double predict(const std::uint64_t numPeriods, double &sigma) const;
+
+  bool initialized() const { return isInitialized; }
+  double lastEventTime() const { return eventTime; }
+  double period() const { return periodSec; }
+  double periodSigma() const;
+
+private:
+  // Covariance after propagating numPeriods periods
+  void propagate(const double numPeriods, double p[3]) const;
+
+  double minMeasurementVar;
+  double driftVar;
+  double measurementVar; // learnt from the innovations
+
+  bool isInitialized;
+  double eventTime;
+  double periodSec;
+  double p00; // variance of eventTime
+  double p01; // covariance of eventTime and periodSec
+  double p11; // variance of periodSec
+};
+
+#endif
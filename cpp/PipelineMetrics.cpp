@@ -0,0 +1,279 @@
+#include "PipelineMetrics.h"
+#include "ThreadConfig.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <cstdio>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+namespace
+{
+  const double CALIBRATION_SEC = 20e-3;
+  const double SUMMARY_FRACTIONS[] = {0.5, 0.9, 0.99, 0.999};
+
+  double measureSecondsPerTick()
+  {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::uint64_t startTicks = readTsc();
+
+    while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < CALIBRATION_SEC)
+    {
+    }
+
+    const double elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return elapsedSec/std::max<std::uint64_t>(readTsc() - startTicks, 1);
+  }
+
+  void atomicMax(std::atomic<std::uint64_t> &current, const std::uint64_t value)
+  {
+    std::uint64_t seen = current.load(std::memory_order_relaxed);
+
+    while (value > seen && !current.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+    }
+  }
+}
+
+std::uint64_t readTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
+#endif
+}
+
+double tscSecondsPerTick()
+{
+  static const double secondsPerTick = measureSecondsPerTick();
+
+  return secondsPerTick;
+}
+
+LatencyHistogram::LatencyHistogram() : total(0), sumTicks(0), maxTicks(0)
+{
+  for (std::atomic<std::uint64_t> &bucket : buckets)
+  {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+int LatencyHistogram::bucketOf(const std::uint64_t ticks)
+{
+  if (ticks < SUB_BUCKETS)
+  {
+    return ticks;
+  }
+
+  // Top SUB_BUCKET_BITS bits below the leading one pick the bucket within
+  // the value's power of two
+  const int shift = 63 - __builtin_clzll(ticks) - SUB_BUCKET_BITS;
+
+  return (shift + 1)*SUB_BUCKETS + ((ticks >> shift) - SUB_BUCKETS);
+}
+
+std::uint64_t LatencyHistogram::bucketMidpoint(const int bucket)
+{
+  if (bucket < SUB_BUCKETS)
+  {
+    return bucket;
+  }
+
+  const int shift = bucket/SUB_BUCKETS - 1;
+
+  return ((std::uint64_t(bucket % SUB_BUCKETS) + SUB_BUCKETS) << shift) + ((std::uint64_t(1) << shift) >> 1);
+}
+
+void LatencyHistogram::record(const std::uint64_t ticks)
+{
+  buckets[bucketOf(ticks)].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(1, std::memory_order_relaxed);
+  sumTicks.fetch_add(ticks, std::memory_order_relaxed);
+  atomicMax(maxTicks, ticks);
+}
+
+double LatencyHistogram::sumSec() const
+{
+  return sumTicks.load(std::memory_order_relaxed)*tscSecondsPerTick();
+}
+
+double LatencyHistogram::maxSec() const
+{
+  return maxTicks.load(std::memory_order_relaxed)*tscSecondsPerTick();
+}
+
+double LatencyHistogram::meanSec() const
+{
+  const std::uint64_t n = count();
+
+  return (n > 0) ? sumSec()/n : 0;
+}
+
+double LatencyHistogram::percentileSec(const double fraction) const
+{
+  const std::uint64_t n = count();
+
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  const std::uint64_t rank = std::max<std::uint64_t>(std::ceil(fraction*n), 1);
+  std::uint64_t seen = 0;
+
+  for (int ii = 0; ii < NUM_BUCKETS; ii++)
+  {
+    seen += buckets[ii].load(std::memory_order_relaxed);
+
+    if (seen >= rank)
+    {
+      // Never past the largest value actually recorded
+      return std::min(bucketMidpoint(ii)*tscSecondsPerTick(), maxSec());
+    }
+  }
+
+  return maxSec();
+}
+
+PipelineMetrics::PipelineMetrics(const std::string &tool, const double dwellBudgetSec) :
+  dwells(0),
+  overruns(0),
+  timeouts(0),
+  shortReads(0),
+  tool(tool),
+  dwellBudgetSec(dwellBudgetSec),
+  stopping(false)
+{
+  // Calibrate now rather than in the middle of the first dwell
+  tscSecondsPerTick();
+}
+
+PipelineMetrics::~PipelineMetrics()
+{
+  if (exporter.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+
+    stopRequested.notify_all();
+    exporter.join();
+
+    exportNow();
+  }
+}
+
+bool PipelineMetrics::startExport(const std::string &path, const double periodSec)
+{
+  exportPath = path;
+
+  if (!exportNow())
+  {
+    return false;
+  }
+
+  exporter = std::thread(&PipelineMetrics::runExport, this, periodSec);
+
+  return true;
+}
+
+void PipelineMetrics::runExport(const double periodSec)
+{
+  applyBackgroundPlacement("Metrics");
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (!stopRequested.wait_for(lock, std::chrono::duration<double>(periodSec), [this] { return stopping; }))
+  {
+    exportNow();
+  }
+}
+
+bool PipelineMetrics::exportNow() const
+{
+  // Written aside and renamed over the old file so a scrape never sees half of it
+  const std::string tempPath = exportPath + ".tmp";
+  std::ofstream file(tempPath, std::ios::trunc);
+
+  const char* stages[] = {"recv", "process", "write"};
+  const LatencyHistogram* histograms[] = {&recv, &process, &write};
+
+  file << std::setprecision(9);
+  file << "# HELP sdr_stage_seconds Time a dwell spent in each pipeline stage" << std::endl;
+  file << "# TYPE sdr_stage_seconds summary" << std::endl;
+
+  for (int ii = 0; ii < 3; ii++)
+  {
+    const std::string labels = "tool=\"" + tool + "\",stage=\"" + stages[ii] + "\"";
+
+    for (const double fraction : SUMMARY_FRACTIONS)
+    {
+      file << "sdr_stage_seconds{" << labels << ",quantile=\"" << fraction << "\"} " << histograms[ii]->percentileSec(fraction) << std::endl;
+    }
+
+    file << "sdr_stage_seconds_sum{" << labels << "} " << histograms[ii]->sumSec() << std::endl;
+    file << "sdr_stage_seconds_count{" << labels << "} " << histograms[ii]->count() << std::endl;
+  }
+
+  file << "# HELP sdr_stage_max_seconds Longest a dwell has spent in each pipeline stage" << std::endl;
+  file << "# TYPE sdr_stage_max_seconds gauge" << std::endl;
+
+  for (int ii = 0; ii < 3; ii++)
+  {
+    file << "sdr_stage_max_seconds{tool=\"" << tool << "\",stage=\"" << stages[ii] << "\"} " << histograms[ii]->maxSec() << std::endl;
+  }
+
+  file << "# HELP sdr_dwell_budget_seconds Time one dwell covers" << std::endl;
+  file << "# TYPE sdr_dwell_budget_seconds gauge" << std::endl;
+  file << "sdr_dwell_budget_seconds{tool=\"" << tool << "\"} " << dwellBudgetSec.load(std::memory_order_relaxed) << std::endl;
+
+  const char* counterNames[] = {"dwells", "overruns", "timeouts", "short_reads"};
+  const std::atomic<std::uint64_t>* counters[] = {&dwells, &overruns, &timeouts, &shortReads};
+
+  for (int ii = 0; ii < 4; ii++)
+  {
+    file << "# TYPE sdr_" << counterNames[ii] << "_total counter" << std::endl;
+    file << "sdr_" << counterNames[ii] << "_total{tool=\"" << tool << "\"} " << counters[ii]->load(std::memory_order_relaxed) << std::endl;
+  }
+
+  file.close();
+
+  if (!file || std::rename(tempPath.c_str(), exportPath.c_str()) != 0)
+  {
+    std::cout << "Failed to export metrics to " << exportPath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+void PipelineMetrics::printSummary() const
+{
+  const char* stages[] = {"recv", "process", "write"};
+  const LatencyHistogram* histograms[] = {&recv, &process, &write};
+
+  const double budgetSec = dwellBudgetSec.load(std::memory_order_relaxed);
+
+  std::cout << "Stage times per dwell (ms), and the p99 as a share of the " << budgetSec*1e3 << " ms dwell:" << std::endl;
+
+  for (int ii = 0; ii < 3; ii++)
+  {
+    const LatencyHistogram &h = *histograms[ii];
+
+    std::cout << std::fixed << std::setprecision(3) << "  " << std::setw(7) << std::left << stages[ii] << std::right << " n " << h.count() << ", mean " << h.meanSec()*1e3 << ", p50 " << h.percentileSec(0.5)*1e3 << ", p99 " << h.percentileSec(0.99)*1e3 << ", p99.9 " << h.percentileSec(0.999)*1e3 << ", max " << h.maxSec()*1e3;
+    std::cout << std::setprecision(1) << ", " << ((budgetSec > 0) ? 100*h.percentileSec(0.99)/budgetSec : 0) << "%" << std::endl;
+  }
+
+  std::cout << std::defaultfloat << std::setprecision(6);
+  std::cout << "  " << dwells << " dwells, " << overruns << " overruns, " << timeouts << " timeouts, " << shortReads << " short reads" << std::endl;
+}
@@ -0,0 +1,97 @@
+#ifndef PipelineMetrics_H
+#define PipelineMetrics_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Cheapest timestamp there is: the TSC on x86, the steady clock elsewhere
+std::uint64_t readTsc();
+
+// Length of a readTsc() tick, measured against the steady clock the first
+// time it's asked for
+double tscSecondsPerTick();
+
+// Durations in TSC ticks, bucketed log-linearly like an HDR histogram: every
+// power of two is split into 32 buckets, so any value is known to within 3%
+// however long it is. Recording is a few relaxed atomics and never blocks, so
+// several threads can record into one histogram while another reads it.
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(const std::uint64_t ticks);
+  void recordSince(const std::uint64_t startTicks) { record(readTsc() - startTicks); }
+
+  std::uint64_t count() const { return total.load(std::memory_order_relaxed); }
+  double sumSec() const;
+  double maxSec() const;
+  double meanSec() const;
+  double percentileSec(const double fraction) const; // e.g. 0.99
+
+private:
+  static const int SUB_BUCKET_BITS = 5;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1)*SUB_BUCKETS;
+
+  static int bucketOf(const std::uint64_t ticks);
+  static std::uint64_t bucketMidpoint(const int bucket);
+
+  std::atomic<std::uint64_t> buckets[NUM_BUCKETS];
+  std::atomic<std::uint64_t> total;
+  std::atomic<std::uint64_t> sumTicks;
+  std::atomic<std::uint64_t> maxTicks;
+};
+
+// Where the time of every dwell goes and what went wrong with it, the same
+// stages and counters for every tool: recv is waiting on the device, process
+// is everything done to a dwell in memory, write is getting it to disk.
+// Optionally exported every few seconds in the Prometheus text format, for
+// node_exporter's textfile collector or anything else that can read a file,
+// and summarized at exit against the dwell time so it's plain how close each
+// stage is to falling behind.
+class PipelineMetrics
+{
+public:
+  PipelineMetrics(const std::string &tool, const double dwellBudgetSec);
+  ~PipelineMetrics();
+
+  PipelineMetrics(const PipelineMetrics &) = delete;
+  PipelineMetrics& operator=(const PipelineMetrics &) = delete;
+
+  // Rewrites path every periodSec until destroyed, and once more then
+  bool startExport(const std::string &path, const double periodSec = 5);
+
+  void printSummary() const;
+
+  // For tools whose dwells change length, like the daemon from job to job
+  void setDwellBudget(const double sec) { dwellBudgetSec.store(sec, std::memory_order_relaxed); }
+
+  LatencyHistogram recv;
+  LatencyHistogram process;
+  LatencyHistogram write;
+
+  std::atomic<std::uint64_t> dwells;
+  std::atomic<std::uint64_t> overruns;
+  std::atomic<std::uint64_t> timeouts;
+  std::atomic<std::uint64_t> shortReads;
+
+private:
+  bool exportNow() const;
+  void runExport(const double periodSec);
+
+  std::string tool;
+  std::atomic<double> dwellBudgetSec;
+
+  std::string exportPath;
+  std::thread exporter;
+  std::mutex mutex;
+  std::condition_variable stopRequested;
+  bool stopping;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "PipelineTrace.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> traceEnabled(false);
+
+namespace
+{
+  struct TraceEvent
+  {
+    const char* name;
+    std::uint64_t startTicks;
+    std::uint64_t endTicks; // 0 for an instant
+  };
+
+  // Written only by its own thread, read once recording has stopped
+  struct ThreadTrace
+  {
+    long tid;
+    std::string name;
+    std::vector<TraceEvent> events;
+    std::atomic<std::uint64_t> recorded;
+  };
+
+  std::mutex registryMutex;
+  std::vector<std::unique_ptr<ThreadTrace>> threadTraces; // kept past the end of their threads
+  std::size_t eventsPerThread = 0;
+  std::uint64_t traceStartTicks = 0;
+
+  thread_local ThreadTrace* currentTrace = nullptr;
+  thread_local const char* currentName = nullptr;
+  thread_local std::size_t currentEventsToKeep = 0;
+
+  ThreadTrace* registerThread()
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    std::unique_ptr<ThreadTrace> trace(new ThreadTrace);
+    trace->tid = syscall(SYS_gettid);
+    trace->name = (currentName != nullptr) ? currentName : "thread " + std::to_string(trace->tid);
+    trace->events.resize((currentEventsToKeep > 0) ? currentEventsToKeep : eventsPerThread);
+    trace->recorded.store(0, std::memory_order_relaxed);
+
+    threadTraces.push_back(std::move(trace));
+
+    return threadTraces.back().get();
+  }
+
+  void writeEvent(std::ostream &file, const TraceEvent &event, const long tid)
+  {
+    const double usPerTick = tscSecondsPerTick()*1e6;
+    const double ts = (std::int64_t(event.startTicks - traceStartTicks))*usPerTick;
+
+    file << ",\n{\"name\":\"" << event.name << "\",\"pid\":" << getpid() << ",\"tid\":" << tid << ",\"ts\":" << ts;
+
+    if (event.endTicks == 0)
+    {
+      file << ",\"ph\":\"i\",\"s\":\"t\"}";
+    }
+    else
+    {
+      file << ",\"ph\":\"X\",\"dur\":" << (event.endTicks - event.startTicks)*usPerTick << "}";
+    }
+  }
+}
+
+void startTrace(const std::size_t eventsPerThreadToKeep)
+{
+  // Calibrate now rather than in the middle of the first dwell
+  tscSecondsPerTick();
+
+  eventsPerThread = eventsPerThreadToKeep;
+  traceStartTicks = readTsc();
+  traceEnabled.store(true, std::memory_order_release);
+}
+
+void nameTraceThread(const char* name, const std::size_t eventsToKeep)
+{
+  currentName = name;
+  currentEventsToKeep = eventsToKeep;
+
+  if (currentTrace != nullptr)
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    currentTrace->name = name;
+  }
+  else if (traceEnabled.load(std::memory_order_acquire))
+  {
+    // Allocate the thread's events now rather than on its first event,
+    // which for the receive thread is in the middle of its first dwell
+    currentTrace = registerThread();
+  }
+}
+
+void recordTraceEvent(const char* name, const std::uint64_t startTicks, const std::uint64_t endTicks)
+{
+  if (!traceEnabled.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  if (currentTrace == nullptr)
+  {
+    currentTrace = registerThread();
+  }
+
+  // Single writer, so a plain ring: the oldest event goes once it's full
+  const std::uint64_t index = currentTrace->recorded.load(std::memory_order_relaxed);
+
+  currentTrace->events[index % currentTrace->events.size()] = {name, startTicks, endTicks};
+  currentTrace->recorded.store(index + 1, std::memory_order_release);
+}
+
+bool writeTrace(const std::string &path)
+{
+  if (!traceEnabled.exchange(false))
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  std::ofstream file(path, std::ios::trunc);
+  std::uint64_t numWritten = 0;
+  std::uint64_t numOverwritten = 0;
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << getpid() << ",\"args\":{\"name\":\"" << program_invocation_short_name << "\"}}";
+
+  for (const std::unique_ptr<ThreadTrace> &trace : threadTraces)
+  {
+    const std::uint64_t recorded = trace->recorded.load(std::memory_order_acquire);
+    const std::size_t kept = trace->events.size();
+    const std::uint64_t first = (recorded > kept) ? recorded - kept : 0;
+
+    file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << getpid() << ",\"tid\":" << trace->tid << ",\"args\":{\"name\":\"" << trace->name << "\"}}";
+
+    for (std::uint64_t ii = first; ii < recorded; ii++)
+    {
+      writeEvent(file, trace->events[ii % kept], trace->tid);
+    }
+
+    numWritten += recorded - first;
+    numOverwritten += first;
+  }
+
+  file << "\n]}" << std::endl;
+
+  if (!file)
+  {
+    std::cout << "Failed to write trace to " << path << std::endl;
+    return false;
+  }
+
+  std::cout << "Trace of " << numWritten << " events on " << threadTraces.size() << " threads written to " << path;
+
+  if (numOverwritten > 0)
+  {
+    std::cout << ", " << numOverwritten << " older events overwritten";
+  }
+
+  std::cout << std::endl;
+
+  return true;
+}
@@ -0,0 +1,79 @@
+#ifndef PipelineTrace_H
+#define PipelineTrace_H
+
+#include "PipelineMetrics.h"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// Timeline of every pipeline stage on every thread, written out as Chrome
+// trace JSON for chrome://tracing or Perfetto, so a stall can be pinned on
+// the disk, the scheduler or a retune by what was running around it. Each
+// thread records into a buffer of its own with no locking; the buffer is a
+// ring keeping that thread's latest events, so a long run keeps the minutes
+// before it ended rather than the start. Stage names have to be string
+// literals, only the pointer is kept. Costs a branch when tracing is off.
+
+extern std::atomic<bool> traceEnabled;
+
+// Events kept by each thread of a pool, which can have a thread per CPU, less
+// than a receive thread keeps: 768 KB a thread against 24 MB
+const std::size_t TRACE_POOL_EVENTS = 1 << 15;
+
+// Start recording, keeping up to eventsPerThread events on each thread
+void startTrace(const std::size_t eventsPerThread = 1 << 20);
+
+// Stop recording and write everything kept so far
+bool writeTrace(const std::string &path);
+
+// Name the calling thread in the timeline, e.g. "RX" or "Writer". Once
+// recording has started this also allocates the thread's events, which
+// otherwise happens on the first event it records. eventsToKeep replaces
+// startTrace()'s eventsPerThread for this thread if it's given, e.g.
+// TRACE_POOL_EVENTS for the workers of a pool.
+void nameTraceThread(const char* name, const std::size_t eventsToKeep = 0);
+
+void recordTraceEvent(const char* name, const std::uint64_t startTicks, const std::uint64_t endTicks);
+
+// The stage from startTicks until now, for stages already timed for PipelineMetrics
+inline void traceSince(const char* name, const std::uint64_t startTicks)
+{
+  if (traceEnabled.load(std::memory_order_relaxed))
+  {
+    recordTraceEvent(name, startTicks, readTsc());
+  }
+}
+
+// A moment rather than a stretch of time, e.g. an overrun
+inline void traceInstant(const char* name)
+{
+  if (traceEnabled.load(std::memory_order_relaxed))
+  {
+    recordTraceEvent(name, readTsc(), 0);
+  }
+}
+
+// Records the stage from here to the end of the scope
+class TraceScope
+{
+public:
+  TraceScope(const char* name) : name(name), startTicks(traceEnabled.load(std::memory_order_relaxed) ? readTsc() : 0) {}
+
+  ~TraceScope()
+  {
+    if (startTicks != 0)
+    {
+      recordTraceEvent(name, startTicks, readTsc());
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope& operator=(const TraceScope &) = delete;
+
+private:
+  const char* name;
+  std::uint64_t startTicks;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "PreTriggerBuffer.h"
+
+#include <algorithm>
+
+PreTriggerBuffer::PreTriggerBuffer(const std::size_t capacity, const std::size_t preTriggerSamples, const std::size_t postTriggerSamples, const std::size_t maxCaptures) :
+  ring(std::max<std::size_t>(capacity, 1)),
+  preTriggerSamples(preTriggerSamples),
+  postTriggerSamples(postTriggerSamples),
+  maxCaptureSamples(std::max<std::size_t>(ring.size()/2, 1)),
+  endIndex(0),
+  handedOutIndex(0),
+  numDropped(0),
+  pool(maxCaptureSamples*sizeof(std::complex<std::int16_t>), std::max<std::size_t>(maxCaptures, 1))
+{
+  pool.preallocate();
+}
+
+void PreTriggerBuffer::reset()
+{
+  for (Slice &slice : pending)
+  {
+    // A slice that was queued ahead of the samples can have lost its start
+    // to the ring wrapping while it waited for them
+    slice.startIndex = std::max(slice.startIndex, oldestIndex());
+    slice.endIndex = std::min(slice.endIndex, endIndex);
+
+    if (slice.startIndex < slice.endIndex)
+    {
+      complete(slice);
+    }
+  }
+
+  pending.clear();
+  endIndex = 0;
+  handedOutIndex = 0;
+}
+
+void PreTriggerBuffer::write(const std::complex<std::int16_t>* iq, const std::size_t numSamples)
+{
+  // Only the last ring.size() samples can be kept
+  const std::size_t skip = numSamples > ring.size() ? numSamples - ring.size() : 0;
+  std::size_t offset = (endIndex + skip) % ring.size();
+
+  for (std::size_t written = skip; written < numSamples;)
+  {
+    const std::size_t length = std::min(numSamples - written, ring.size() - offset);
+
+    std::copy(&iq[written], &iq[written] + length, &ring[offset]);
+
+    written += length;
+    offset = 0;
+  }
+
+  endIndex += numSamples;
+
+  // Hand out the captures whose samples have all arrived, cutting off the
+  // start of any whose earliest samples were overwritten before they did
+  while (!pending.empty() && pending.front().endIndex <= endIndex)
+  {
+    Slice &slice = pending.front();
+    slice.startIndex = std::max(slice.startIndex, oldestIndex());
+
+    if (slice.startIndex < slice.endIndex)
+    {
+      complete(slice);
+    }
+
+    handedOutIndex = slice.endIndex;
+    pending.pop_front();
+  }
+}
+
+void PreTriggerBuffer::trigger(const std::uint64_t sampleIndex)
+{
+  trigger(sampleIndex, preTriggerSamples, postTriggerSamples);
+}
+
+void PreTriggerBuffer::trigger(const std::uint64_t sampleIndex, const std::size_t preSamples, const std::size_t postSamples)
+{
+  Slice slice = {sampleIndex > preSamples ? sampleIndex - preSamples : 0, sampleIndex + postSamples};
+
+  // Nothing before the oldest sample still in the ring or before the end of
+  // a capture that has already been handed out can be had
+  slice.startIndex = std::max({slice.startIndex, oldestIndex(), handedOutIndex});
+
+  // A capture has to fit in a pool block, so a longer trigger is cut short
+  slice.endIndex = std::min(slice.endIndex, slice.startIndex + maxCaptureSamples);
+
+  if (slice.endIndex <= slice.startIndex)
+  {
+    return;
+  }
+
+  // Triggers mostly arrive in order, so the slice usually belongs at the end
+  // of the queue or merges into its last capture
+  std::size_t ii = pending.size();
+
+  while (ii > 0 && pending[ii - 1].startIndex > slice.startIndex)
+  {
+    ii--;
+  }
+
+  pending.insert(pending.begin() + ii, slice);
+
+  // Merge it into the capture before it if they overlap, or if that would
+  // make too long a capture, start it where that one stops
+  if (ii > 0 && pending[ii].startIndex <= pending[ii - 1].endIndex)
+  {
+    if (std::max(pending[ii].endIndex, pending[ii - 1].endIndex) - pending[ii - 1].startIndex <= maxCaptureSamples)
+    {
+      pending[ii - 1].endIndex = std::max(pending[ii - 1].endIndex, pending[ii].endIndex);
+      pending.erase(pending.begin() + ii);
+      ii--;
+    }
+    else
+    {
+      pending[ii].startIndex = pending[ii - 1].endIndex;
+    }
+  }
+
+  if (pending[ii].endIndex <= pending[ii].startIndex)
+  {
+    pending.erase(pending.begin() + ii);
+    return;
+  }
+
+  // Then do the same with the captures after it that it now reaches
+  while (ii + 1 < pending.size() && pending[ii + 1].startIndex <= pending[ii].endIndex)
+  {
+    if (std::max(pending[ii + 1].endIndex, pending[ii].endIndex) - pending[ii].startIndex <= maxCaptureSamples)
+    {
+      pending[ii].endIndex = std::max(pending[ii].endIndex, pending[ii + 1].endIndex);
+      pending.erase(pending.begin() + ii + 1);
+    }
+    else
+    {
+      pending[ii].endIndex = pending[ii + 1].startIndex;
+      break;
+    }
+  }
+}
+
+bool PreTriggerBuffer::pop(Capture &capture)
+{
+  if (ready.empty())
+  {
+    return false;
+  }
+
+  capture = ready.front();
+  ready.pop_front();
+
+  return true;
+}
+
+void PreTriggerBuffer::release(const Capture &capture)
+{
+  pool.release(capture.iq);
+}
+
+void PreTriggerBuffer::complete(const Slice &slice)
+{
+  Capture capture;
+  capture.startIndex = slice.startIndex;
+  capture.numSamples = slice.endIndex - slice.startIndex;
+  capture.iq = pool.tryAcquire<std::complex<std::int16_t>>();
+
+  if (capture.iq == nullptr)
+  {
+    numDropped++;
+    return;
+  }
+
+  std::size_t offset = slice.startIndex % ring.size();
+
+  for (std::size_t copied = 0; copied < capture.numSamples;)
+  {
+    const std::size_t length = std::min(capture.numSamples - copied, ring.size() - offset);
+
+    std::copy(&ring[offset], &ring[offset] + length, &capture.iq[copied]);
+
+    copied += length;
+    offset = 0;
+  }
+
+  ready.push_back(capture);
+}
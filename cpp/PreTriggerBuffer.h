@@ -0,0 +1,77 @@
+#ifndef PreTriggerBuffer_H
+#define PreTriggerBuffer_H
+
+#include "BufferPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <deque>
+#include <vector>
+
+struct Capture
+{
+  std::uint64_t startIndex; // stream index of iq[0]
+  std::size_t numSamples;
+  std::complex<std::int16_t>* iq; // a block of the buffer's pool, given back with release()
+};
+
+// Ring buffer of the most recent samples of a continuous stream that only
+// hands out the slices around triggers. A trigger asks for the samples from
+// some time before a stream index to some time after it; the index can be in
+// the past (as far back as the ring reaches) or in the future, e.g. a
+// predicted event. Triggers whose slices overlap or touch are merged into one
+// capture, up to half the ring long, and a capture is handed out once the
+// last of its samples has been written.
+//
+// Captures are copied out of the ring into one of maxCaptures blocks
+// allocated up front, which whoever writes them out gives back with
+// release(), from any thread. A capture that completes while every block is
+// still out is dropped and counted rather than allocating on the thread
+// feeding the ring.
+class PreTriggerBuffer
+{
+public:
+  PreTriggerBuffer(const std::size_t capacity, const std::size_t preTriggerSamples, const std::size_t postTriggerSamples, const std::size_t maxCaptures);
+
+  // Start the stream again at index 0, e.g. after samples were dropped. Any
+  // capture still waiting is cut short at the last sample written.
+  void reset();
+
+  void write(const std::complex<std::int16_t>* iq, const std::size_t numSamples);
+
+  void trigger(const std::uint64_t sampleIndex);
+  void trigger(const std::uint64_t sampleIndex, const std::size_t preSamples, const std::size_t postSamples);
+
+  // Returns false if no capture is complete yet
+  bool pop(Capture &capture);
+  void release(const Capture &capture);
+
+  std::uint64_t capturesDropped() const { return numDropped; }
+
+  std::uint64_t samplesWritten() const { return endIndex; }
+  std::uint64_t oldestIndex() const { return endIndex > ring.size() ? endIndex - ring.size() : 0; }
+
+private:
+  struct Slice
+  {
+    std::uint64_t startIndex;
+    std::uint64_t endIndex; // one past the last sample
+  };
+
+  // Copy a finished slice out to the ready queue, if a block is free
+  void complete(const Slice &slice);
+
+  std::vector<std::complex<std::int16_t>> ring;
+  std::size_t preTriggerSamples;
+  std::size_t postTriggerSamples;
+  std::size_t maxCaptureSamples;
+  std::uint64_t endIndex;       // stream index of the next sample to be written
+  std::uint64_t handedOutIndex; // end of the last capture handed out
+  std::uint64_t numDropped;
+  std::deque<Slice> pending;
+  std::deque<Capture> ready;
+  BufferPool pool;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "PulseDetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PulseDetector::PulseDetector(const float sampMax) : sampMax(sampMax), trailingEdgeRatio(1)
+{
+  reset();
+}
+
+void PulseDetector::reset()
+{
+  sampleIndex = 0;
+  pulseActive = false;
+  pulseToa = 0;
+  pulsePowerSum = 0;
+  pulseSaturated = false;
+  pulsePhaseSum = 0;
+  previousSample = 0;
+}
+
+namespace
+{
+  // Lets a single threshold be indexed like a per sample threshold array
+  struct ConstantThreshold
+  {
+    float value;
+
+    float operator[](const std::size_t) const { return value; }
+  };
+
+  // Per sample threshold array offset to the start of the current chunk
+  struct ThresholdArray
+  {
+    const float* values;
+
+    float operator[](const std::size_t ii) const { return values[ii]; }
+  };
+
+  ConstantThreshold advance(const ConstantThreshold &threshold, const std::size_t)
+  {
+    return threshold;
+  }
+
+  ThresholdArray advance(const ThresholdArray &threshold, const std::size_t offset)
+  {
+    return {threshold.values + offset};
+  }
+
+  // Sum of x[n]*conj(x[n-1]) over a chunk, previous being the sample before it
+  template <std::size_t CHUNK_SIZE, std::size_t LANES>
+  std::complex<double> phaseStepSum(const float* chunk, const std::complex<float> previous)
+  {
+    float reLane[LANES] = {};
+    float imLane[LANES] = {};
+
+    reLane[0] = chunk[0]*previous.real() + chunk[1]*previous.imag();
+    imLane[0] = chunk[1]*previous.real() - chunk[0]*previous.imag();
+
+    for (std::size_t jj = 1; jj < CHUNK_SIZE; jj += LANES)
+    {
+      for (std::size_t kk = 0; kk < LANES && jj + kk < CHUNK_SIZE; kk++)
+      {
+        const float re = chunk[2*(jj+kk)];
+        const float im = chunk[2*(jj+kk)+1];
+        const float prevRe = chunk[2*(jj+kk)-2];
+        const float prevIm = chunk[2*(jj+kk)-1];
+
+        reLane[kk] += re*prevRe + im*prevIm;
+        imLane[kk] += im*prevRe - re*prevIm;
+      }
+    }
+
+    double re = 0;
+    double im = 0;
+
+    for (std::size_t kk = 0; kk < LANES; kk++)
+    {
+      re += reLane[kk];
+      im += imLane[kk];
+    }
+
+    return {re, im};
+  }
+}
+
+std::size_t PulseDetector::process(const std::complex<float>* iq, const std::size_t numSamples, const float thresholdPower, std::vector<DetectedPulse> &pulses)
+{
+  return processBlock(iq, numSamples, ConstantThreshold{thresholdPower}, pulses);
+}
+
+std::size_t PulseDetector::process(const std::complex<float>* iq, const std::size_t numSamples, const float* thresholdPower, std::vector<DetectedPulse> &pulses)
+{
+  return processBlock(iq, numSamples, ThresholdArray{thresholdPower}, pulses);
+}
+
+template <typename Threshold>
+std::size_t PulseDetector::processBlock(const std::complex<float>* iq, const std::size_t numSamples, const Threshold &thresholdPower, std::vector<DetectedPulse> &pulses)
+{
+  const std::size_t startSize = pulses.size();
+  const float* samples = reinterpret_cast<const float*>(iq);
+
+  alignas(64) float power[CHUNK_SIZE];
+
+  std::size_t ii = 0;
+
+  for (; ii + CHUNK_SIZE <= numSamples; ii += CHUNK_SIZE)
+  {
+    const float* chunk = &samples[2*ii];
+    const Threshold threshold = advance(thresholdPower, ii);
+
+    // Track the margin of each sample over its leading and trailing edge
+    // thresholds, so the chunk holds no leading edge if every leading margin
+    // is negative and no trailing edge if every trailing margin is positive
+    float maxLane[LANES];
+    float minLane[LANES];
+    float sumLane[LANES];
+    float peakLane[LANES];
+
+    for (std::size_t kk = 0; kk < LANES; kk++)
+    {
+      maxLane[kk] = std::numeric_limits<float>::lowest();
+      minLane[kk] = std::numeric_limits<float>::max();
+      sumLane[kk] = 0;
+      peakLane[kk] = 0;
+    }
+
+    // Power, margin min/max, sum and the largest I or Q of the chunk in one pass
+    for (std::size_t jj = 0; jj < CHUNK_SIZE; jj += LANES)
+    {
+      for (std::size_t kk = 0; kk < LANES; kk++)
+      {
+        const float re = chunk[2*(jj+kk)];
+        const float im = chunk[2*(jj+kk)+1];
+        const float p = re*re + im*im;
+        const float a = std::max(std::abs(re), std::abs(im));
+        const float margin = p - threshold[jj+kk];
+        const float trailingMargin = p - threshold[jj+kk]*trailingEdgeRatio;
+
+        power[jj+kk] = p;
+        maxLane[kk] = std::max(maxLane[kk], margin);
+        minLane[kk] = std::min(minLane[kk], trailingMargin);
+        sumLane[kk] += p;
+        peakLane[kk] = std::max(peakLane[kk], a);
+      }
+    }
+
+    float chunkMax = maxLane[0];
+    float chunkMin = minLane[0];
+    float chunkSum = sumLane[0];
+    float chunkPeak = peakLane[0];
+
+    for (std::size_t kk = 1; kk < LANES; kk++)
+    {
+      chunkMax = std::max(chunkMax, maxLane[kk]);
+      chunkMin = std::min(chunkMin, minLane[kk]);
+      chunkSum += sumLane[kk];
+      chunkPeak = std::max(chunkPeak, peakLane[kk]);
+    }
+
+    if (!pulseActive && chunkMax < 0)
+    {
+      // Nothing but noise in this chunk
+      sampleIndex += CHUNK_SIZE;
+    }
+    else if (pulseActive && chunkMin > 0)
+    {
+      // The whole chunk is inside the pulse
+      pulsePowerSum += chunkSum;
+      pulseSaturated |= (chunkPeak >= sampMax);
+      pulsePhaseSum += phaseStepSum<CHUNK_SIZE, LANES>(chunk, (ii > 0) ? iq[ii-1] : previousSample);
+      sampleIndex += CHUNK_SIZE;
+    }
+    else
+    {
+      scanChunk(&iq[ii], (ii > 0) ? iq[ii-1] : previousSample, power, CHUNK_SIZE, threshold, pulses);
+    }
+  }
+
+  // Whatever is left over is shorter than a chunk so just walk it
+  const std::size_t remaining = numSamples - ii;
+
+  for (std::size_t jj = 0; jj < remaining; jj++)
+  {
+    power[jj] = std::norm(iq[ii+jj]);
+  }
+
+  scanChunk(&iq[ii], (ii > 0) ? iq[ii-1] : previousSample, power, remaining, advance(thresholdPower, ii), pulses);
+
+  if (numSamples > 0)
+  {
+    previousSample = iq[numSamples-1];
+  }
+
+  return pulses.size() - startSize;
+}
+
+template <typename Threshold>
+void PulseDetector::scanChunk(const std::complex<float>* iq, const std::complex<float> previous, const float* power, const std::size_t numSamples, const Threshold &thresholdPower, std::vector<DetectedPulse> &pulses)
+{
+  for (std::size_t jj = 0; jj < numSamples; jj++, sampleIndex++)
+  {
+    // Look for a leading edge
+    if (!pulseActive)
+    {
+      if (power[jj] >= thresholdPower[jj])
+      {
+        pulseActive = true; // a pulse is now active
+        pulseToa = sampleIndex; // initialize the time of arrival to current index
+        pulsePowerSum = power[jj];
+        pulseSaturated = false; // initialize whether the pulse was ever saturated
+        pulsePhaseSum = 0;
+      }
+    }
+    else // Look for a trailing edge now that pulse is active
+    {
+      if (power[jj] <= thresholdPower[jj]*trailingEdgeRatio) // Declare a trailing edge
+      {
+        pulseActive = false; // the pulse is no longer active
+
+        pulses.push_back({pulseToa, sampleIndex - pulseToa, pulsePowerSum, pulseSaturated, pulsePhaseSum});
+      }
+      else // Otherwise we're still measuring a pulse
+      {
+        pulsePowerSum += power[jj];
+        pulsePhaseSum += std::complex<double>(iq[jj]*std::conj((jj > 0) ? iq[jj-1] : previous));
+
+        if (std::abs(iq[jj].real()) >= sampMax || std::abs(iq[jj].imag()) >= sampMax)
+        {
+          pulseSaturated = true;
+        }
+      }
+    }
+  }
+}
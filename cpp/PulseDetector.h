@@ -0,0 +1,73 @@
+#ifndef PulseDetector_H
+#define PulseDetector_H
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <vector>
+
+struct DetectedPulse
+{
+  std::uint64_t toa;        // sample index of the leading edge
+  std::uint64_t numSamples; // number of samples from the leading edge up to the trailing edge
+  double powerSum;          // sum of |iq|^2 over the pulse
+  bool saturated;           // whether I or Q ever hit the saturation limit during the pulse
+  std::complex<double> phaseSum; // sum of iq[n]*conj(iq[n-1]) over the pulse, its angle is the mean phase step per sample
+};
+
+// Single pass leading/trailing edge detector that works on |iq|^2 against a
+// squared threshold so no square root is ever taken. Samples are processed in
+// fixed size chunks whose power, min/max and saturation reductions vectorize;
+// chunks that are entirely noise or entirely inside a pulse never fall back to
+// the scalar edge search. All of the state of a pulse in progress is kept
+// between calls, so a stream can be fed through in blocks of any size and
+// produce exactly the pulses a single pass over the whole stream would.
+class PulseDetector
+{
+public:
+  PulseDetector(const float sampMax);
+
+  // Forget any pulse in progress and restart sample numbering at zero
+  void reset();
+
+  // Hysteresis: a pulse ends once the power drops to ratio times the threshold
+  // that started it rather than the threshold itself, e.g. a ratio that puts
+  // the trailing edge 3 dB above the noise like the MATLAB create_pdws. 1, the
+  // default, uses the same threshold for both edges.
+  void setTrailingEdgeRatio(const float ratio) { trailingEdgeRatio = ratio; }
+
+  // Appends the pulses whose trailing edge falls in this block to pulses and
+  // returns how many were appended. A pulse still active at the end of the
+  // block carries over to the next call.
+  std::size_t process(const std::complex<float>* iq, const std::size_t numSamples, const float thresholdPower, std::vector<DetectedPulse> &pulses);
+
+  // Same as above with a threshold per sample, e.g. from a CfarDetector
+  std::size_t process(const std::complex<float>* iq, const std::size_t numSamples, const float* thresholdPower, std::vector<DetectedPulse> &pulses);
+
+  bool active() const { return pulseActive; }
+  std::uint64_t activePulseToa() const { return pulseToa; }
+  std::uint64_t samplesProcessed() const { return sampleIndex; }
+
+private:
+  static constexpr std::size_t CHUNK_SIZE = 64;
+  static constexpr std::size_t LANES = 8;
+
+  // Threshold is either a float or a per sample array, both indexed with []
+  template <typename Threshold>
+  std::size_t processBlock(const std::complex<float>* iq, const std::size_t numSamples, const Threshold &thresholdPower, std::vector<DetectedPulse> &pulses);
+
+  template <typename Threshold>
+  void scanChunk(const std::complex<float>* iq, const std::complex<float> previous, const float* power, const std::size_t numSamples, const Threshold &thresholdPower, std::vector<DetectedPulse> &pulses);
+
+  float sampMax;
+  float trailingEdgeRatio;
+  std::uint64_t sampleIndex; // index of the next sample to be processed
+  bool pulseActive;
+  std::uint64_t pulseToa;
+  double pulsePowerSum;
+  bool pulseSaturated;
+  std::complex<double> pulsePhaseSum;
+  std::complex<float> previousSample; // last sample of the previous block, so phase steps carry across blocks
+};
+
+#endif
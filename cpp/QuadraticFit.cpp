@@ -0,0 +1,188 @@
+#include "QuadraticFit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Dense>
+
+QuadraticFit::QuadraticFit()
+{
+  clear();
+}
+
+void QuadraticFit::add(const double t, const double v, const double w)
+{
+  if (w <= 0)
+  {
+    return;
+  }
+
+  if (count == 0)
+  {
+    origin = t;
+  }
+
+  count++;
+
+  // Merge the point into the moments about the mean as it moves to take the
+  // point in (Pebay's pairwise update, with the point as a set of weight w)
+  const double total = sw + w;
+  const double delta = (t - origin) - mean;
+  const double shift = delta*w/total;
+  const double delta2 = delta*delta;
+
+  m[2] += delta2*delta2*sw*w*(sw*sw - sw*w + w*w)/(total*total*total) + 6*delta2*w*w*m[0]/(total*total) - 4*delta*w*m[1]/total;
+  m[1] += delta2*delta*sw*w*(sw - w)/(total*total) - 3*delta*w*m[0]/total;
+  m[0] += delta2*sw*w/total;
+
+  // The same for the sums with v: move the old ones to the new mean, then
+  // add the point about it
+  const double u = delta - shift;
+
+  sv[2] += -2*shift*sv[1] + shift*shift*sv[0] + w*u*u*v;
+  sv[1] += -shift*sv[0] + w*u*v;
+  sv[0] += w*v;
+
+  mean += shift;
+  sw = total;
+}
+
+void QuadraticFit::clear()
+{
+  count = 0;
+  origin = 0;
+  sw = 0;
+  mean = 0;
+
+  for (double &s : m)
+  {
+    s = 0;
+  }
+
+  for (double &s : sv)
+  {
+    s = 0;
+  }
+}
+
+bool QuadraticFit::solveCentered(double c[3], double &meanTime) const
+{
+  if (count < 3 || sw <= 0)
+  {
+    return false;
+  }
+
+  // The normal equations in u = x - mean, whose first moment is 0
+  Eigen::Matrix3d A;
+  A << sw, 0, m[0],
+       0, m[0], m[1],
+       m[0], m[1], m[2];
+
+  const Eigen::Vector3d b(sv[0], sv[1], sv[2]);
+
+  const Eigen::LDLT<Eigen::Matrix3d> ldlt(A);
+
+  if (ldlt.info() != Eigen::Success || ldlt.rcond() < std::numeric_limits<double>::epsilon())
+  {
+    return false;
+  }
+
+  const Eigen::Vector3d x = ldlt.solve(b);
+
+  c[0] = x[0];
+  c[1] = x[1];
+  c[2] = x[2];
+  meanTime = origin + mean;
+
+  return true;
+}
+
+bool QuadraticFit::solve(double p[3]) const
+{
+  double c[3];
+  double meanTime;
+
+  if (!solveCentered(c, meanTime))
+  {
+    return false;
+  }
+
+  // Expand c0 + c1*(t-meanTime) + c2*(t-meanTime)^2 back to powers of t
+  p[0] = c[0] - c[1]*meanTime + c[2]*meanTime*meanTime;
+  p[1] = c[1] - 2*c[2]*meanTime;
+  p[2] = c[2];
+
+  return true;
+}
+
+double QuadraticFit::peakTime() const
+{
+  double c[3];
+  double meanTime;
+
+  if (!solveCentered(c, meanTime) || c[2] == 0)
+  {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  return meanTime - c[1]/(2*c[2]);
+}
+
+QuadraticFit QuadraticFit::robustFit(const std::vector<double> &t, const std::vector<double> &v, const std::size_t iterations, const double rejectSigma)
+{
+  // Scales the median absolute residual to a standard deviation for
+  // normally distributed residuals
+  const double MAD_TO_SIGMA = 1.4826;
+
+  const std::size_t n = std::min(t.size(), v.size());
+  std::vector<double> residuals(n);
+  QuadraticFit fit;
+
+  for (std::size_t ii = 0; ii < n; ii++)
+  {
+    fit.add(t[ii], v[ii]);
+  }
+
+  for (std::size_t iter = 0; iter < iterations; iter++)
+  {
+    double c[3];
+    double meanTime;
+
+    if (!fit.solveCentered(c, meanTime))
+    {
+      break;
+    }
+
+    for (std::size_t ii = 0; ii < n; ii++)
+    {
+      const double u = t[ii] - meanTime;
+      residuals[ii] = std::abs(v[ii] - (c[0] + c[1]*u + c[2]*u*u));
+    }
+
+    std::vector<double> sorted = residuals;
+    std::nth_element(sorted.begin(), sorted.begin() + n/2, sorted.end());
+
+    const double limit = rejectSigma*MAD_TO_SIGMA*sorted[n/2];
+
+    QuadraticFit refit;
+
+    for (std::size_t ii = 0; ii < n; ii++)
+    {
+      if (residuals[ii] <= limit)
+      {
+        refit.add(t[ii], v[ii]);
+      }
+    }
+
+    // Stop once nothing else gets rejected, or if too few points would remain
+    if (refit.size() < 3 || refit.size() == fit.size())
+    {
+      break;
+    }
+
+    fit = refit;
+  }
+
+  return fit;
+}
@@ -0,0 +1,50 @@
+#ifndef QuadraticFit_H
+#define QuadraticFit_H
+
+#include <cstddef>
+#include <vector>
+
+// Least squares fit of v = p0 + p1*t + p2*t^2 that accumulates the moments of
+// t and t*v as points stream in, so fitting costs O(1) memory and no matrix
+// allocation. The moments are kept about the running weighted mean time and
+// updated as it moves, so they never hold the large powers of t whose
+// differences the normal equations would otherwise be built from. Times are
+// taken relative to the first point as well, for when t is an absolute UTC
+// time.
+class QuadraticFit
+{
+public:
+  QuadraticFit();
+
+  // Points without a positive weight are ignored
+  void add(const double t, const double v, const double w = 1.0);
+  void clear();
+
+  std::size_t size() const { return count; }
+
+  // Coefficients of the fit in absolute time (p[0] + p[1]*t + p[2]*t^2),
+  // returns false if there aren't enough distinct points to solve
+  bool solve(double p[3]) const;
+
+  // Time of the vertex of the parabola, NaN if the fit can't be solved
+  double peakTime() const;
+
+  // Fit all the points, then refit without those whose residual is more
+  // than rejectSigma times the spread of the residuals, taken from their
+  // median absolute value so the outliers don't inflate it, until nothing
+  // more is rejected or iterations run out
+  static QuadraticFit robustFit(const std::vector<double> &t, const std::vector<double> &v, const std::size_t iterations = 3, const double rejectSigma = 3.0);
+
+private:
+  // Solve for the coefficients in powers of t - meanTime, the weighted mean
+  bool solveCentered(double c[3], double &meanTime) const;
+
+  std::size_t count; // of points with positive weight
+  double origin;
+  double sw;    // sum of w
+  double mean;  // weighted mean of x = t - origin
+  double m[3];  // sum of w*u^k for k = 2..4, u = x - mean
+  double sv[3]; // sum of w*u^k*v for k = 0..2
+};
+
+#endif
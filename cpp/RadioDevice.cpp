@@ -0,0 +1,26 @@
+#include "RadioDevice.h"
+#include "BladeRfDevice.h"
+#include "UsrpDevice.h"
+
+#include <iostream>
+
+std::unique_ptr<RadioDevice> makeRadioDevice(const std::string &spec, const std::string &fpgaPath)
+{
+  const std::string name = spec.substr(0, spec.find('@'));
+  const std::size_t colon = name.find(':');
+  const std::string type = name.substr(0, colon);
+  const std::string args = (colon == std::string::npos) ? "" : name.substr(colon + 1);
+
+  if (type == "blade")
+  {
+    return std::make_unique<BladeRfDevice>(args, fpgaPath);
+  }
+  else if (type == "usrp")
+  {
+    return std::make_unique<UsrpDevice>(args);
+  }
+
+  std::cout << "Unknown device type in " << spec << std::endl;
+
+  return nullptr;
+}
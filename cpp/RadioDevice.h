@@ -0,0 +1,64 @@
+#ifndef RadioDevice_H
+#define RadioDevice_H
+
+#include "IqPacket.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <memory>
+#include <string>
+
+struct RadioSettings
+{
+  std::uint64_t frequencyHz;
+  std::uint32_t bandwidthHz;
+  std::uint32_t sampleRateSps;
+  float rxGainDb;
+};
+
+// What a recorder needs from a radio, whatever make it is, so one process can
+// drive several bladeRFs and USRPs side by side. Every device hands out 16-bit
+// samples and keeps its own clock mapped onto UTC seconds, either from the
+// host clock or from a PPS edge, so dwells asked for at the same UTC time on
+// different devices start together. Calls return 0 on success and otherwise
+// the line that failed, like main() does, having printed why.
+class RadioDevice
+{
+public:
+  virtual ~RadioDevice() {}
+
+  virtual int open() = 0;
+
+  // Tunes the device and fills in the device and settings fields of packet
+  // with what was actually set
+  virtual int configure(const RadioSettings &settings, IqPacket &packet) = 0;
+
+  // Maps the device clock onto UTC. With usePps the mapping is latched on
+  // the next PPS edge, where the device has a PPS input.
+  virtual int syncTime(const bool usePps) = 0;
+
+  // Measures how far the device's UTC is from the host clock (device minus
+  // host, sec). A device whose clock is only mapped from the host clock is
+  // mapped again from here on, so its drift since the last call is taken
+  // out; one with a clock of its own is only measured.
+  virtual int trackHostClock(double &driftSec) = 0;
+
+  virtual int start() = 0;
+  virtual void stop() = 0;
+
+  // Receives numSamples samples starting at UTC time startTimeSecs, which
+  // has to be far enough in the future for the request to reach the device.
+  // Returns the number of samples received and sets the UTC time of the first.
+  virtual std::size_t receive(std::complex<std::int16_t>* iq, const std::size_t numSamples, const double startTimeSecs, double &sampleStartTime, bool &overrun) = 0;
+
+  // Current device time in UTC seconds
+  virtual double timeNow() = 0;
+};
+
+// Device specs are <blade|usrp>[:<serial or UHD args>][@<freqMhz>]. Returns
+// nullptr, having printed why, if the spec doesn't name a kind of device. A
+// bladeRF is given fpgaPath to load if its FPGA isn't configured yet.
+std::unique_ptr<RadioDevice> makeRadioDevice(const std::string &spec, const std::string &fpgaPath = "");
+
+#endif
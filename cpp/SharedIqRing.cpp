@@ -0,0 +1,290 @@
+#include "SharedIqRing.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+
+namespace
+{
+  const std::size_t SLOT_ALIGNMENT = 64;
+
+  // shm_open wants a name starting with a slash
+  std::string shmName(const std::string &name)
+  {
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+  }
+
+  std::uint64_t roundUp(const std::uint64_t bytes, const std::uint64_t alignment)
+  {
+    return (bytes + alignment - 1)/alignment*alignment;
+  }
+}
+
+SharedIqRingWriter::SharedIqRingWriter() : header(nullptr), mappedBytes(0), nextSequence(0)
+{
+}
+
+SharedIqRingWriter::~SharedIqRingWriter()
+{
+  close();
+}
+
+bool SharedIqRingWriter::create(const std::string &name, const std::uint32_t numSlots, const std::uint32_t slotBytes)
+{
+  close();
+
+  this->name = shmName(name);
+
+  const std::uint64_t slotStride = roundUp(sizeof(SharedIqSlotHeader) + slotBytes, SLOT_ALIGNMENT);
+  const std::uint64_t headerBytes = roundUp(sizeof(SharedIqRingHeader), SLOT_ALIGNMENT);
+
+  mappedBytes = headerBytes + numSlots*slotStride;
+
+  // Replace any ring left behind rather than inherit its size and contents
+  shm_unlink(this->name.c_str());
+
+  const int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+  if (fd < 0 || ftruncate(fd, mappedBytes) != 0)
+  {
+    std::cout << "Failed to create shared memory " << this->name << ": " << strerror(errno) << std::endl;
+
+    if (fd >= 0)
+    {
+      ::close(fd);
+      shm_unlink(this->name.c_str());
+    }
+
+    return false;
+  }
+
+  const int error = posix_fallocate(fd, 0, mappedBytes);
+
+  if (error != 0)
+  {
+    std::cout << "Failed to reserve " << mappedBytes/(1024*1024) << " MB of shared memory for " << this->name << ": " << strerror(error) << std::endl;
+    ::close(fd);
+    shm_unlink(this->name.c_str());
+    return false;
+  }
+
+  void* mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (mapped == MAP_FAILED)
+  {
+    std::cout << "Failed to map shared memory " << this->name << ": " << strerror(errno) << std::endl;
+    shm_unlink(this->name.c_str());
+    return false;
+  }
+
+  // The file starts out zeroed, so every slot's sequence word already says
+  // it holds no block. The magic goes in last so a reader never sees a ring
+  // that's only half set up.
+  header = new (mapped) SharedIqRingHeader;
+  header->version = SHARED_IQ_RING_FORMAT;
+  header->numSlots = numSlots;
+  header->slotBytes = slotBytes;
+  header->slotStride = slotStride;
+  header->published.store(0, std::memory_order_relaxed);
+
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SHARED_IQ_RING_MAGIC;
+
+  nextSequence = 0;
+
+  return true;
+}
+
+std::uint32_t SharedIqRingWriter::slotsForDwells(const std::uint64_t channelBytes, const std::uint32_t numChannels, const std::uint32_t numDwells, const std::uint32_t slotBytes)
+{
+  // Each channel starts on a slot of its own
+  const std::uint64_t slotsPerChannel = (channelBytes + slotBytes - 1)/slotBytes;
+
+  return std::max<std::uint64_t>(SHARED_IQ_RING_SLOTS, slotsPerChannel*numChannels*numDwells);
+}
+
+void SharedIqRingWriter::close()
+{
+  if (header != nullptr)
+  {
+    // Readers that still have it mapped keep reading what's there
+    munmap(header, mappedBytes);
+    shm_unlink(name.c_str());
+    header = nullptr;
+  }
+}
+
+SharedIqSlotHeader* SharedIqRingWriter::slot(const std::uint64_t sequence)
+{
+  const std::uint64_t headerBytes = roundUp(sizeof(SharedIqRingHeader), SLOT_ALIGNMENT);
+
+  return reinterpret_cast<SharedIqSlotHeader*>(reinterpret_cast<std::uint8_t*>(header) + headerBytes + (sequence % header->numSlots)*header->slotStride);
+}
+
+void* SharedIqRingWriter::beginBlock()
+{
+  SharedIqSlotHeader* s = slot(nextSequence);
+
+  // Odd while being written, and readers holding the old block see it change
+  s->sequence.store(2*nextSequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  return s + 1;
+}
+
+void SharedIqRingWriter::commitBlock(const IqPacket &packet, const std::uint32_t numSamples)
+{
+  SharedIqSlotHeader* s = slot(nextSequence);
+
+  s->packet = packet;
+  s->packet.numSamples = numSamples;
+
+  s->sequence.store(2*nextSequence + 2, std::memory_order_release);
+
+  nextSequence++;
+  header->published.store(nextSequence, std::memory_order_release);
+}
+
+void SharedIqRingWriter::publish(const IqPacket &packet, const void* iq, const std::uint64_t numSamples, const std::uint32_t channel)
+{
+  const std::size_t sampleBytes = sharedIqSampleBytes(packet);
+  const std::uint64_t samplesPerBlock = header->slotBytes/sampleBytes;
+  const std::uint8_t* samples = static_cast<const std::uint8_t*>(iq);
+
+  IqPacket blockPacket = packet;
+  blockPacket.spare0 = channel;
+
+  for (std::uint64_t offset = 0; offset < numSamples; offset += samplesPerBlock)
+  {
+    const std::uint32_t count = std::min(samplesPerBlock, numSamples - offset);
+
+    std::memcpy(beginBlock(), &samples[offset*sampleBytes], count*sampleBytes);
+
+    blockPacket.sampleStartTime = packet.sampleStartTime + offset*1.0/packet.sampleRateSps;
+    commitBlock(blockPacket, count);
+  }
+}
+
+SharedIqRingReader::SharedIqRingReader() : header(nullptr), mappedBytes(0), nextSequence(0), numDropped(0)
+{
+}
+
+SharedIqRingReader::~SharedIqRingReader()
+{
+  close();
+}
+
+bool SharedIqRingReader::open(const std::string &name)
+{
+  close();
+
+  const std::string fullName = shmName(name);
+  const int fd = shm_open(fullName.c_str(), O_RDONLY, 0);
+  struct stat info;
+
+  if (fd < 0 || fstat(fd, &info) != 0)
+  {
+    std::cout << "Failed to open shared memory " << fullName << ": " << strerror(errno) << std::endl;
+
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+
+    return false;
+  }
+
+  mappedBytes = info.st_size;
+
+  void* mapped = (mappedBytes >= sizeof(SharedIqRingHeader)) ? mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+
+  if (mapped == MAP_FAILED)
+  {
+    std::cout << "Failed to map shared memory " << fullName << std::endl;
+    return false;
+  }
+
+  header = static_cast<const SharedIqRingHeader*>(mapped);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  if (header->magic != SHARED_IQ_RING_MAGIC || header->version != SHARED_IQ_RING_FORMAT || header->slotStride*header->numSlots > mappedBytes)
+  {
+    std::cout << fullName << " isn't an I/Q ring this reader understands" << std::endl;
+    close();
+    return false;
+  }
+
+  // Only blocks from now on, whatever's in the ring is old news
+  nextSequence = header->published.load(std::memory_order_acquire);
+  numDropped = 0;
+
+  return true;
+}
+
+void SharedIqRingReader::close()
+{
+  if (header != nullptr)
+  {
+    munmap(const_cast<SharedIqRingHeader*>(header), mappedBytes);
+    header = nullptr;
+  }
+}
+
+const SharedIqSlotHeader* SharedIqRingReader::slot(const std::uint64_t sequence) const
+{
+  const std::uint64_t headerBytes = roundUp(sizeof(SharedIqRingHeader), SLOT_ALIGNMENT);
+
+  return reinterpret_cast<const SharedIqSlotHeader*>(reinterpret_cast<const std::uint8_t*>(header) + headerBytes + (sequence % header->numSlots)*header->slotStride);
+}
+
+bool SharedIqRingReader::next(SharedIqBlock &block)
+{
+  const std::uint64_t published = header->published.load(std::memory_order_acquire);
+
+  // The oldest slot is the one the writer fills next, so it doesn't count
+  const std::uint64_t oldest = (published >= header->numSlots) ? published - header->numSlots + 1 : 0;
+
+  if (nextSequence < oldest)
+  {
+    numDropped += oldest - nextSequence;
+    nextSequence = oldest;
+  }
+
+  while (nextSequence < published)
+  {
+    const std::uint64_t sequence = nextSequence++;
+    const SharedIqSlotHeader* s = slot(sequence);
+
+    if (s->sequence.load(std::memory_order_acquire) == 2*sequence + 2)
+    {
+      block.sequence = sequence;
+      block.packet = &s->packet;
+      block.iq = s + 1;
+
+      return true;
+    }
+
+    // Lapped between reading published and getting here
+    numDropped++;
+  }
+
+  return false;
+}
+
+bool SharedIqRingReader::valid(const SharedIqBlock &block) const
+{
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return slot(block.sequence)->sequence.load(std::memory_order_relaxed) == 2*block.sequence + 2;
+}
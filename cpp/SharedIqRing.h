@@ -0,0 +1,136 @@
+#ifndef SharedIqRing_H
+#define SharedIqRing_H
+
+#include "IqPacket.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Live I/Q published through POSIX shared memory so any number of local
+// processes can follow a recorder without going through files or owning the
+// device. The memory is a ring of fixed-size slots, each holding one block of
+// samples behind an IqPacket describing it. Every block gets the next sequence
+// number and each slot has a seqlock: its sequence word is odd while the
+// writer fills it and 2*(block sequence + 1) once the block is complete.
+// Readers look at the samples in place and afterwards check the sequence word
+// again, so a reader that has been lapped by the writer finds out instead of
+// stalling it. The writer never waits for anyone.
+//
+//   SharedIqRingHeader
+//   SharedIqSlotHeader, samples, padding    (numSlots times)
+//
+// In a block's IqPacket numSamples is the samples in that block and spare0 is
+// the RX channel it came from. Samples are complex int8 if bitWidth <= 8 and
+// complex int16 otherwise.
+
+#define SHARED_IQ_RING_MAGIC 0x51524953 // "SIRQ"
+#define SHARED_IQ_RING_FORMAT 1
+
+const std::uint32_t SHARED_IQ_RING_SLOTS = 512;
+const std::uint32_t SHARED_IQ_SLOT_BYTES = 256*1024;
+
+struct SharedIqRingHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t numSlots;
+  std::uint32_t slotBytes;  // room for samples in each slot
+  std::uint64_t slotStride; // bytes from one slot header to the next
+  alignas(64) std::atomic<std::uint64_t> published; // blocks completed so far
+};
+
+struct SharedIqSlotHeader
+{
+  std::atomic<std::uint64_t> sequence;
+  std::uint64_t spare0;
+  IqPacket packet;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory needs lock free 64-bit atomics");
+
+class SharedIqRingWriter
+{
+public:
+  SharedIqRingWriter();
+  ~SharedIqRingWriter();
+
+  // Creates, or replaces, the ring called name in /dev/shm. All of it is
+  // reserved up front, so a /dev/shm too small for it fails here rather than
+  // with a SIGBUS mid-dwell.
+  bool create(const std::string &name, const std::uint32_t numSlots = SHARED_IQ_RING_SLOTS, const std::uint32_t slotBytes = SHARED_IQ_SLOT_BYTES);
+
+  // Slots of slotBytes a ring needs to hold the last numDwells dwells whole,
+  // each published as numChannels channels of channelBytes, and never fewer
+  // than SHARED_IQ_RING_SLOTS. A dwell longer than the ring would overwrite
+  // its own start before a reader got to it.
+  static std::uint32_t slotsForDwells(const std::uint64_t channelBytes, const std::uint32_t numChannels, const std::uint32_t numDwells = 2, const std::uint32_t slotBytes = SHARED_IQ_SLOT_BYTES);
+  bool isOpen() const { return header != nullptr; }
+  void close();
+
+  // Zero copy: fill the samples of the next slot, then commit them. The slot
+  // is marked as being written until committed.
+  void* beginBlock();
+  void commitBlock(const IqPacket &packet, const std::uint32_t numSamples);
+
+  // Copies a dwell in as many blocks as it takes, each with the packet's
+  // start time moved on to its first sample
+  void publish(const IqPacket &packet, const void* iq, const std::uint64_t numSamples, const std::uint32_t channel = 0);
+
+  std::uint32_t slotBytes() const { return header->slotBytes; }
+
+private:
+  SharedIqSlotHeader* slot(const std::uint64_t sequence);
+
+  std::string name;
+  SharedIqRingHeader* header;
+  std::size_t mappedBytes;
+  std::uint64_t nextSequence;
+};
+
+// A block as it sits in the ring. Only good until valid() says otherwise.
+struct SharedIqBlock
+{
+  std::uint64_t sequence;
+  const IqPacket* packet;
+  const void* iq;
+};
+
+class SharedIqRingReader
+{
+public:
+  SharedIqRingReader();
+  ~SharedIqRingReader();
+
+  // Starts at the newest complete block
+  bool open(const std::string &name);
+  bool isOpen() const { return header != nullptr; }
+  void close();
+
+  // Returns false if there's no new block yet. Blocks overwritten before
+  // they could be read are skipped and counted as dropped.
+  bool next(SharedIqBlock &block);
+
+  // Whether the block is still intact, i.e. the writer hasn't started to
+  // overwrite it. Check after using the samples; if it's false they were torn.
+  bool valid(const SharedIqBlock &block) const;
+
+  std::uint64_t dropped() const { return numDropped; }
+
+private:
+  const SharedIqSlotHeader* slot(const std::uint64_t sequence) const;
+
+  const SharedIqRingHeader* header;
+  std::size_t mappedBytes;
+  std::uint64_t nextSequence;
+  std::uint64_t numDropped;
+};
+
+// Bytes per complex sample of a block
+inline std::size_t sharedIqSampleBytes(const IqPacket &packet)
+{
+  return (packet.bitWidth <= 8) ? 2 : 4;
+}
+
+#endif
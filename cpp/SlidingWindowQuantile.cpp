@@ -0,0 +1,100 @@
+#include "SlidingWindowQuantile.h"
+
+#include <algorithm>
+#include <iterator>
+
+SlidingWindowQuantile::SlidingWindowQuantile(const std::size_t windowLength, const double quantile) :
+  windowLength(std::max<std::size_t>(windowLength, 1)),
+  quantile(std::clamp(quantile, 0.0, 1.0))
+{
+}
+
+void SlidingWindowQuantile::push(const double value)
+{
+  fifo.push_back(value);
+  insert(value);
+
+  if (fifo.size() > windowLength)
+  {
+    erase(fifo.front());
+    fifo.pop_front();
+  }
+}
+
+void SlidingWindowQuantile::insert(const double value)
+{
+  if (!low.empty() && value <= *low.rbegin())
+  {
+    low.insert(value);
+  }
+  else
+  {
+    high.insert(value);
+  }
+
+  rebalance();
+}
+
+void SlidingWindowQuantile::erase(const double value)
+{
+  if (!low.empty() && value <= *low.rbegin())
+  {
+    const auto it = low.find(value);
+
+    if (it != low.end())
+    {
+      low.erase(it);
+    }
+  }
+  else
+  {
+    const auto it = high.find(value);
+
+    if (it != high.end())
+    {
+      high.erase(it);
+    }
+  }
+
+  rebalance();
+}
+
+double SlidingWindowQuantile::value() const
+{
+  return low.empty() ? 0.0 : *low.rbegin();
+}
+
+void SlidingWindowQuantile::clear()
+{
+  fifo.clear();
+  low.clear();
+  high.clear();
+}
+
+void SlidingWindowQuantile::rebalance()
+{
+  const std::size_t n = size();
+
+  if (n == 0)
+  {
+    return;
+  }
+
+  // Same rank convention as sorting the window and indexing element q*n
+  const std::size_t rank = std::min<std::size_t>(static_cast<std::size_t>(quantile*n), n-1);
+  const std::size_t lowSize = rank + 1;
+
+  while (low.size() > lowSize)
+  {
+    const auto it = std::prev(low.end());
+    high.insert(*it);
+    low.erase(it);
+  }
+
+  while (low.size() < lowSize && !high.empty())
+  {
+    const auto it = high.begin();
+    low.insert(*it);
+    high.erase(it);
+  }
+}
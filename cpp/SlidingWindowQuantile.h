@@ -0,0 +1,39 @@
+#ifndef SlidingWindowQuantile_H
+#define SlidingWindowQuantile_H
+
+#include <cstddef>
+#include <deque>
+#include <set>
+
+// Tracks a quantile (e.g. the median) of the most recent windowLength values
+// using two ordered multisets split at the quantile rank. Each insertion or
+// eviction costs O(log n) instead of re-sorting the whole window.
+class SlidingWindowQuantile
+{
+public:
+  SlidingWindowQuantile(const std::size_t windowLength, const double quantile = 0.5);
+
+  // Append a value and evict the oldest one once the window is full
+  void push(const double value);
+
+  // Insert or remove an arbitrary value without touching the FIFO order. These
+  // are used by callers that manage their own window (e.g. a CFAR reference window).
+  void insert(const double value);
+  void erase(const double value);
+
+  double value() const;
+  std::size_t size() const { return low.size() + high.size(); }
+  bool empty() const { return size() == 0; }
+  void clear();
+
+private:
+  void rebalance();
+
+  std::size_t windowLength;
+  double quantile;
+  std::deque<double> fifo;
+  std::multiset<double> low;  // values at or below the quantile, value() is its largest element
+  std::multiset<double> high; // values above the quantile
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "StreamingPdwExtractor.h"
+
+#include <algorithm>
+#include <cmath>
+
+StreamingPdwExtractor::StreamingPdwExtractor(const double sampleRateSps, const double centerFrequencyHz, const float sampMax, const std::uint16_t bin) :
+  sampleRateSps(sampleRateSps),
+  centerFrequencyHz(centerFrequencyHz),
+  bin(bin),
+  detector(sampMax),
+  analyzer(sampleRateSps),
+  maxPulseSamples(0)
+{
+  reset();
+}
+
+void StreamingPdwExtractor::reset()
+{
+  detector.reset();
+  pulses.clear();
+  detecting = false;
+  streamStartTime = 0;
+  detectorStartIndex = 0;
+  heldSamples.clear();
+  heldStartIndex = 0;
+}
+
+void StreamingPdwExtractor::enableIntrapulseAnalysis(const std::size_t maxPulseSamples)
+{
+  this->maxPulseSamples = maxPulseSamples;
+  heldSamples.reserve(maxPulseSamples);
+}
+
+std::size_t StreamingPdwExtractor::process(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex, const float thresholdPower, const float noiseFloor, std::vector<Pdw> &pdws)
+{
+  startBlock(blockStartIndex);
+
+  const std::uint64_t detectorIndex = detector.samplesProcessed();
+  detector.process(iq, numSamples, thresholdPower, pulses);
+
+  const std::size_t numPdws = makePdws(iq, numSamples, detectorIndex, noiseFloor, pdws);
+  holdPulseSamples(iq, numSamples, detectorIndex);
+
+  return numPdws;
+}
+
+std::size_t StreamingPdwExtractor::process(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex, const float* thresholdPower, const float noiseFloor, std::vector<Pdw> &pdws)
+{
+  startBlock(blockStartIndex);
+
+  const std::uint64_t detectorIndex = detector.samplesProcessed();
+  detector.process(iq, numSamples, thresholdPower, pulses);
+
+  const std::size_t numPdws = makePdws(iq, numSamples, detectorIndex, noiseFloor, pdws);
+  holdPulseSamples(iq, numSamples, detectorIndex);
+
+  return numPdws;
+}
+
+void StreamingPdwExtractor::startStream(const double startTime)
+{
+  detecting = false;
+  streamStartTime = startTime;
+}
+
+void StreamingPdwExtractor::startBlock(const std::uint64_t blockStartIndex)
+{
+  if (!detecting || blockStartIndex != detectorStartIndex + detector.samplesProcessed())
+  {
+    detector.reset();
+    heldSamples.clear();
+    detecting = true;
+    detectorStartIndex = blockStartIndex;
+  }
+
+  pulses.clear();
+}
+
+std::size_t StreamingPdwExtractor::makePdws(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex, const float noiseFloor, std::vector<Pdw> &pdws)
+{
+  for (const DetectedPulse &pulse : pulses)
+  {
+    Pdw pdw;
+
+    // compute the time of arrival of the pulse from the epoch
+    pdw.toa = streamStartTime + (detectorStartIndex + pulse.toa)/sampleRateSps;
+
+    // compute the pulse width as the number of samples this pulse was active
+    // for divided by the sampling rate
+    pdw.pwSec = pulse.numSamples/sampleRateSps;
+
+    // compute the amplitude as the RMS magnitude over the entire pulse
+    pdw.amp = std::sqrt(pulse.powerSum/pulse.numSamples);
+
+    // compute the SNR for this pulse given the amplitude and noise floor
+    pdw.snrDb = 10*std::log10(pdw.amp/noiseFloor);
+
+    // compute the frequency from the mean phase step over the pulse and
+    // offset it from the center frequency
+    pdw.freqHz = centerFrequencyHz + std::arg(pulse.phaseSum)*sampleRateSps/(2*M_PI);
+
+    pdw.saturated = pulse.saturated;
+    pdw.bin = bin;
+    pdw.chirpRateHzPerSec = 0;
+    pdw.modulation = PulseModulation::Unmodulated;
+    pdw.numChips = 0;
+
+    if (maxPulseSamples > 0)
+    {
+      const std::size_t length = std::min<std::uint64_t>(pulse.numSamples, maxPulseSamples);
+      const std::complex<float>* samples = nullptr;
+
+      if (pulse.toa >= blockStartIndex)
+      {
+        samples = &iq[pulse.toa - blockStartIndex];
+      }
+      else if (heldStartIndex == pulse.toa)
+      {
+        // The pulse started in an earlier block so stitch its held samples
+        // to the ones in this block
+        const std::size_t fromBlock = std::min<std::size_t>(length - std::min(length, heldSamples.size()), numSamples);
+
+        pulseSamples.assign(heldSamples.begin(), heldSamples.begin() + std::min(length, heldSamples.size()));
+        pulseSamples.insert(pulseSamples.end(), iq, iq + fromBlock);
+        samples = pulseSamples.data();
+      }
+
+      if (samples != nullptr)
+      {
+        const IntrapulseFeatures features = analyzer.analyze(samples, length);
+
+        pdw.freqHz = centerFrequencyHz + features.freqOffsetHz;
+        pdw.chirpRateHzPerSec = features.chirpRateHzPerSec;
+        pdw.modulation = features.modulation;
+        pdw.numChips = std::min<std::uint16_t>(features.numChips, 255);
+      }
+    }
+
+    pdws.push_back(pdw);
+  }
+
+  return pulses.size();
+}
+
+void StreamingPdwExtractor::holdPulseSamples(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex)
+{
+  if (maxPulseSamples == 0 || !detector.active())
+  {
+    heldSamples.clear();
+    return;
+  }
+
+  const std::uint64_t pulseToa = detector.activePulseToa();
+
+  if (pulseToa >= blockStartIndex)
+  {
+    // The pulse started in this block
+    const std::size_t offset = pulseToa - blockStartIndex;
+
+    heldSamples.assign(&iq[offset], &iq[offset] + std::min(numSamples - offset, maxPulseSamples));
+    heldStartIndex = pulseToa;
+  }
+  else if (heldStartIndex == pulseToa)
+  {
+    // The pulse spans this whole block
+    const std::size_t room = maxPulseSamples - heldSamples.size();
+
+    heldSamples.insert(heldSamples.end(), iq, iq + std::min(numSamples, room));
+  }
+}
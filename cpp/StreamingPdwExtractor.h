@@ -0,0 +1,73 @@
+#ifndef StreamingPdwExtractor_H
+#define StreamingPdwExtractor_H
+
+#include "Pdw.h"
+#include "PulseDetector.h"
+#include "IntrapulseAnalyzer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <complex>
+#include <vector>
+
+// Turns a continuous I/Q stream into PDWs one block at a time. The edge
+// detector state, the partial power sum and the phase history of a pulse in
+// progress all carry over from one block to the next, so a pulse straddling
+// two blocks comes out as one PDW and any block size gives exactly the PDWs a
+// single pass over the whole recording would. Blocks are placed by their
+// sample index in the stream, so whether one picks up where the last left off
+// is exact; one that doesn't drops the pulse in progress. TOAs are seconds
+// from the caller's epoch rather than absolute UTC, where a double's 238 ns
+// steps would swamp the PRI of a pulse train.
+class StreamingPdwExtractor
+{
+public:
+  StreamingPdwExtractor(const double sampleRateSps, const double centerFrequencyHz, const float sampMax, const std::uint16_t bin = 0);
+
+  void reset();
+
+  // Measure the frequency, chirp rate and phase coding of each pulse from
+  // its samples rather than just taking the mean phase step. The samples of a
+  // pulse still in progress at the end of a block are held until it ends, up
+  // to maxPulseSamples of them; longer pulses are analyzed from their start.
+  void enableIntrapulseAnalysis(const std::size_t maxPulseSamples);
+
+  // See PulseDetector::setTrailingEdgeRatio
+  void setTrailingEdgeRatio(const float ratio) { detector.setTrailingEdgeRatio(ratio); }
+
+  // Start a new stream, e.g. the next dwell, whose sample 0 is startTime
+  // seconds from the epoch. Any pulse in progress is dropped.
+  void startStream(const double startTime);
+
+  // iq[0] is sample blockStartIndex of the stream and noiseFloor the
+  // magnitude the SNR of each pulse is measured against. PDWs of the pulses
+  // that end in this block are appended to pdws and the number appended is
+  // returned.
+  std::size_t process(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex, const float thresholdPower, const float noiseFloor, std::vector<Pdw> &pdws);
+  std::size_t process(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex, const float* thresholdPower, const float noiseFloor, std::vector<Pdw> &pdws);
+
+  bool pulseInProgress() const { return detector.active(); }
+
+private:
+  void startBlock(const std::uint64_t blockStartIndex);
+  std::size_t makePdws(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex, const float noiseFloor, std::vector<Pdw> &pdws);
+  void holdPulseSamples(const std::complex<float>* iq, const std::size_t numSamples, const std::uint64_t blockStartIndex);
+
+  double sampleRateSps;
+  double centerFrequencyHz;
+  std::uint16_t bin;
+
+  PulseDetector detector;
+  std::vector<DetectedPulse> pulses;
+  bool detecting;                   // false until a block of the current stream has been seen
+  double streamStartTime;           // of sample 0 of the stream, in seconds from the epoch
+  std::uint64_t detectorStartIndex; // stream index of the detector's sample 0
+
+  IntrapulseAnalyzer analyzer;
+  std::size_t maxPulseSamples; // 0 when intrapulse analysis is off
+  std::vector<std::complex<float>> heldSamples; // samples of the pulse in progress from earlier blocks
+  std::uint64_t heldStartIndex;                 // stream index of heldSamples[0]
+  std::vector<std::complex<float>> pulseSamples;
+};
+
+#endif
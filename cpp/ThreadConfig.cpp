@@ -0,0 +1,263 @@
+#include "ThreadConfig.h"
+#include "Helper.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+  // Set by parseThreadConfig() for applyBackgroundPlacement()
+  ThreadPlacement backgroundPlacement;
+
+  // 2,3,5 for single CPUs and 4-7 for runs of them
+  std::string cpuListStr(const std::vector<int> &cpus)
+  {
+    std::ostringstream str;
+
+    for (std::size_t ii = 0; ii < cpus.size(); ii++)
+    {
+      std::size_t last = ii;
+
+      while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1)
+      {
+        last++;
+      }
+
+      str << ((ii > 0) ? "," : "") << cpus[ii];
+
+      if (last > ii)
+      {
+        str << "-" << cpus[last];
+      }
+
+      ii = last;
+    }
+
+    return str.str();
+  }
+
+  void reportPlacement(const char* role, const ThreadPlacement &placement)
+  {
+    std::cout << role << " threads: " << (placement.cpus.empty() ? "any CPU" : "CPUs " + cpuListStr(placement.cpus));
+
+    if (placement.priority > 0)
+    {
+      std::cout << ", SCHED_FIFO priority " << placement.priority << std::endl;
+    }
+    else
+    {
+      std::cout << ", SCHED_OTHER" << std::endl;
+    }
+  }
+
+  bool sharesCpus(const ThreadPlacement &a, const ThreadPlacement &b)
+  {
+    for (const int cpu : a.cpus)
+    {
+      if (std::find(b.cpus.begin(), b.cpus.end(), cpu) != b.cpus.end())
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
+
+bool parseThreadPlacement(const char* spec, ThreadPlacement &placement)
+{
+  placement = ThreadPlacement();
+  placement.active = true;
+
+  const char* at = spec;
+
+  while (*at != '\0' && *at != ':')
+  {
+    char* end;
+    const long first = strtol(at, &end, 10);
+    long last = first;
+
+    if (end == at)
+    {
+      return false;
+    }
+
+    if (*end == '-')
+    {
+      at = end + 1;
+      last = strtol(at, &end, 10);
+
+      if (end == at)
+      {
+        return false;
+      }
+    }
+
+    if (first < 0 || last < first || last >= CPU_SETSIZE)
+    {
+      return false;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++)
+    {
+      placement.cpus.push_back(cpu);
+    }
+
+    at = (*end == ',') ? end + 1 : end;
+
+    if (*end != ',' && *end != ':' && *end != '\0')
+    {
+      return false;
+    }
+  }
+
+  if (*at == ':')
+  {
+    char* end;
+    placement.priority = strtol(at + 1, &end, 10);
+
+    if (end == at + 1 || *end != '\0' || placement.priority < 0 || placement.priority > sched_get_priority_max(SCHED_FIFO))
+    {
+      return false;
+    }
+  }
+
+  std::sort(placement.cpus.begin(), placement.cpus.end());
+  placement.cpus.erase(std::unique(placement.cpus.begin(), placement.cpus.end()), placement.cpus.end());
+
+  return true;
+}
+
+bool parseThreadConfig(const int argc, const char* const argv[], ThreadConfig &config)
+{
+  const char* rxOption = findOption(argc, argv, "rx-threads");
+  const char* dspOption = findOption(argc, argv, "dsp-threads");
+  const char* writerOption = findOption(argc, argv, "writer-threads");
+
+  config = ThreadConfig();
+  backgroundPlacement = ThreadPlacement();
+
+  if (rxOption == nullptr && dspOption == nullptr && writerOption == nullptr)
+  {
+    return true;
+  }
+
+  const char* options[] = {rxOption, dspOption, writerOption};
+  const char* names[] = {"rx-threads", "dsp-threads", "writer-threads"};
+  ThreadPlacement* placements[] = {&config.rx, &config.dsp, &config.writer};
+
+  for (int ii = 0; ii < 3; ii++)
+  {
+    placements[ii]->active = true;
+
+    if (options[ii] != nullptr && !parseThreadPlacement(options[ii], *placements[ii]))
+    {
+      std::cout << "Bad --" << names[ii] << "=" << options[ii] << ", expected <cpus>[:<priority>] like 2,3 or 4-7:80" << std::endl;
+      return false;
+    }
+  }
+
+  // Keep everything else off the receive CPUs unless told otherwise
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  std::vector<int> rest;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+  {
+    if (CPU_ISSET(cpu, &allowed) && std::find(config.rx.cpus.begin(), config.rx.cpus.end(), cpu) == config.rx.cpus.end())
+    {
+      rest.push_back(cpu);
+    }
+  }
+
+  if (!config.rx.cpus.empty())
+  {
+    if (config.dsp.cpus.empty())
+    {
+      config.dsp.cpus = rest;
+    }
+
+    if (config.writer.cpus.empty())
+    {
+      config.writer.cpus = rest;
+    }
+  }
+
+  backgroundPlacement = config.writer;
+
+  reportPlacement("RX", config.rx);
+  reportPlacement("DSP", config.dsp);
+  reportPlacement("Writer", config.writer);
+
+  if (!config.rx.cpus.empty() && rest.empty())
+  {
+    std::cout << "Warning: the RX threads have every CPU, nothing else is kept off them" << std::endl;
+  }
+
+  if (sharesCpus(config.rx, config.dsp) || sharesCpus(config.rx, config.writer))
+  {
+    std::cout << "Warning: the RX threads share CPUs with the DSP or writer threads" << std::endl;
+  }
+
+  return true;
+}
+
+bool applyThreadPlacement(const char* role, const ThreadPlacement &placement)
+{
+  if (!placement.active)
+  {
+    return true;
+  }
+
+  bool applied = true;
+
+  if (!placement.cpus.empty())
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for (const int cpu : placement.cpus)
+    {
+      CPU_SET(cpu, &cpus);
+    }
+
+    const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    if (error != 0)
+    {
+      std::cout << "Failed to put " << role << " thread on CPUs " << cpuListStr(placement.cpus) << ": " << strerror(error) << std::endl;
+      applied = false;
+    }
+  }
+
+  sched_param param;
+  std::memset(&param, 0, sizeof(param));
+  param.sched_priority = placement.priority;
+
+  const int error = pthread_setschedparam(pthread_self(), (placement.priority > 0) ? SCHED_FIFO : SCHED_OTHER, &param);
+
+  if (error != 0)
+  {
+    std::cout << "Failed to give " << role << " thread SCHED_FIFO priority " << placement.priority << ": " << strerror(error);
+    std::cout << ((error == EPERM) ? " (needs CAP_SYS_NICE or an rtprio limit)" : "") << std::endl;
+    applied = false;
+  }
+
+  return applied;
+}
+
+bool applyBackgroundPlacement(const char* role)
+{
+  return applyThreadPlacement(role, backgroundPlacement);
+}
@@ -0,0 +1,47 @@
+#ifndef ThreadConfig_H
+#define ThreadConfig_H
+
+#include <vector>
+
+// Where a role's threads run and at what real-time priority. A placement is
+// applied by the thread itself, and threads it creates afterwards inherit it,
+// so applying the receive placement before the device is opened also covers
+// the threads libbladeRF and UHD start for their transfers.
+struct ThreadPlacement
+{
+  bool active = false;  // false leaves the thread as it is
+  std::vector<int> cpus; // empty leaves the CPU mask alone
+  int priority = 0;      // SCHED_FIFO priority, 0 for SCHED_OTHER
+};
+
+struct ThreadConfig
+{
+  ThreadPlacement rx;     // receive, and any library threads behind it
+  ThreadPlacement dsp;    // processing pools
+  ThreadPlacement writer; // file writers
+};
+
+// Parses "<cpus>[:<priority>]", where cpus is a list like 2,3 or 4-7 and may
+// be left out to set just the priority, e.g. "2", "4-7:80" or ":80"
+bool parseThreadPlacement(const char* spec, ThreadPlacement &placement);
+
+// Reads --rx-threads=, --dsp-threads= and --writer-threads= and prints the
+// placement every role ends up with. Once any of them is given every role is
+// placed: a role without CPUs of its own gets the CPUs the process may use
+// less the receive CPUs, and one without a priority goes back to SCHED_OTHER
+// rather than inheriting the receive thread's. Returns false if a spec is
+// malformed.
+bool parseThreadConfig(const int argc, const char* const argv[], ThreadConfig &config);
+
+// Applies a placement to the calling thread. A failure, most often a
+// SCHED_FIFO priority without CAP_SYS_NICE or an rtprio limit, is reported
+// and returns false, but the thread carries on as it was.
+bool applyThreadPlacement(const char* role, const ThreadPlacement &placement);
+
+// Applies the writer placement parseThreadConfig() ended up with to the
+// calling thread. For the process's own background threads, the log drain
+// and the metrics exporter, which are started from the receive thread after
+// its placement and would otherwise inherit its CPUs and priority.
+bool applyBackgroundPlacement(const char* role);
+
+#endif
@@ -0,0 +1,134 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(const std::size_t numThreads, std::function<void()> initWorker) : initWorker(std::move(initWorker)), nextQueue(0), queued(0), unfinished(0), stopping(false)
+{
+  const std::size_t n = std::max<std::size_t>(numThreads, 1);
+
+  for (std::size_t ii = 0; ii < n; ii++)
+  {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+
+  for (std::size_t ii = 0; ii < n; ii++)
+  {
+    workers.emplace_back(&ThreadPool::run, this, ii);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  taskAvailable.notify_all();
+
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+  // Count the task and queue it in one go, so a worker that claims a counted
+  // task always finds one waiting in a queue
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued++;
+    unfinished++;
+
+    // Spread new tasks across the workers, stealing evens out the rest
+    WorkQueue &queue = *queues[nextQueue++ % queues.size()];
+    std::lock_guard<std::mutex> queueLock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+
+  taskAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool ThreadPool::takeTask(const std::size_t self, std::function<void()> &task)
+{
+  // Newest task from our own queue first, it's the most likely to be cache hot
+  {
+    WorkQueue &queue = *queues[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (!queue.tasks.empty())
+    {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // Otherwise steal the oldest task from someone else
+  for (std::size_t offset = 1; offset < queues.size(); offset++)
+  {
+    WorkQueue &queue = *queues[(self + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (!queue.tasks.empty())
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::run(const std::size_t self)
+{
+  if (initWorker)
+  {
+    initWorker();
+  }
+
+  while (true)
+  {
+    // Sleep until there's a task nobody else has claimed, then claim it
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      taskAvailable.wait(lock, [this] { return stopping || queued > 0; });
+
+      if (queued == 0 && stopping)
+      {
+        return;
+      }
+
+      queued--;
+    }
+
+    // There are always at least as many tasks in the queues as claims on them,
+    // so this only goes round again if another worker took the one we were
+    // about to while a new one landed in a queue we'd already looked at
+    std::function<void()> task;
+
+    while (!takeTask(self, task))
+    {
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      unfinished--;
+
+      if (unfinished == 0)
+      {
+        allDone.notify_all();
+      }
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef ThreadPool_H
+#define ThreadPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task queue. A worker takes
+// tasks from the back of its own queue and, once that runs dry, steals from
+// the front of the other workers' queues, so a few long tasks landing on the
+// same worker don't leave the rest of the pool idle. initWorker, if given,
+// runs on each worker as it starts, e.g. to place it with ThreadConfig.
+class ThreadPool
+{
+public:
+  ThreadPool(const std::size_t numThreads = std::thread::hardware_concurrency(), std::function<void()> initWorker = nullptr);
+  ~ThreadPool();
+
+  void submit(std::function<void()> task);
+
+  // Block until every task submitted so far has finished
+  void wait();
+
+  std::size_t size() const { return workers.size(); }
+
+private:
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void run(const std::size_t self);
+  bool takeTask(const std::size_t self, std::function<void()> &task);
+
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  std::function<void()> initWorker;
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> nextQueue;
+
+  std::mutex mutex;
+  std::condition_variable taskAvailable;
+  std::condition_variable allDone;
+  std::size_t queued;     // tasks sitting in a queue
+  std::size_t unfinished; // tasks queued or running
+  bool stopping;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "UsrpDevice.h"
+#include "AsyncLog.h"
+
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+  const std::string SUBDEV("A:A");
+  const std::string ANTENNA("RX2");
+
+  double hostTimeSecs()
+  {
+    return std::chrono::system_clock::now().time_since_epoch() / std::chrono::nanoseconds(1) * 1e-9;
+  }
+}
+
+UsrpDevice::UsrpDevice(const std::string &deviceArgs) : deviceArgs(deviceArgs)
+{
+}
+
+int UsrpDevice::open()
+{
+  usrp = uhd::usrp::multi_usrp::make(deviceArgs);
+
+  if (!usrp)
+  {
+    std::cout << "Unable to open USRP " << deviceArgs << std::endl;
+    return __LINE__;
+  }
+
+  return 0;
+}
+
+int UsrpDevice::configure(const RadioSettings &settings, IqPacket &packet)
+{
+  // Save off information about the device being used
+
+  packet.linkSpeed = 0;
+
+  strncpy(packet.boardName, usrp->get_mboard_name().c_str(), sizeof(packet.boardName) - 1);
+  strncpy(packet.serialNumber, usrp->get_usrp_rx_info().get("mboard_serial").c_str(), sizeof(packet.serialNumber) - 1);
+
+  uhd::property_tree::sptr tree = usrp->get_device()->get_tree();
+  const uhd::fs_path& path = "/mboards/0/";
+
+  strncpy(packet.fpgaVersion, tree->access<std::string>(path / "fpga_version").get().c_str(), sizeof(packet.fpgaVersion) - 1);
+  strncpy(packet.fwVersion, tree->access<std::string>(path / "fw_version").get().c_str(), sizeof(packet.fwVersion) - 1);
+
+  std::cout << "Opened " << packet.boardName << " " << packet.serialNumber << ", FPGA " << packet.fpgaVersion << ", FW " << packet.fwVersion << std::endl;
+
+  // Lock mboard clocks
+  usrp->set_clock_source("internal");
+
+  //always select the subdevice first, the channel mapping affects the other settings
+  usrp->set_rx_subdev_spec(SUBDEV);
+
+  uhd::stream_args_t stream_args("sc16","sc12"); // 16-bit integers on host, 12-bit integers over-the-wire
+  rxStream = usrp->get_rx_stream(stream_args);
+
+  usrp->set_rx_rate(settings.sampleRateSps);
+  usrp->set_rx_bandwidth(settings.bandwidthHz);
+  usrp->set_rx_agc(false);
+  usrp->set_rx_gain(settings.rxGainDb);
+  usrp->set_rx_antenna(ANTENNA);
+
+  uhd::tune_request_t tune_request(settings.frequencyHz);
+  usrp->set_rx_freq(tune_request);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10)); // allow LO to lock
+
+  if constexpr (std::endian::native == std::endian::big)
+  {
+    packet.endianness = 0x00000000;
+  }
+  else if constexpr (std::endian::native == std::endian::little)
+  {
+    packet.endianness = 0x03030303;
+  }
+  else
+  {
+    packet.endianness = 0xFFFFFFFF;
+  }
+
+  packet.frequencyHz = usrp->get_rx_freq();
+  packet.bandwidthHz = usrp->get_rx_bandwidth();
+  packet.sampleRateSps = usrp->get_rx_rate();
+  packet.rxGainDb = usrp->get_rx_gain();
+  packet.bitWidth = 16; // signed 16-bit integer
+
+  std::cout << packet.serialNumber << ": " << packet.frequencyHz*1e-6 << " MHz, " << packet.sampleRateSps*1e-6 << " Msps, " << packet.bandwidthHz*1e-6 << " MHz bandwidth, " << packet.rxGainDb << " dB gain" << std::endl;
+
+  return 0;
+}
+
+int UsrpDevice::syncTime(const bool usePps)
+{
+  if (!usePps)
+  {
+    usrp->set_time_now(uhd::time_spec_t(hostTimeSecs()));
+    return 0;
+  }
+
+  usrp->set_time_source("external");
+
+  // Wait for a PPS edge so there's most of a second to set the time for the
+  // next one. The host clock says which second that is.
+  const double lastPps = usrp->get_time_last_pps().get_real_secs();
+  const double giveUpSecs = hostTimeSecs() + 1.5;
+
+  while (usrp->get_time_last_pps().get_real_secs() == lastPps)
+  {
+    if (hostTimeSecs() > giveUpSecs)
+    {
+      std::cout << "No PPS edge seen on " << deviceArgs << std::endl;
+      return __LINE__;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  usrp->set_time_next_pps(uhd::time_spec_t(std::floor(hostTimeSecs()) + 1));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  return 0;
+}
+
+int UsrpDevice::trackHostClock(double &driftSec)
+{
+  // The device keeps its own time, which is only measured here: setting it
+  // again would move it under dwells already scheduled
+  const double before = hostTimeSecs();
+  const double deviceSecs = usrp->get_time_now().get_real_secs();
+  const double after = hostTimeSecs();
+
+  driftSec = deviceSecs - (before + after)/2;
+
+  return 0;
+}
+
+int UsrpDevice::start()
+{
+  // Each dwell is its own timed stream command
+  return 0;
+}
+
+void UsrpDevice::stop()
+{
+}
+
+std::size_t UsrpDevice::receive(std::complex<std::int16_t>* iq, const std::size_t numSamples, const double startTimeSecs, double &sampleStartTime, bool &overrun)
+{
+  uhd::rx_metadata_t meta;
+  uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
+
+  stream_cmd.num_samps = numSamples;
+  stream_cmd.stream_now = false;
+  stream_cmd.time_spec = uhd::time_spec_t(startTimeSecs);
+
+  rxStream->issue_stream_cmd(stream_cmd);
+
+  const double timeoutSecs = std::max(startTimeSecs - timeNow(), 0.0) + numSamples/usrp->get_rx_rate() + 500e-3;
+
+  const std::size_t numReceived = rxStream->recv(iq, numSamples, meta, timeoutSecs);
+
+  sampleStartTime = meta.time_spec.get_real_secs();
+  overrun = (meta.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW);
+
+  switch (meta.error_code)
+  {
+    case uhd::rx_metadata_t::ERROR_CODE_NONE:
+    case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+      break;
+
+    case uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND:
+      logAsync("Dwell at {} was already in the past", startTimeSecs);
+      break;
+
+    case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT:
+      logAsync("ERROR_CODE_TIMEOUT: Got timeout before all samples received");
+      break;
+
+    default:
+      logAsync("Got error code: {}", meta.strerror());
+      break;
+  }
+
+  return numReceived;
+}
+
+double UsrpDevice::timeNow()
+{
+  return usrp->get_time_now().get_real_secs();
+}
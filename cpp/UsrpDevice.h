@@ -0,0 +1,35 @@
+#ifndef UsrpDevice_H
+#define UsrpDevice_H
+
+#include "RadioDevice.h"
+
+#include <uhd/usrp/multi_usrp.hpp>
+
+#include <string>
+
+// A USRP on subdevice A:A streaming 12-bit samples over the wire as 16-bit
+// samples on the host. Dwells are timed stream commands, so they start on the
+// requested sample. With a PPS input the device time is set on a PPS edge,
+// which lines up every USRP wired to the same PPS to the sample.
+class UsrpDevice : public RadioDevice
+{
+public:
+  // UHD device arguments, e.g. "serial=3164AD2" or "addr=192.168.10.2"
+  UsrpDevice(const std::string &deviceArgs);
+
+  int open() override;
+  int configure(const RadioSettings &settings, IqPacket &packet) override;
+  int syncTime(const bool usePps) override;
+  int trackHostClock(double &driftSec) override;
+  int start() override;
+  void stop() override;
+  std::size_t receive(std::complex<std::int16_t>* iq, const std::size_t numSamples, const double startTimeSecs, double &sampleStartTime, bool &overrun) override;
+  double timeNow() override;
+
+private:
+  std::string deviceArgs;
+  uhd::usrp::multi_usrp::sptr usrp;
+  uhd::rx_streamer::sptr rxStream;
+};
+
+#endif
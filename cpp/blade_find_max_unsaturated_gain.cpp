@@ -3,6 +3,8 @@
  */
 #include <libbladeRF.h>
 
+#include "BladeRfSyncTuning.h"
+
 #include <cstring>
 
 #include <iostream>
@@ -181,15 +183,16 @@ int main(const int argc, const char *argv[])
    * the hardware until `buffer_size` samples are provided via the
    * bladerf_sync_tx call. Similarly, samples will not be available to
    * RX via bladerf_sync_rx() until a block of `buffer_size` samples has been
-   * received. */
-  const std::uint32_t num_buffers = 4;
-  const std::uint32_t buffer_size = 1024 * 1024; /* Must be a multiple of 1024 */
-  const std::uint32_t num_transfers = 2;
-  const std::uint32_t timeout_ms = 3500;
+   * received.
+   *
+   * Settings blade_tune_sync found for this host, link speed and format are
+   * used if there are any for this sample rate, otherwise these defaults. */
+  const BladeRfSyncParams defaultSync = {4, 1024 * 1024, 2, 3500}; // buffers, buffer size (a multiple of 1024), transfers, timeout ms
+  const BladeRfSyncParams sync = loadBladeRfSyncParams(dev, BLADERF_FORMAT_SC8_Q7_META, 1, receivedSampleRate, defaultSync);
 
   // Configure both the device's x1 RX and TX channels for use with the synchronous interface.
 
-  status = bladerf_sync_config(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC8_Q7_META, num_buffers, buffer_size, num_transfers, timeout_ms);
+  status = bladerf_sync_config(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC8_Q7_META, sync.numBuffers, sync.bufferSize, sync.numTransfers, sync.timeoutMs);
 
   if (status == 0)
   {
@@ -5,11 +5,23 @@
 
 #include "IqPacket.h"
 #include "Helper.h"
+#include "EnergyGate.h"
+#include "DigitalDownconverter.h"
+#include "SharedIqRing.h"
+#include "BufferPool.h"
+#include "ThreadConfig.h"
+#include "ChannelDeinterleave.h"
+#include "BladeRfSyncTuning.h"
+#include "PipelineMetrics.h"
+#include "PipelineTrace.h"
+#include "AsyncLog.h"
 
 #include <cstring>
+#include <cmath>
 
 #include <bit>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <chrono>
 #include <complex>
@@ -28,10 +40,10 @@ int main(const int argc, const char *argv[])
   char filenameStr[FILENAME_LENGTH];
   std::uint32_t overrunCounter = 0;
 
-  if (argc != 8)
+  if (countPositionalArgs(argc, argv) != 8)
   {
     std::cout << std::endl << "\tUsage:" << std::endl;
-    std::cout << "\t\t" << argv[0] << " <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec> <durationSec> <filter delay>" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec> <durationSec> <filter delay> [--gate-snr-db=<dB>] [--ddc-offset-mhz=<MHz>] [--ddc-bw-mhz=<MHz>] [--channels=<1|2>] [--shm=<name>] [--metrics=<file>] [--trace=<file>] [--rx-threads=<cpus>[:<priority>]]" << std::endl;
     std::cout << std::endl;
     return __LINE__;
   }
@@ -46,6 +58,31 @@ int main(const int argc, const char *argv[])
   const float dwellDuration = atof(argv[5]);
   const float collectionDuration = atof(argv[6]);
   const std::int32_t FILTER_DELAY = atoi(argv[7]); // Number of initial zero'd samples induced by filter delay
+  const char* gateSnrOption = findOption(argc, argv, "gate-snr-db"); // Optionally only write dwells with a peak this far above the noise
+  const char* ddcOffsetOption = findOption(argc, argv, "ddc-offset-mhz"); // Center of the sub-band to record relative to the LO
+  const char* ddcBandwidthOption = findOption(argc, argv, "ddc-bw-mhz"); // Optionally record just a sub-band this wide
+  const char* shmOption = findOption(argc, argv, "shm"); // Optionally publish every dwell to local readers in this shared memory ring
+  const char* metricsOption = findOption(argc, argv, "metrics"); // Optionally export stage times and error counts to this Prometheus text file
+  const char* traceOption = findOption(argc, argv, "trace"); // Optionally record a timeline of every stage to this Chrome trace JSON file
+  const char* channelsOption = findOption(argc, argv, "channels"); // 2 records both RX channels of a bladeRF 2.0
+  const std::uint32_t NUM_CHANNELS = (channelsOption != nullptr) ? atoi(channelsOption) : 1;
+
+  if (NUM_CHANNELS != 1 && NUM_CHANNELS != 2)
+  {
+    std::cout << "Only 1 or 2 channels can be recorded" << std::endl;
+    return __LINE__;
+  }
+
+  // The receive thread does everything here. Placed before the device is
+  // opened so the library's own transfer threads start out placed the same.
+  ThreadConfig threads;
+
+  if (!parseThreadConfig(argc, argv, threads))
+  {
+    return __LINE__;
+  }
+
+  applyThreadPlacement("RX", threads.rx);
 
   /* Initialize the information used to identify the desired device
    * to all wildcard (i.e., "any device") values */
@@ -113,6 +150,15 @@ int main(const int argc, const char *argv[])
     return __LINE__;
   }
 
+  // Make sure the board has as many RX channels as were asked for
+
+  if (bladerf_get_channel_count(dev, BLADERF_RX) < NUM_CHANNELS)
+  {
+    std::cout << "Board has fewer than " << NUM_CHANNELS << " RX channels" << std::endl;
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
   // Set center frequency of device
 
   status = bladerf_set_frequency(dev, channel, requestedFrequencyHz);
@@ -189,6 +235,48 @@ int main(const int argc, const char *argv[])
     return __LINE__;
   }
 
+  // Give the second channel the same settings as the first. Both channels
+  // are clocked and tuned by the same RFIC, so their samples are phase
+  // coherent and share the one timestamp.
+
+  for (std::uint32_t ch = 1; ch < NUM_CHANNELS; ch++)
+  {
+    const bladerf_channel otherChannel = BLADERF_CHANNEL_RX(ch);
+
+    status = bladerf_set_frequency(dev, otherChannel, requestedFrequencyHz);
+
+    if (status == 0)
+    {
+      status = bladerf_set_sample_rate(dev, otherChannel, requestedSampleRate, &receivedSampleRate);
+    }
+
+    if (status == 0)
+    {
+      status = bladerf_set_bandwidth(dev, otherChannel, requestedBandwidthHz, &receivedBandwidthHz);
+    }
+
+    if (status == 0)
+    {
+      status = bladerf_set_gain_mode(dev, otherChannel, BLADERF_GAIN_MGC);
+    }
+
+    if (status == 0)
+    {
+      status = bladerf_set_gain(dev, otherChannel, rxGain);
+    }
+
+    if (status == 0)
+    {
+      std::cout << "Configured RX channel " << ch << " to match RX channel 0" << std::endl;
+    }
+    else
+    {
+      std::cout << "Failed to configure RX channel " << ch << ": " << bladerf_strerror(status) << std::endl;
+      bladerf_close(dev);
+      return __LINE__;
+    }
+  }
+
   // Compute the requested number of samples and buffer size
 
   const std::uint64_t requested_num_samples = dwellDuration*receivedSampleRate + FILTER_DELAY;
@@ -203,15 +291,17 @@ int main(const int argc, const char *argv[])
    * the hardware until `buffer_size` samples are provided via the
    * bladerf_sync_tx call. Similarly, samples will not be available to
    * RX via bladerf_sync_rx() until a block of `buffer_size` samples has been
-   * received. */
-  const std::uint32_t num_buffers = 4;
-  const std::uint32_t buffer_size = 1024 * 1024; /* Must be a multiple of 1024 */
-  const std::uint32_t num_transfers = 2;
-  const std::uint32_t timeout_ms = 3500;
+   * received.
+   *
+   * Settings blade_tune_sync found for this host, link speed, format and
+   * channel count are used if there are any for this sample rate, otherwise
+   * these defaults. */
+  const BladeRfSyncParams defaultSync = {4, 1024 * 1024, 2, 3500}; // buffers, buffer size (a multiple of 1024), transfers, timeout ms
+  const BladeRfSyncParams sync = loadBladeRfSyncParams(dev, BLADERF_FORMAT_SC8_Q7_META, NUM_CHANNELS, receivedSampleRate, defaultSync);
 
-  // Configure both the device's x1 RX and TX channels for use with the synchronous interface.
+  // Configure the device's x1 RX channel, or x2 RX channels, for use with the synchronous interface.
 
-  status = bladerf_sync_config(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC8_Q7_META, num_buffers, buffer_size, num_transfers, timeout_ms);
+  status = bladerf_sync_config(dev, (NUM_CHANNELS == 2) ? BLADERF_RX_X2 : BLADERF_RX_X1, BLADERF_FORMAT_SC8_Q7_META, sync.numBuffers, sync.bufferSize, sync.numTransfers, sync.timeoutMs);
 
   if (status == 0)
   {
@@ -224,17 +314,20 @@ int main(const int argc, const char *argv[])
     return __LINE__;
   }
 
-  status = bladerf_enable_module(dev, BLADERF_RX, true);
-
-  if (status == 0)
+  for (std::uint32_t ch = 0; ch < NUM_CHANNELS; ch++)
   {
-    std::cout << "Enabled RX" << std::endl;
-  }
-  else
-  {
-    std::cout << "Failed to enable RX: " << bladerf_strerror(status) << std::endl;
-    bladerf_close(dev);
-    return __LINE__;
+    status = bladerf_enable_module(dev, BLADERF_CHANNEL_RX(ch), true);
+
+    if (status == 0)
+    {
+      std::cout << "Enabled RX channel " << ch << std::endl;
+    }
+    else
+    {
+      std::cout << "Failed to enable RX channel " << ch << ": " << bladerf_strerror(status) << std::endl;
+      bladerf_close(dev);
+      return __LINE__;
+    }
   }
 
   // Specify the endianness of the recording
@@ -263,9 +356,76 @@ int main(const int argc, const char *argv[])
   // Precompute the filter delay in seconds
   const std::double_t filterDelaySecs = FILTER_DELAY*1.0/packet.sampleRateSps;
 
-  // Allocate the host buffer the device will be streaming to
+  // Optionally record just a sub-band of the stream instead of all of it,
+  // mixed down to DC and decimated. The sub-band is always written as 16-bit
+  // samples, with its own center frequency, bandwidth and sample rate.
+
+  const bool useDdc = (ddcBandwidthOption != nullptr);
+  const double ddcOffsetHz = (ddcOffsetOption != nullptr) ? atof(ddcOffsetOption)*1e6 : 0;
+  const double ddcBandwidthHz = useDdc ? atof(ddcBandwidthOption)*1e6 : DigitalDownconverter::maxBandwidth(packet.sampleRateSps);
+  const float DDC_OUTPUT_SCALE = 256; // SC8_Q7 samples to 16-bit full scale
+
+  if (useDdc && (ddcBandwidthHz <= 0 || ddcBandwidthHz > DigitalDownconverter::maxBandwidth(packet.sampleRateSps) || std::abs(ddcOffsetHz) + ddcBandwidthHz/2 > packet.sampleRateSps/2.0))
+  {
+    std::cout << "Sub-band of " << ddcBandwidthHz*1e-6 << " MHz at " << ddcOffsetHz*1e-6 << " MHz doesn't fit in " << packet.sampleRateSps*1e-6 << " Msps" << std::endl;
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
+  DigitalDownconverter ddc(packet.sampleRateSps, ddcOffsetHz, ddcBandwidthHz, DDC_OUTPUT_SCALE);
+
+  IqPacket ddcPacket = packet;
+  ddcPacket.frequencyHz = std::llround(packet.frequencyHz + ddc.offsetHz());
+  ddcPacket.bandwidthHz = ddcBandwidthHz;
+  ddcPacket.sampleRateSps = std::llround(ddc.outputSampleRate());
+  ddcPacket.bitWidth = 16; // signed 16-bit integer
+
+  BufferPool ddcPool(ddc.maxOutputSamples(requested_num_samples)*sizeof(std::complex<std::int16_t>), NUM_CHANNELS);
+  std::complex<std::int16_t>* ddcIq[2] = {nullptr, nullptr};
+
+  for (std::uint32_t ch = 0; useDdc && ch < NUM_CHANNELS; ch++)
+  {
+    ddcIq[ch] = ddcPool.acquire<std::complex<std::int16_t>>();
 
-  std::complex<std::int8_t>* iq = new std::complex<std::int8_t>[requested_num_samples];
+    if (ddcIq[ch] == nullptr)
+    {
+      bladerf_close(dev);
+      return __LINE__;
+    }
+  }
+
+  if (useDdc)
+  {
+    std::cout << "Recording " << ddcPacket.bandwidthHz*1e-6 << " MHz at " << ddcPacket.frequencyHz*1e-6 << " MHz, " << ddcPacket.sampleRateSps*1e-6 << " Msps" << std::endl;
+  }
+
+  // Allocate the host buffer the device will be streaming to. It's on huge
+  // pages, faulted in up front, so the dwell isn't slowed by page faults.
+
+  BufferPool iqPool(requested_num_samples*NUM_CHANNELS*sizeof(std::complex<std::int8_t>), 1);
+  std::complex<std::int8_t>* iq = iqPool.acquire<std::complex<std::int8_t>>();
+
+  if (iq == nullptr)
+  {
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
+  // In two channel mode the device interleaves the channels one sample at a
+  // time, so they're split into a buffer each before being written
+  BufferPool channelPool(requested_num_samples*sizeof(std::complex<std::int8_t>), NUM_CHANNELS);
+  std::complex<std::int8_t>* channelIq[2] = {iq, nullptr};
+
+  for (std::uint32_t ch = 0; NUM_CHANNELS > 1 && ch < NUM_CHANNELS; ch++)
+  {
+    channelIq[ch] = channelPool.acquire<std::complex<std::int8_t>>();
+
+    if (channelIq[ch] == nullptr)
+    {
+      bladerf_close(dev);
+      return __LINE__;
+    }
+  }
 
   const std::chrono::system_clock::time_point startTime = std::chrono::system_clock::now();
   const std::double_t startTimeSecs = startTime.time_since_epoch() / std::chrono::nanoseconds(1) * 1e-9;
@@ -284,6 +444,75 @@ int main(const int argc, const char *argv[])
     return __LINE__;
   }
 
+  // Every complete dwell is published as it comes in, written or not, for
+  // other processes to follow live
+
+  SharedIqRingWriter liveRing;
+
+  if (shmOption != nullptr)
+  {
+    // Big enough for two whole dwells, so a reader can take one while the
+    // next goes in
+    const std::uint64_t channelBytes = useDdc ? ddc.maxOutputSamples(requested_num_samples)*sizeof(std::complex<std::int16_t>) : requested_num_samples*sizeof(std::complex<std::int8_t>);
+    const std::uint32_t numSlots = SharedIqRingWriter::slotsForDwells(channelBytes, NUM_CHANNELS);
+
+    if (!liveRing.create(shmOption, numSlots))
+    {
+      bladerf_close(dev);
+      return __LINE__;
+    }
+
+    std::cout << "Publishing dwells to shared memory " << shmOption << ", " << numSlots*(SHARED_IQ_SLOT_BYTES/1024)/1024 << " MB" << std::endl;
+  }
+
+  // Dwells holding nothing but noise aren't written when gating, but every
+  // dwell still gets a line in the summary so coverage can be audited
+  EnergyGate energyGate(gateSnrOption != nullptr ? atof(gateSnrOption) : 0);
+  std::ofstream gateSummary;
+  std::uint32_t dwellCounter = 0;
+  std::uint32_t writtenCounter = 0;
+
+  if (gateSnrOption != nullptr)
+  {
+    getFilenameStr(startTime, filenameStr, FILENAME_LENGTH, "csv");
+
+    gateSummary.open(filenameStr);
+    gateSummary << "sampleStartTime,noiseFloor,peak,peakSnrDb,noisePeakSnrDb,short,written" << std::endl;
+
+    std::cout << "Gating dwells at " << gateSnrOption << " dB, summary in " << filenameStr << std::endl;
+
+    // The peak is of single samples, so noise alone peaks this far above the floor
+    const float noisePeakSnrDb = EnergyGate::noisePeakSnrDb(useDdc ? ddc.maxOutputSamples(requested_num_samples - FILTER_DELAY) : requested_num_samples - FILTER_DELAY);
+
+    std::cout << "A dwell of pure noise peaks about " << noisePeakSnrDb << " dB above the noise floor" << std::endl;
+
+    if (atof(gateSnrOption) <= noisePeakSnrDb)
+    {
+      std::cout << "Warning: dwells of noise alone will pass a gate at " << gateSnrOption << " dB" << std::endl;
+    }
+  }
+
+  // Where each dwell's time goes, timed with the TSC
+  PipelineMetrics metrics("blade_record_iq_08bit", dwellDuration);
+
+  if (metricsOption != nullptr && !metrics.startExport(metricsOption))
+  {
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
+  // Every stage of every dwell on a timeline, to see what else was going on
+  // around an overrun
+  if (traceOption != nullptr)
+  {
+    startTrace();
+    nameTraceThread("RX");
+  }
+
+  // Messages from the loop are written out on a background thread, so a
+  // slow console can't hold up a dwell
+  startAsyncLog();
+
   while(((currentTime - startTime) / std::chrono::milliseconds(1) * 1e-3) <= collectionDuration)
   {
     std::memset(&meta, 0, sizeof(meta));
@@ -295,52 +524,183 @@ int main(const int argc, const char *argv[])
 
     packet.sampleStartTime = startTimeSecs + relativeSampleTimeSecs + filterDelaySecs;
 
-    status = bladerf_sync_rx(dev, iq, requested_num_samples, &meta, 5000);
+    const std::uint64_t recvStart = readTsc();
+
+    status = bladerf_sync_rx(dev, iq, requested_num_samples*NUM_CHANNELS, &meta, 5000);
+
+    metrics.recv.recordSince(recvStart);
+    traceSince("recv", recvStart);
+    const std::uint64_t processStart = readTsc();
 
     if (status != 0)
     {
-      std::cout << "RX \"now\" failed: " << bladerf_strerror(status) << std::endl;
+      logAsync("RX \"now\" failed: {}", bladerf_strerror(status));
+
+      if (status == BLADERF_ERR_TIMEOUT)
+      {
+        metrics.timeouts++;
+        traceInstant("timeout");
+      }
     }
     else if (meta.status & BLADERF_META_STATUS_OVERRUN)
     {
-      std::cout << "Overrun detected. " << meta.actual_count << " valid samples were read." << std::endl;
+      logAsync("Overrun detected. {} valid samples were read.", meta.actual_count);
       overrunCounter++;
+      metrics.overruns++;
+      traceInstant("overrun");
     }
     else
     {
-      std::cout << "Received " << meta.actual_count << std::endl;
+      logAsync("Received {}", meta.actual_count);
     }
 
-    packet.numSamples = meta.actual_count - FILTER_DELAY;
+    // The count is of samples across all channels
+    packet.numSamples = meta.actual_count/NUM_CHANNELS - FILTER_DELAY;
+
+    bool keepDwell = (packet.numSamples == (requested_num_samples - FILTER_DELAY));
+
+    if (!keepDwell)
+    {
+      metrics.shortReads++;
+    }
 
-    if (packet.numSamples == (requested_num_samples - FILTER_DELAY))
+    if (keepDwell && NUM_CHANNELS == 2)
     {
-      getFilenameStr(currentTime, filenameStr, FILENAME_LENGTH);
+      TraceScope trace("deinterleave");
 
-      std::ofstream fout(filenameStr, std::ofstream::binary);
-      fout.write((const char*)&packet, sizeof(packet));
-      fout.write((const char*)&iq[FILTER_DELAY], (requested_num_samples-FILTER_DELAY)*sizeof(std::complex<std::int8_t>));
-      fout.close();
+      deinterleaveChannels(iq, requested_num_samples, channelIq[0], channelIq[1]);
     }
-  }
 
-  // Disable the device
+    // Pull the sub-band out of the dwell, which is then what's gated and
+    // written. Dwells aren't contiguous so each starts the filters afresh.
+    for (std::uint32_t ch = 0; keepDwell && useDdc && ch < NUM_CHANNELS; ch++)
+    {
+      TraceScope trace("channelize");
+
+      ddc.reset();
+      ddcPacket.numSamples = ddc.process(&channelIq[ch][FILTER_DELAY], packet.numSamples, ddcIq[ch]);
+      ddcPacket.sampleStartTime = packet.sampleStartTime + ddc.outputTimeOffset()/packet.sampleRateSps;
+    }
 
-  status = bladerf_enable_module(dev, BLADERF_RX, false);
+    for (std::uint32_t ch = 0; keepDwell && shmOption != nullptr && ch < NUM_CHANNELS; ch++)
+    {
+      TraceScope trace("publish");
+
+      if (useDdc)
+      {
+        liveRing.publish(ddcPacket, ddcIq[ch], ddcPacket.numSamples, ch);
+      }
+      else
+      {
+        liveRing.publish(packet, &channelIq[ch][FILTER_DELAY], packet.numSamples, ch);
+      }
+    }
 
-  if (status == 0)
-  {
-    std::cout << "Disabled RX" << std::endl;
+    // A dwell cut short is never written, but still gets its line in the
+    // summary. With two channels the dwell is kept if either channel passes,
+    // so the files of the two channels always come in pairs, and the summary
+    // is of the channel with the stronger peak.
+    if (!keepDwell && gateSnrOption != nullptr)
+    {
+      gateSummary << std::setprecision(15) << packet.sampleStartTime << ",,,,,1,0" << std::endl;
+    }
+    else if (gateSnrOption != nullptr)
+    {
+      TraceScope trace("detect");
+
+      bool anyPassed = false;
+      float bestSnrDb = -INFINITY;
+      float bestNoiseFloor = 0;
+      float bestPeak = 0;
+
+      for (std::uint32_t ch = 0; ch < NUM_CHANNELS; ch++)
+      {
+        anyPassed |= useDdc ? energyGate.process(ddcIq[ch], ddcPacket.numSamples) : energyGate.process(&channelIq[ch][FILTER_DELAY], packet.numSamples);
+
+        if (energyGate.peakSnrDb() > bestSnrDb)
+        {
+          bestSnrDb = energyGate.peakSnrDb();
+          bestNoiseFloor = energyGate.noiseFloor();
+          bestPeak = energyGate.peak();
+        }
+      }
+
+      keepDwell = anyPassed;
+
+      const float noisePeakSnrDb = EnergyGate::noisePeakSnrDb(useDdc ? ddcPacket.numSamples : packet.numSamples);
+
+      gateSummary << std::setprecision(15) << packet.sampleStartTime << "," << bestNoiseFloor << "," << bestPeak << "," << bestSnrDb << "," << noisePeakSnrDb << ",0," << keepDwell << std::endl;
+    }
+
+    metrics.process.recordSince(processStart);
+    traceSince("process", processStart);
+    metrics.dwells++;
+
+    dwellCounter++;
+
+    if (keepDwell)
+    {
+      writtenCounter++;
+
+      const std::uint64_t writeStart = readTsc();
+
+      for (std::uint32_t ch = 0; ch < NUM_CHANNELS; ch++)
+      {
+        // Each channel gets its own file, named for the channel when there
+        // are two, with the same start time in both
+        char extension[8];
+        snprintf(extension, sizeof(extension), (NUM_CHANNELS == 2) ? "ch%u.iq" : "iq", ch);
+
+        getFilenameStr(currentTime, filenameStr, FILENAME_LENGTH, extension);
+
+        std::ofstream fout(filenameStr, std::ofstream::binary);
+
+        if (useDdc)
+        {
+          fout.write((const char*)&ddcPacket, sizeof(ddcPacket));
+          fout.write((const char*)ddcIq[ch], ddcPacket.numSamples*sizeof(std::complex<std::int16_t>));
+        }
+        else
+        {
+          fout.write((const char*)&packet, sizeof(packet));
+          fout.write((const char*)&channelIq[ch][FILTER_DELAY], (requested_num_samples-FILTER_DELAY)*sizeof(std::complex<std::int8_t>));
+        }
+
+        fout.close();
+      }
+
+      metrics.write.recordSince(writeStart);
+      traceSince("write", writeStart);
+    }
   }
-  else
+
+  flushAsyncLog();
+
+  // Disable the device
+
+  for (std::uint32_t ch = 0; ch < NUM_CHANNELS; ch++)
   {
-    std::cout << "Failed to disable RX: " << bladerf_strerror(status) << std::endl;
+    status = bladerf_enable_module(dev, BLADERF_CHANNEL_RX(ch), false);
+
+    if (status == 0)
+    {
+      std::cout << "Disabled RX channel " << ch << std::endl;
+    }
+    else
+    {
+      std::cout << "Failed to disable RX channel " << ch << ": " << bladerf_strerror(status) << std::endl;
+    }
   }
 
   std::cout << "There were " << overrunCounter << " overruns." << std::endl;
+  std::cout << "Wrote " << writtenCounter << " of " << dwellCounter << " dwells." << std::endl;
+
+  metrics.printSummary();
 
-  // Free up the I/Q buffer we dynamically allocated
-  delete [] iq;
+  if (traceOption != nullptr)
+  {
+    writeTrace(traceOption);
+  }
 
   return status;
 }
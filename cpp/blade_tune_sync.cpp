@@ -0,0 +1,235 @@
+#include <libbladeRF.h>
+
+#include "Helper.h"
+#include "BladeRfSyncTuning.h"
+
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+
+const std::uint32_t BUFFER_SIZES[] = {8192, 32768, 131072, 524288, 1048576}; // samples, multiples of 1024
+const std::uint32_t BUFFER_COUNTS[] = {4, 8, 16, 32}; // with half as many transfers in flight
+const std::uint32_t TIMEOUT_MS = 3500; // on top of the time to fill a buffer
+const std::uint32_t READ_SAMPLES = 262144; // per channel, read at a time like a short dwell
+const double WARMUP_SEC = 0.2; // streamed and thrown away before measuring each setting
+const double STALL_HEADROOM = 4; // buffering has to cover stalls this many times longer than any seen
+
+// How one setting fared
+struct TuningResult
+{
+  BladeRfSyncParams params;
+  double bufferedSec;
+  std::uint32_t numReads;
+  std::uint32_t numOverruns;
+  std::uint32_t numErrors;
+  double meanReadSec;
+  double maxReadSec;
+};
+
+int main(const int argc, const char *argv[])
+{
+  std::int32_t status;
+  bladerf *dev = NULL;
+  bladerf_devinfo dev_info;
+  bladerf_metadata meta;
+
+  const int numPositionalArgs = countPositionalArgs(argc, argv);
+
+  if (numPositionalArgs < 2 || numPositionalArgs > 3)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <sampleRateMsps> [secPerSetting] [--channels=<1|2>] [--bits=<8|12>]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\tStreams at the sample rate with a grid of sync buffer settings," << std::endl;
+    std::cout << "\tcounting overruns and timing each read, and saves the setting" << std::endl;
+    std::cout << "\twith the least buffering that kept up for this host, link speed," << std::endl;
+    std::cout << "\tsample format and channel count. The bladeRF recorders using the" << std::endl;
+    std::cout << "\tsame format and channels pick it up from then on." << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const std::uint32_t requestedSampleRate = atof(argv[1])*1e6;
+  std::uint32_t receivedSampleRate = 0;
+  const double secPerSetting = (numPositionalArgs > 2) ? atof(argv[2]) : 2;
+  const char* channelsOption = findOption(argc, argv, "channels");
+  const char* bitsOption = findOption(argc, argv, "bits");
+  const std::uint32_t NUM_CHANNELS = (channelsOption != nullptr) ? atoi(channelsOption) : 1;
+  const bool use8Bit = (bitsOption != nullptr && atoi(bitsOption) == 8);
+  const bladerf_format format = use8Bit ? BLADERF_FORMAT_SC8_Q7_META : BLADERF_FORMAT_SC16_Q11_META;
+  const std::uint32_t bytesPerSample = use8Bit ? 2 : 4;
+
+  if (NUM_CHANNELS != 1 && NUM_CHANNELS != 2)
+  {
+    std::cout << "Only 1 or 2 channels can be streamed" << std::endl;
+    return __LINE__;
+  }
+
+  bladerf_init_devinfo(&dev_info);
+
+  status = bladerf_open_with_devinfo(&dev, &dev_info);
+
+  if (status != 0)
+  {
+    std::cout << "Unable to open device: " << bladerf_strerror(status) << std::endl;
+    return __LINE__;
+  }
+
+  status = bladerf_enable_feature(dev, BLADERF_FEATURE_DEFAULT, true);
+
+  for (std::uint32_t ch = 0; status == 0 && ch < NUM_CHANNELS; ch++)
+  {
+    status = bladerf_set_sample_rate(dev, BLADERF_CHANNEL_RX(ch), requestedSampleRate, &receivedSampleRate);
+  }
+
+  if (status != 0)
+  {
+    std::cout << "Failed to set up device: " << bladerf_strerror(status) << std::endl;
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
+  const double bytesPerSec = 1.0*receivedSampleRate*NUM_CHANNELS*bytesPerSample;
+
+  std::cout << "Tuning " << NUM_CHANNELS << " channel(s) of " << (use8Bit ? 8 : 12) << "-bit samples at " << receivedSampleRate*1e-6 << " Msps (" << bytesPerSec*1e-6 << " MB/s) over " << bladeRfSpeedStr(bladerf_device_speed(dev)) << std::endl;
+
+  std::vector<std::int16_t> iq(2*READ_SAMPLES*NUM_CHANNELS);
+  std::vector<TuningResult> results;
+  const double readSec = 1.0*READ_SAMPLES/receivedSampleRate;
+
+  for (const std::uint32_t bufferSize : BUFFER_SIZES)
+  {
+    for (const std::uint32_t numBuffers : BUFFER_COUNTS)
+    {
+      TuningResult result = {};
+      result.params.numBuffers = numBuffers;
+      result.params.bufferSize = bufferSize;
+      result.params.numTransfers = numBuffers/2;
+      result.params.timeoutMs = TIMEOUT_MS + std::ceil(1e3*bufferSize/receivedSampleRate);
+      result.bufferedSec = 1.0*numBuffers*bufferSize/(receivedSampleRate*NUM_CHANNELS);
+
+      status = bladerf_sync_config(dev, (NUM_CHANNELS == 2) ? BLADERF_RX_X2 : BLADERF_RX_X1, format, result.params.numBuffers, result.params.bufferSize, result.params.numTransfers, result.params.timeoutMs);
+
+      for (std::uint32_t ch = 0; status == 0 && ch < NUM_CHANNELS; ch++)
+      {
+        status = bladerf_enable_module(dev, BLADERF_CHANNEL_RX(ch), true);
+      }
+
+      if (status != 0)
+      {
+        std::cout << bufferSize << " x " << numBuffers << ": failed to start streaming: " << bladerf_strerror(status) << std::endl;
+        continue;
+      }
+
+      const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+      double totalReadSec = 0;
+
+      while (true)
+      {
+        const std::chrono::steady_clock::time_point readStart = std::chrono::steady_clock::now();
+        const double elapsedSec = std::chrono::duration<double>(readStart - startTime).count();
+
+        if (elapsedSec >= WARMUP_SEC + secPerSetting)
+        {
+          break;
+        }
+
+        std::memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_RX_NOW;
+
+        status = bladerf_sync_rx(dev, iq.data(), READ_SAMPLES*NUM_CHANNELS, &meta, result.params.timeoutMs);
+
+        const double thisReadSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - readStart).count();
+
+        if (elapsedSec < WARMUP_SEC)
+        {
+          continue;
+        }
+
+        result.numReads++;
+        result.numErrors += (status != 0);
+        result.numOverruns += (status == 0 && (meta.status & BLADERF_META_STATUS_OVERRUN));
+        totalReadSec += thisReadSec;
+        result.maxReadSec = std::max(result.maxReadSec, thisReadSec);
+      }
+
+      for (std::uint32_t ch = 0; ch < NUM_CHANNELS; ch++)
+      {
+        bladerf_enable_module(dev, BLADERF_CHANNEL_RX(ch), false);
+      }
+
+      result.meanReadSec = (result.numReads > 0) ? totalReadSec/result.numReads : 0;
+      results.push_back(result);
+
+      std::cout << std::fixed << std::setprecision(2) << std::setw(7) << bufferSize << " x " << std::setw(2) << numBuffers << " (" << result.bufferedSec*1e3 << " ms buffered): " << result.numOverruns << " overruns, " << result.numErrors << " errors in " << result.numReads << " reads, read mean " << result.meanReadSec*1e3 << " ms, max " << result.maxReadSec*1e3 << " ms (" << readSec*1e3 << " ms of samples)" << std::endl;
+    }
+  }
+
+  // The least buffering that kept up, with room for stalls a few times
+  // longer than the longest seen. Failing that the fewest overruns, with as
+  // much buffering as possible.
+  const auto keptUp = [readSec](const TuningResult &result)
+  {
+    return result.numOverruns == 0 && result.numErrors == 0 && result.bufferedSec >= STALL_HEADROOM*std::max(0.0, result.maxReadSec - readSec);
+  };
+
+  const TuningResult* best = nullptr;
+
+  for (const TuningResult &result : results)
+  {
+    if (result.numReads == 0)
+    {
+      continue;
+    }
+
+    if (best == nullptr)
+    {
+      best = &result;
+    }
+    else if (keptUp(result) != keptUp(*best))
+    {
+      best = keptUp(result) ? &result : best;
+    }
+    else if (keptUp(result))
+    {
+      best = (result.bufferedSec < best->bufferedSec) ? &result : best;
+    }
+    else if (result.numOverruns + result.numErrors != best->numOverruns + best->numErrors)
+    {
+      best = (result.numOverruns + result.numErrors < best->numOverruns + best->numErrors) ? &result : best;
+    }
+    else
+    {
+      best = (result.bufferedSec > best->bufferedSec) ? &result : best;
+    }
+  }
+
+  if (best == nullptr)
+  {
+    std::cout << "No setting streamed at all" << std::endl;
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
+  if (!keptUp(*best))
+  {
+    std::cout << "Warning: no setting kept up, this host or link may not manage this rate" << std::endl;
+  }
+
+  std::cout << "Best: " << best->params.numBuffers << " buffers of " << best->params.bufferSize << " samples, " << best->params.numTransfers << " transfers, saved to " << bladeRfSyncTuningPath() << std::endl;
+
+  if (!saveBladeRfSyncParams(dev, format, NUM_CHANNELS, receivedSampleRate, best->params))
+  {
+    bladerf_close(dev);
+    return __LINE__;
+  }
+
+  bladerf_close(dev);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,348 @@
+#include "IqPacket.h"
+#include "IqFile.h"
+#include "Pdw.h"
+#include "PdwFile.h"
+#include "Channelizer.h"
+#include "NoiseFloorEstimator.h"
+#include "CfarDetector.h"
+#include "StreamingPdwExtractor.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Recording
+{
+  std::string filename;
+  IqPacket packet;
+};
+
+const float SAMP_MAX = 0.9999;
+const double CFAR_WINDOW_SEC = 300e-6; // length of the CFAR training and guard windows, must be longer than the longest pulse expected
+const double MAX_ANALYZED_PULSE_SEC = 1e-3; // longest stretch of a pulse the intrapulse analysis looks at
+const float TRAILING_EDGE_SNR_DB = 3; // a pulse ends once it drops to this far above the noise
+const std::size_t BLOCK_SIZE = 65536;
+const std::size_t READ_SIZE = 1 << 20; // samples read from a recording at a time
+
+// Generates the PDWs of one stream of samples, either the whole recording or
+// one channelizer bin, as the samples are read. The CFAR threshold of a block
+// needs the reference cells on either side of it, so the samples are held in
+// a window reaching that far either side of the block being extracted. The
+// noise floor is the median of the whole stream, which isn't known until the
+// end, so SNRs are measured against 1 and corrected once it is.
+class PdwStream
+{
+public:
+  PdwStream(const double fs, const double fc, const double startTime, const float snrThresholdDb, const std::uint16_t bin) :
+    cfarCells(std::max<std::size_t>(fs*CFAR_WINDOW_SEC, 1)),
+    cfar(cfarCells, cfarCells, snrThresholdDb),
+    extractor(fs, fc, SAMP_MAX, bin),
+    windowStart(0),
+    nextBlock(0),
+    thresholdPower(BLOCK_SIZE)
+  {
+    // The trailing edge is declared TRAILING_EDGE_SNR_DB above the noise
+    // rather than at the leading edge threshold, as the MATLAB create_pdws does
+    const float trailingEdgeRatio = std::pow(10.0f, (TRAILING_EDGE_SNR_DB - snrThresholdDb)/10);
+
+    extractor.enableIntrapulseAnalysis(fs*MAX_ANALYZED_PULSE_SEC);
+    extractor.setTrailingEdgeRatio(trailingEdgeRatio*trailingEdgeRatio);
+    extractor.startStream(startTime);
+  }
+
+  void push(const std::complex<float>* iq, const std::size_t numSamples)
+  {
+    noiseFloor.update(iq, numSamples);
+    window.insert(window.end(), iq, iq + numSamples);
+
+    const std::size_t reach = 2*cfarCells;
+
+    while (windowStart + window.size() >= nextBlock + BLOCK_SIZE + reach)
+    {
+      extractBlock(BLOCK_SIZE);
+    }
+
+    // Only the reference cells before the next block are still needed
+    const std::size_t keepFrom = std::max(nextBlock, std::uint64_t(reach)) - reach;
+
+    if (keepFrom > windowStart)
+    {
+      window.erase(window.begin(), window.begin() + (keepFrom - windowStart));
+      windowStart = keepFrom;
+    }
+  }
+
+  // Extract what's left at the end of the stream and append every PDW to pdws
+  void finish(std::vector<Pdw> &pdws)
+  {
+    while (nextBlock < windowStart + window.size())
+    {
+      extractBlock(std::min<std::uint64_t>(BLOCK_SIZE, windowStart + window.size() - nextBlock));
+    }
+
+    // Find the median magnitude value and set that as the noise floor
+    const float noiseFloorDb = 10*std::log10(noiseFloor.median());
+
+    for (Pdw &pdw : streamPdws)
+    {
+      pdw.snrDb -= noiseFloorDb;
+    }
+
+    pdws.insert(pdws.end(), streamPdws.begin(), streamPdws.end());
+  }
+
+private:
+  void extractBlock(const std::size_t blockLength)
+  {
+    cfar.computeThreshold(window.data(), window.size(), nextBlock - windowStart, blockLength, thresholdPower.data());
+    extractor.process(&window[nextBlock - windowStart], blockLength, nextBlock, thresholdPower.data(), 1, streamPdws);
+
+    nextBlock += blockLength;
+  }
+
+  std::size_t cfarCells;
+  CfarDetector cfar;
+  StreamingPdwExtractor extractor;
+  NoiseFloorEstimator noiseFloor;
+  std::vector<std::complex<float>> window;
+  std::uint64_t windowStart; // stream index of window[0]
+  std::uint64_t nextBlock;   // stream index of the next sample to extract
+  std::vector<float> thresholdPower;
+  std::vector<Pdw> streamPdws;
+};
+
+// Stream a recording through, optionally channelizing it, and generate its PDWs in TOA order
+bool processRecording(const Recording &recording, const std::size_t numBins, const std::uint32_t epochSec, std::vector<Pdw> &pdws)
+{
+  IqPacket packet;
+  IqFileReader reader;
+
+  if (!reader.open(recording.filename, packet))
+  {
+    return false;
+  }
+
+  const double fs = packet.sampleRateSps;
+  const double fc = packet.frequencyHz;
+  const double startTime = packet.sampleStartTime - epochSec;
+  std::vector<std::complex<float>> iq(READ_SIZE);
+  std::size_t numRead = 0;
+  std::uint64_t totalRead = 0;
+
+  if (numBins <= 1)
+  {
+    PdwStream stream(fs, fc, startTime, 18, 0);
+
+    while ((numRead = reader.read(iq.data(), iq.size())) > 0)
+    {
+      stream.push(iq.data(), numRead);
+      totalRead += numRead;
+    }
+
+    stream.finish(pdws);
+  }
+  else
+  {
+    // Channelize the data in to numBins bands, each decimated by numBins
+    Channelizer channelizer(numBins);
+    const std::size_t maxSamplesPerBin = channelizer.maxOutputSamples(iq.size());
+    std::vector<std::complex<float>> channelized(numBins*maxSamplesPerBin);
+
+    const double binFs = fs/numBins; // This is the new decimated sampling rate
+    const double binStartTime = startTime + channelizer.outputTimeOffset()/fs;
+    std::vector<PdwStream> streams;
+
+    streams.reserve(numBins);
+
+    for (std::size_t bin = 0; bin < numBins; bin++)
+    {
+      const double binFc = fc + channelizer.binOffset(bin)*fs; // frequency in hz for this bin
+
+      streams.emplace_back(binFs, binFc, binStartTime, 15, bin);
+    }
+
+    while ((numRead = reader.read(iq.data(), iq.size())) > 0)
+    {
+      const std::size_t samplesPerBin = channelizer.process(iq.data(), numRead, channelized.data(), maxSamplesPerBin);
+
+      for (std::size_t bin = 0; bin < numBins; bin++)
+      {
+        streams[bin].push(&channelized[bin*maxSamplesPerBin], samplesPerBin);
+      }
+
+      totalRead += numRead;
+    }
+
+    for (PdwStream &stream : streams)
+    {
+      stream.finish(pdws);
+    }
+
+    std::stable_sort(pdws.begin(), pdws.end(), [](const Pdw &a, const Pdw &b) { return a.toa < b.toa; });
+  }
+
+  return totalRead > 0;
+}
+
+int main(const int argc, const char *argv[])
+{
+  if (argc < 3 || argc > 5)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <iqDirectory> <pdwFile> [numChannelizerBins] [numThreads]" << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const std::string iqDirectory = argv[1];
+  const std::string pdwFilename = argv[2];
+  const std::size_t numBins = (argc > 3) ? atoi(argv[3]) : 1;
+  const std::size_t numThreads = (argc > 4) ? atoi(argv[4]) : std::thread::hardware_concurrency();
+
+  // Find every recording in the directory and sort them by the time of their first sample
+
+  std::vector<Recording> recordings;
+  std::error_code ec;
+
+  for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(iqDirectory, ec))
+  {
+    if (entry.is_regular_file() && entry.path().extension() == ".iq")
+    {
+      Recording recording;
+      recording.filename = entry.path().string();
+
+      if (readIqHeader(recording.filename, recording.packet))
+      {
+        recordings.push_back(recording);
+      }
+      else
+      {
+        std::cout << "Skipping " << recording.filename << ", unreadable header" << std::endl;
+      }
+    }
+  }
+
+  if (ec)
+  {
+    std::cout << "Unable to read " << iqDirectory << ": " << ec.message() << std::endl;
+    return __LINE__;
+  }
+
+  std::sort(recordings.begin(), recordings.end(), [](const Recording &a, const Recording &b) { return a.packet.sampleStartTime < b.packet.sampleStartTime; });
+
+  std::cout << "Found " << recordings.size() << " recordings" << std::endl;
+
+  // TOAs are kept from the start of the first recording's second, where a
+  // double still resolves well under a sample
+  const std::uint32_t epochSec = recordings.empty() ? 0 : std::floor(recordings[0].packet.sampleStartTime);
+
+  PdwFileWriter pdwFile;
+
+  if (!pdwFile.open(pdwFilename, epochSec))
+  {
+    std::cout << "Failed to open " << pdwFilename << std::endl;
+    return __LINE__;
+  }
+
+  // Process the recordings in parallel and hand each one's PDWs back to this
+  // thread, which writes them out in TOA order
+
+  std::vector<std::vector<Pdw>> results(recordings.size());
+  std::vector<bool> done(recordings.size(), false);
+  std::mutex resultsMutex;
+  std::condition_variable resultReady;
+
+  const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+  ThreadPool pool(numThreads);
+
+  std::cout << "Processing with " << pool.size() << " threads" << std::endl;
+
+  for (std::size_t ii = 0; ii < recordings.size(); ii++)
+  {
+    pool.submit([&, ii]
+    {
+      std::vector<Pdw> pdws;
+
+      if (!processRecording(recordings[ii], numBins, epochSec, pdws))
+      {
+        std::cout << "Failed to read " << recordings[ii].filename << std::endl;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        results[ii] = std::move(pdws);
+        done[ii] = true;
+      }
+
+      resultReady.notify_all();
+    });
+  }
+
+  // Recordings from several radios can overlap in time, so PDWs are held
+  // back until no later recording could have an earlier one
+  std::vector<Pdw> pending;
+  std::vector<Pdw> merged;
+
+  for (std::size_t ii = 0; ii < recordings.size(); ii++)
+  {
+    std::vector<Pdw> pdws;
+
+    {
+      std::unique_lock<std::mutex> lock(resultsMutex);
+      resultReady.wait(lock, [&] { return done[ii]; });
+      pdws = std::move(results[ii]);
+    }
+
+    std::cout << "Generated " << pdws.size() << " PDWs from " << recordings[ii].filename << std::endl;
+
+    merged.clear();
+    std::merge(pending.begin(), pending.end(), pdws.begin(), pdws.end(), std::back_inserter(merged), [](const Pdw &a, const Pdw &b) { return a.toa < b.toa; });
+
+    std::vector<Pdw>::iterator safe = merged.end();
+
+    if (ii + 1 < recordings.size())
+    {
+      const double nextStartTime = recordings[ii+1].packet.sampleStartTime - epochSec;
+      safe = std::lower_bound(merged.begin(), merged.end(), nextStartTime, [](const Pdw &a, const double t) { return a.toa < t; });
+    }
+
+    for (std::vector<Pdw>::iterator it = merged.begin(); it != safe; ++it)
+    {
+      if (!pdwFile.write(*it))
+      {
+        std::cout << "Failed writing to " << pdwFilename << std::endl;
+        pool.wait();
+        return __LINE__;
+      }
+    }
+
+    pending.assign(safe, merged.end());
+  }
+
+  pool.wait();
+
+  const std::uint64_t numPdws = pdwFile.size();
+
+  if (!pdwFile.close())
+  {
+    std::cout << "Failed writing to " << pdwFilename << std::endl;
+    return __LINE__;
+  }
+
+  const double elapsedSec = (std::chrono::steady_clock::now() - startTime) / std::chrono::milliseconds(1) * 1e-3;
+
+  std::cout << "Saved " << numPdws << " PDWs to " << pdwFilename << " in " << elapsedSec << " sec" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include "Pdw.h"
+#include "PdwFile.h"
+#include "Deinterleaver.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+const double EMITTER_FREQ_TOLERANCE = 1e6; // Hz
+const double EMITTER_PW_TOLERANCE = 0.2; // fraction of the pulse width
+const double MAX_PRI = 10e-3; // sec
+const double PRI_RESOLUTION = 1e-6; // sec
+const std::size_t MIN_EMITTER_PDWS = 10; // emitters with fewer PDWs than this aren't listed
+
+int main(const int argc, const char *argv[])
+{
+  if (argc < 2 || argc > 3)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <pdwFile> [numThreads]" << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const std::string pdwFilename = argv[1];
+  const std::size_t numThreads = (argc > 2) ? atoi(argv[2]) : std::thread::hardware_concurrency();
+
+  PdwFileReader pdwFile;
+
+  if (!pdwFile.open(pdwFilename))
+  {
+    std::cout << "Failed to open " << pdwFilename << std::endl;
+    return __LINE__;
+  }
+
+  if (pdwFile.truncated())
+  {
+    std::cout << pdwFilename << " ends in a partly written block, only the " << pdwFile.size() << " PDWs before it can be read" << std::endl;
+  }
+
+  std::cout << "Deinterleaving " << pdwFile.size() << " PDWs from " << pdwFilename << std::endl;
+
+  const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+  // Feed the PDWs through a block at a time, searching the clusters for
+  // pulse trains in parallel after each block
+  ThreadPool pool(numThreads);
+  Deinterleaver deinterleaver(EMITTER_FREQ_TOLERANCE, EMITTER_PW_TOLERANCE, MAX_PRI, PRI_RESOLUTION);
+
+  for (std::size_t ii = 0; ii < pdwFile.numBlocks(); ii++)
+  {
+    const PdwBlockView block = pdwFile.block(ii);
+
+    for (std::size_t jj = 0; jj < block.numPdws; jj++)
+    {
+      deinterleaver.add(block.at(jj));
+    }
+
+    deinterleaver.update(&pool);
+  }
+
+  const double elapsedSec = (std::chrono::steady_clock::now() - startTime) / std::chrono::milliseconds(1) * 1e-3;
+
+  std::vector<Emitter> emitters = deinterleaver.emitters();
+  std::sort(emitters.begin(), emitters.end(), [](const Emitter &a, const Emitter &b) { return a.numPdws > b.numPdws; });
+
+  std::cout << "Found " << emitters.size() << " emitters in " << elapsedSec << " sec" << std::endl;
+  std::cout << std::endl << "ID\tFreq (MHz)\tPW (us)\tPRI (us)\tPDWs" << std::endl;
+
+  for (const Emitter &emitter : emitters)
+  {
+    if (emitter.numPdws < MIN_EMITTER_PDWS)
+    {
+      continue;
+    }
+
+    std::cout << emitter.id << "\t" << std::fixed << std::setprecision(3) << emitter.freqHz*1e-6 << "\t" << emitter.pwSec*1e6 << "\t";
+
+    if (emitter.priSec > 0)
+    {
+      std::cout << emitter.priSec*1e6;
+    }
+    else
+    {
+      std::cout << "-";
+    }
+
+    std::cout << "\t" << emitter.numPdws << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,351 @@
+#include <uhd/utils/safe_main.hpp>
+
+#include "IqPacket.h"
+#include "Helper.h"
+#include "RadioDevice.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "ThreadConfig.h"
+#include "PipelineMetrics.h"
+#include "PipelineTrace.h"
+#include "AsyncLog.h"
+
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <complex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+const std::size_t BUFFERS_PER_DEVICE = 4; // dwells a device can have waiting on the writers
+const double SLOT_GUARD_SEC = 50e-3; // gap between dwells for the next request to reach the devices
+const double SCHEDULE_LEAD_SEC = 20e-3; // least time ahead a dwell is asked for
+const double START_DELAY_SEC = 2; // time from syncing the devices to the first dwell
+const double CLOCK_TRACK_SEC = 10; // how often each device's clock is measured against the host clock
+
+// One radio and everything its receive thread owns. Buffers go from the
+// receive thread to a writer and back to the pool.
+struct DeviceContext
+{
+  std::string spec;
+  std::unique_ptr<RadioDevice> device;
+  IqPacket packet;
+  ThreadPlacement placement; // of the receive thread, one CPU of the RX placement if it has any
+
+  std::unique_ptr<BufferPool> pool;
+
+  std::uint32_t dwellCounter = 0;
+  std::uint32_t writtenCounter = 0;
+  std::uint32_t missedCounter = 0;
+  std::uint32_t overrunCounter = 0;
+  double lastDriftSec = 0; // of the device clock from the host clock
+  double maxDriftSec = 0;
+};
+
+std::chrono::system_clock::time_point toTimePoint(const double utcSecs)
+{
+  return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(utcSecs)));
+}
+
+// Every device records the same slots of the shared timebase, so dwells of
+// different devices with the same slot start together and their files get
+// the same name. A device that falls behind skips to the next slot it can
+// still make rather than drifting out of step.
+void receiveDwells(DeviceContext &ctx, const std::size_t deviceIndex, ThreadPool &writers, PipelineMetrics &metrics, const double firstSlotSecs, const double slotPeriodSec, const double endTimeSecs, const std::size_t requestedNumSamples, const std::int32_t FILTER_DELAY)
+{
+  nameTraceThread("RX");
+  applyThreadPlacement("RX", ctx.placement);
+
+  // Allocated from here, once pinned, so the buffers are on this CPU's NUMA node
+  ctx.pool = std::make_unique<BufferPool>(requestedNumSamples*sizeof(std::complex<std::int16_t>), BUFFERS_PER_DEVICE);
+  ctx.pool->preallocate();
+
+  const std::double_t filterDelaySecs = FILTER_DELAY*1.0/ctx.packet.sampleRateSps;
+  std::uint64_t slot = 0;
+  double nextClockTrackSecs = firstSlotSecs + CLOCK_TRACK_SEC;
+
+  while (true)
+  {
+    const double earliestSecs = ctx.device->timeNow() + SCHEDULE_LEAD_SEC;
+    const std::uint64_t nextSlot = std::max<std::uint64_t>(slot, std::max(0.0, std::ceil((earliestSecs - firstSlotSecs)/slotPeriodSec)));
+
+    if (nextSlot > slot)
+    {
+      traceInstant("missed slot");
+    }
+
+    ctx.missedCounter += nextSlot - slot;
+    slot = nextSlot;
+
+    const double slotStartSecs = firstSlotSecs + slot*slotPeriodSec;
+
+    if (slotStartSecs > endTimeSecs)
+    {
+      break;
+    }
+
+    // A bladeRF's clock is only mapped onto UTC from the host clock, so it's
+    // mapped again every so often before its oscillator takes it out of step
+    // with the other devices
+    if (slotStartSecs >= nextClockTrackSecs)
+    {
+      if (ctx.device->trackHostClock(ctx.lastDriftSec) == 0)
+      {
+        ctx.maxDriftSec = std::max(ctx.maxDriftSec, std::abs(ctx.lastDriftSec));
+        logAsync("Device {} clock is {} us from the host clock", deviceIndex, ctx.lastDriftSec*1e6);
+      }
+
+      nextClockTrackSecs = slotStartSecs + CLOCK_TRACK_SEC;
+    }
+
+    // Waits for a writer to finish with one if they're all in use
+    const std::uint64_t acquireStart = readTsc();
+    std::complex<std::int16_t>* iq = ctx.pool->acquire<std::complex<std::int16_t>>();
+
+    traceSince("acquire", acquireStart);
+
+    if (iq == nullptr)
+    {
+      break;
+    }
+
+    double sampleStartTime = 0;
+    bool overrun = false;
+
+    const std::uint64_t recvStart = readTsc();
+    const std::size_t numReceived = ctx.device->receive(iq, requestedNumSamples, slotStartSecs, sampleStartTime, overrun);
+
+    metrics.recv.recordSince(recvStart);
+    traceSince("recv", recvStart);
+    const std::uint64_t processStart = readTsc();
+
+    ctx.dwellCounter++;
+    ctx.overrunCounter += overrun;
+    metrics.dwells++;
+    metrics.overruns += overrun;
+    slot++;
+
+    if (overrun)
+    {
+      traceInstant("overrun");
+    }
+
+    if (numReceived != requestedNumSamples)
+    {
+      metrics.shortReads++;
+      ctx.pool->release(iq);
+      continue;
+    }
+
+    ctx.writtenCounter++;
+
+    IqPacket header = ctx.packet;
+    header.numSamples = requestedNumSamples - FILTER_DELAY;
+    header.sampleStartTime = sampleStartTime + filterDelaySecs;
+
+    writers.submit([&ctx, &metrics, header, iq, slotStartSecs, deviceIndex, FILTER_DELAY]()
+    {
+      const std::uint64_t writeStart = readTsc();
+      char filenameStr[FILENAME_LENGTH];
+      char extension[16];
+
+      snprintf(extension, sizeof(extension), "dev%zu.iq", deviceIndex);
+      getFilenameStr(toTimePoint(slotStartSecs), filenameStr, FILENAME_LENGTH, extension);
+
+      std::ofstream fout(filenameStr, std::ofstream::binary);
+      fout.write((const char*)&header, sizeof(header));
+      fout.write((const char*)&iq[FILTER_DELAY], header.numSamples*sizeof(std::complex<std::int16_t>));
+      fout.close();
+
+      metrics.write.recordSince(writeStart);
+      traceSince("write", writeStart);
+      ctx.pool->release(iq);
+    });
+
+    // All there is to a dwell here is handing it over
+    metrics.process.recordSince(processStart);
+    traceSince("process", processStart);
+  }
+}
+
+int UHD_SAFE_MAIN(int argc, char *argv[])
+{
+  const int numPositionalArgs = countPositionalArgs(argc, argv);
+
+  if (numPositionalArgs < 9)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec> <durationSec> <filter delay> <device> [<device>...] [--timebase=<host|pps>] [--writers=<N>] [--metrics=<file>] [--trace=<file>] [--rx-threads=<cpus>[:<priority>]] [--writer-threads=<cpus>[:<priority>]]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\tRecords dwells from several radios at once, each device being" << std::endl;
+    std::cout << "\tblade[:<serial>] or usrp[:<UHD args>], optionally followed by" << std::endl;
+    std::cout << "\t@<freqMhz> to tune it somewhere other than freqMhz. Dwells are" << std::endl;
+    std::cout << "\ttimed on a shared timebase so every device records the same" << std::endl;
+    std::cout << "\tinstants, written as <time>.dev<N>.iq. Each receive thread gets" << std::endl;
+    std::cout << "\tone of the RX CPUs in turn, and is left unpinned without any." << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const double frequencyMhz = atof(argv[1]);
+  const std::uint32_t requestedBandwidthHz = atof(argv[2])*1e6;
+  const std::uint32_t requestedSampleRateSps = atof(argv[3])*1e6;
+  const float requestedRxGainDb = atof(argv[4]);
+  const float dwellDurationSec = atof(argv[5]);
+  const float collectionDurationSec = atof(argv[6]);
+  const std::int32_t FILTER_DELAY = atoi(argv[7]); // Number of initial zero'd samples induced by filter delay
+  const char* timebaseOption = findOption(argc, argv, "timebase"); // pps lines the devices up on a shared PPS input
+  const char* writersOption = findOption(argc, argv, "writers"); // Threads writing dwells to disk
+  const char* metricsOption = findOption(argc, argv, "metrics"); // Optionally export stage times and error counts to this Prometheus text file
+  const char* traceOption = findOption(argc, argv, "trace"); // Optionally record a timeline of every stage to this Chrome trace JSON file
+
+  const bool usePps = (timebaseOption != nullptr && strcmp(timebaseOption, "pps") == 0);
+
+  if (timebaseOption != nullptr && !usePps && strcmp(timebaseOption, "host") != 0)
+  {
+    std::cout << "Timebase has to be host or pps" << std::endl;
+    return __LINE__;
+  }
+
+  ThreadConfig threads;
+
+  if (!parseThreadConfig(argc, argv, threads))
+  {
+    return __LINE__;
+  }
+
+  // The threads the libraries start when the devices are opened inherit this
+  applyThreadPlacement("RX", threads.rx);
+
+  // Open and tune every device before starting any of them
+
+  std::vector<std::unique_ptr<DeviceContext>> contexts;
+
+  for (int ii = 8; ii < numPositionalArgs; ii++)
+  {
+    std::unique_ptr<DeviceContext> ctx = std::make_unique<DeviceContext>();
+    std::memset(&ctx->packet, 0, sizeof(ctx->packet));
+
+    ctx->spec = argv[ii];
+    ctx->device = makeRadioDevice(ctx->spec);
+
+    if (!ctx->device || ctx->device->open() != 0)
+    {
+      return __LINE__;
+    }
+
+    // Without RX CPUs the receive threads are left where the scheduler puts
+    // them, as pinning them would leave the writer, log and metrics threads
+    // free to run on the same CPUs
+    ctx->placement = threads.rx;
+
+    if (!threads.rx.cpus.empty())
+    {
+      ctx->placement.cpus = {threads.rx.cpus[contexts.size() % threads.rx.cpus.size()]};
+    }
+
+    const std::size_t at = ctx->spec.find('@');
+
+    RadioSettings settings;
+    settings.frequencyHz = ((at == std::string::npos) ? frequencyMhz : atof(&ctx->spec[at + 1]))*1e6;
+    settings.bandwidthHz = requestedBandwidthHz;
+    settings.sampleRateSps = requestedSampleRateSps;
+    settings.rxGainDb = requestedRxGainDb;
+
+    if (ctx->device->configure(settings, ctx->packet) != 0)
+    {
+      return __LINE__;
+    }
+
+    contexts.push_back(std::move(ctx));
+  }
+
+  // Put every device on the shared timebase
+
+  for (std::unique_ptr<DeviceContext> &ctx : contexts)
+  {
+    if (ctx->device->syncTime(usePps) != 0 || ctx->device->start() != 0)
+    {
+      return __LINE__;
+    }
+  }
+
+  std::cout << "Synced " << contexts.size() << " devices to the " << (usePps ? "PPS" : "host clock") << std::endl;
+
+  // Devices can have been given different sample rates than were asked
+  // for, so each gets the number of samples that makes up the dwell for it,
+  // and the longest sets the slot period
+
+  // Shared by every device, and outlives the writers that record into it
+  PipelineMetrics metrics("multi_record_iq", dwellDurationSec);
+
+  if (metricsOption != nullptr && !metrics.startExport(metricsOption))
+  {
+    return __LINE__;
+  }
+
+  if (traceOption != nullptr)
+  {
+    startTrace();
+  }
+
+  ThreadPool writers(writersOption != nullptr ? atoi(writersOption) : 2, [&threads] { nameTraceThread("Writer", TRACE_POOL_EVENTS); applyThreadPlacement("Writer", threads.writer); });
+  double longestDwellSec = 0;
+  std::vector<std::size_t> requestedNumSamples;
+
+  for (std::unique_ptr<DeviceContext> &ctx : contexts)
+  {
+    requestedNumSamples.push_back(dwellDurationSec*ctx->packet.sampleRateSps + FILTER_DELAY);
+    longestDwellSec = std::max(longestDwellSec, requestedNumSamples.back()*1.0/ctx->packet.sampleRateSps);
+  }
+
+  const double slotPeriodSec = longestDwellSec + SLOT_GUARD_SEC;
+  const double firstSlotSecs = std::floor(contexts[0]->device->timeNow()) + START_DELAY_SEC;
+  const double endTimeSecs = firstSlotSecs + collectionDurationSec;
+
+  std::cout << "Recording a dwell every " << slotPeriodSec << " s from " << std::setprecision(15) << firstSlotSecs << std::setprecision(6) << " with " << writers.size() << " writers" << std::endl;
+
+  // The devices' messages from the receive threads are written out on a
+  // background thread, so a slow console can't hold up a dwell
+  startAsyncLog();
+
+  std::vector<std::thread> receivers;
+
+  for (std::size_t ii = 0; ii < contexts.size(); ii++)
+  {
+    receivers.emplace_back(receiveDwells, std::ref(*contexts[ii]), ii, std::ref(writers), std::ref(metrics), firstSlotSecs, slotPeriodSec, endTimeSecs, requestedNumSamples[ii], FILTER_DELAY);
+  }
+
+  for (std::thread &receiver : receivers)
+  {
+    receiver.join();
+  }
+
+  writers.wait();
+  flushAsyncLog();
+
+  for (std::size_t ii = 0; ii < contexts.size(); ii++)
+  {
+    DeviceContext &ctx = *contexts[ii];
+
+    ctx.device->stop();
+
+    std::cout << "Device " << ii << " (" << ctx.spec << ", " << (ctx.placement.cpus.empty() ? std::string("unpinned") : "CPU " + std::to_string(ctx.placement.cpus[0])) << "): wrote " << ctx.writtenCounter << " of " << ctx.dwellCounter << " dwells, missed " << ctx.missedCounter << " slots, " << ctx.overrunCounter << " overruns, clock up to " << ctx.maxDriftSec*1e6 << " us from the host clock." << std::endl;
+  }
+
+  metrics.printSummary();
+
+  if (traceOption != nullptr)
+  {
+    writeTrace(traceOption);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,379 @@
+#include <uhd/utils/safe_main.hpp>
+
+#include "IqPacket.h"
+#include "Helper.h"
+#include "RadioDevice.h"
+#include "ControlSocket.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "ThreadConfig.h"
+#include "PipelineMetrics.h"
+#include "PipelineTrace.h"
+#include "AsyncLog.h"
+
+#include <sys/socket.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <cmath>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <complex>
+#include <memory>
+#include <sstream>
+#include <string>
+
+const double SCHEDULE_LEAD_SEC = 20e-3; // least time ahead a dwell is asked for
+const double CLIENT_TIMEOUT_SEC = 5; // longest a client can keep the daemon waiting to read or write a line
+
+volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int)
+{
+  stopRequested = 1;
+}
+
+std::chrono::system_clock::time_point toTimePoint(const double utcSecs)
+{
+  return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(utcSecs)));
+}
+
+bool operator==(const RadioSettings &a, const RadioSettings &b)
+{
+  return a.frequencyHz == b.frequencyHz && a.bandwidthHz == b.bandwidthHz && a.sampleRateSps == b.sampleRateSps && a.rxGainDb == b.rxGainDb;
+}
+
+// The device and everything about it that outlives a job
+struct DaemonState
+{
+  std::unique_ptr<RadioDevice> device;
+  IqPacket packet;
+  RadioSettings settings;
+  bool configured;
+  bool usePps;
+  std::unique_ptr<BufferPool> pool; // two dwells, one being received while the other is written
+  PipelineMetrics metrics; // of every job since the daemon started
+  std::string outputDir;   // every job's files are written here, the working directory
+  ThreadPool writer;
+
+  DaemonState(const ThreadPlacement &writerPlacement) : configured(false), usePps(false), metrics("recorder_daemon", 0), writer(1, [writerPlacement] { nameTraceThread("Writer", TRACE_POOL_EVENTS); applyThreadPlacement("Writer", writerPlacement); }) {}
+};
+
+// Runs one "record <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec>
+// <durationSec> <filter delay>" job, the same arguments as the recorders. The
+// device is only retuned if the settings differ from the last job's. Dwells
+// alternate between two pooled buffers, kept from job to job while the dwell
+// size stays the same, so one can be written while the next is received.
+void runJob(DaemonState &state, const std::string &job, ControlConnection &client)
+{
+  std::istringstream words(job);
+  std::string command;
+  double frequencyMhz, bandwidthMhz, sampleRateMsps, gainDb, dwellDurationSec, collectionDurationSec;
+  std::int32_t FILTER_DELAY;
+
+  if (!(words >> command >> frequencyMhz >> bandwidthMhz >> sampleRateMsps >> gainDb >> dwellDurationSec >> collectionDurationSec >> FILTER_DELAY) || command != "record")
+  {
+    client.writeLine("error expected record <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec> <durationSec> <filter delay>");
+    return;
+  }
+
+  RadioSettings settings;
+  settings.frequencyHz = frequencyMhz*1e6;
+  settings.bandwidthHz = bandwidthMhz*1e6;
+  settings.sampleRateSps = sampleRateMsps*1e6;
+  settings.rxGainDb = gainDb;
+
+  if (!state.configured || !(settings == state.settings))
+  {
+    TraceScope trace("retune");
+    const std::chrono::steady_clock::time_point configureStart = std::chrono::steady_clock::now();
+
+    if (state.configured)
+    {
+      state.device->stop();
+      state.configured = false;
+    }
+
+    if (state.device->configure(settings, state.packet) != 0 || state.device->syncTime(state.usePps) != 0 || state.device->start() != 0)
+    {
+      client.writeLine("error failed to configure the device, see the daemon's output");
+      return;
+    }
+
+    state.settings = settings;
+    state.configured = true;
+
+    client.writeLine("Configured in " + std::to_string((std::chrono::steady_clock::now() - configureStart) / std::chrono::milliseconds(1)) + " ms");
+  }
+  else
+  {
+    // The device clock has had since the last job to drift, and a bladeRF's
+    // is only mapped onto UTC from the host clock
+    double driftSec = 0;
+
+    if (state.device->trackHostClock(driftSec) != 0)
+    {
+      client.writeLine("error failed to read the device clock, see the daemon's output");
+      return;
+    }
+
+    client.writeLine("Reusing the configuration of the last job, device clock " + std::to_string(driftSec*1e6) + " us from the host clock");
+  }
+
+  const std::size_t requestedNumSamples = dwellDurationSec*state.packet.sampleRateSps + FILTER_DELAY;
+  const std::double_t filterDelaySecs = FILTER_DELAY*1.0/state.packet.sampleRateSps;
+
+  const std::size_t bufferBytes = requestedNumSamples*sizeof(std::complex<std::int16_t>);
+
+  if (!state.pool || state.pool->blockBytes() != bufferBytes)
+  {
+    state.pool = std::make_unique<BufferPool>(bufferBytes, 2);
+    state.pool->preallocate();
+  }
+
+  state.metrics.setDwellBudget(dwellDurationSec);
+
+  const double startTimeSecs = state.device->timeNow();
+  std::uint32_t dwellCounter = 0;
+  std::uint32_t writtenCounter = 0;
+  std::uint32_t overrunCounter = 0;
+
+  while (state.device->timeNow() - startTimeSecs <= collectionDurationSec && !stopRequested)
+  {
+    // Waits for the writer if it still has both buffers
+    const std::uint64_t acquireStart = readTsc();
+    std::complex<std::int16_t>* iq = state.pool->acquire<std::complex<std::int16_t>>();
+
+    traceSince("acquire", acquireStart);
+
+    if (iq == nullptr)
+    {
+      break;
+    }
+
+    double sampleStartTime = 0;
+    bool overrun = false;
+
+    const std::uint64_t recvStart = readTsc();
+    const std::size_t numReceived = state.device->receive(iq, requestedNumSamples, state.device->timeNow() + SCHEDULE_LEAD_SEC, sampleStartTime, overrun);
+
+    state.metrics.recv.recordSince(recvStart);
+    traceSince("recv", recvStart);
+    const std::uint64_t processStart = readTsc();
+
+    dwellCounter++;
+    overrunCounter += overrun;
+    state.metrics.dwells++;
+    state.metrics.overruns += overrun;
+
+    if (overrun)
+    {
+      traceInstant("overrun");
+    }
+
+    // Dropped rather than waited for if the client isn't reading them
+    const std::uint64_t reportStart = readTsc();
+    const bool clientConnected = client.offerLine("Received " + std::to_string(numReceived));
+
+    traceSince("report", reportStart);
+
+    if (numReceived != requestedNumSamples)
+    {
+      state.metrics.shortReads++;
+    }
+
+    if (numReceived != requestedNumSamples || !clientConnected)
+    {
+      state.pool->release(iq);
+
+      if (!clientConnected)
+      {
+        logAsync("Client went away, abandoning its job");
+        break;
+      }
+
+      continue;
+    }
+
+    writtenCounter++;
+
+    IqPacket header = state.packet;
+    header.numSamples = requestedNumSamples - FILTER_DELAY;
+    header.sampleStartTime = sampleStartTime + filterDelaySecs;
+
+    BufferPool* pool = state.pool.get();
+    PipelineMetrics* metrics = &state.metrics;
+
+    state.writer.submit([header, iq, pool, metrics, FILTER_DELAY]()
+    {
+      const std::uint64_t writeStart = readTsc();
+      char filenameStr[FILENAME_LENGTH];
+
+      getFilenameStr(toTimePoint(header.sampleStartTime), filenameStr, FILENAME_LENGTH);
+
+      std::ofstream fout(filenameStr, std::ofstream::binary);
+      fout.write((const char*)&header, sizeof(header));
+      fout.write((const char*)&iq[FILTER_DELAY], header.numSamples*sizeof(std::complex<std::int16_t>));
+      fout.close();
+
+      metrics->write.recordSince(writeStart);
+      traceSince("write", writeStart);
+      pool->release(iq);
+    });
+
+    state.metrics.process.recordSince(processStart);
+    traceSince("process", processStart);
+  }
+
+  state.writer.wait();
+
+  std::string summary = "done Wrote " + std::to_string(writtenCounter) + " of " + std::to_string(dwellCounter) + " dwells to " + state.outputDir + ", " + std::to_string(overrunCounter) + " overruns.";
+
+  if (client.linesDropped() > 0)
+  {
+    summary += " " + std::to_string(client.linesDropped()) + " progress lines were dropped with the client not reading.";
+  }
+
+  client.writeLine(summary);
+}
+
+int UHD_SAFE_MAIN(int argc, char *argv[])
+{
+  if (countPositionalArgs(argc, argv) != 3)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <device> <socketPath> [--fpga=<rbf>] [--timebase=<host|pps>] [--metrics=<file>] [--trace=<file>] [--rx-threads=<cpus>[:<priority>]] [--writer-threads=<cpus>[:<priority>]]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\tKeeps blade[:<serial>] or usrp[:<UHD args>] open and records the" << std::endl;
+    std::cout << "\tjobs sent to socketPath, e.g. by a recorder run with --daemon=." << std::endl;
+    std::cout << "\tThe device is only retuned when a job's settings change, and" << std::endl;
+    std::cout << "\tthe files are written into the daemon's working directory." << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const char* fpgaOption = findOption(argc, argv, "fpga"); // FPGA image loaded once instead of by loadFpgaA5 or loadFpgaA9
+  const char* timebaseOption = findOption(argc, argv, "timebase"); // pps sets the device time on a PPS edge
+  const char* metricsOption = findOption(argc, argv, "metrics"); // Optionally export stage times and error counts of every job to this Prometheus text file
+  const char* traceOption = findOption(argc, argv, "trace"); // Optionally record a timeline of every stage of every job to this Chrome trace JSON file, written at shutdown
+
+  ThreadConfig threads;
+
+  if (!parseThreadConfig(argc, argv, threads))
+  {
+    return __LINE__;
+  }
+
+  // Jobs are received on this thread, and the device's library threads
+  // inherit its placement when it's opened
+  applyThreadPlacement("RX", threads.rx);
+
+  // Started before the writer so its thread gets its events up front too
+  if (traceOption != nullptr)
+  {
+    startTrace();
+    nameTraceThread("RX");
+  }
+
+  DaemonState state(threads.writer);
+
+  if (metricsOption != nullptr && !state.metrics.startExport(metricsOption))
+  {
+    return __LINE__;
+  }
+
+  std::memset(&state.packet, 0, sizeof(state.packet));
+  state.usePps = (timebaseOption != nullptr && strcmp(timebaseOption, "pps") == 0);
+  state.device = makeRadioDevice(argv[1], fpgaOption != nullptr ? fpgaOption : "");
+
+  if (!state.device || state.device->open() != 0)
+  {
+    return __LINE__;
+  }
+
+  const std::string socketPath = argv[2];
+  const int listenFd = listenControlSocket(socketPath);
+
+  if (listenFd < 0)
+  {
+    return __LINE__;
+  }
+
+  // Without SA_RESTART a signal breaks accept() out so the daemon can shut
+  // the device down cleanly
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  // Messages from the receive loop, the device's included, are written out
+  // on a background thread so a slow console can't hold up a dwell
+  startAsyncLog();
+
+  char cwd[PATH_MAX];
+  state.outputDir = (getcwd(cwd, sizeof(cwd)) != nullptr) ? cwd : ".";
+
+  std::cout << "Listening for jobs on " << socketPath << ", writing recordings to " << state.outputDir << std::endl;
+
+  while (!stopRequested)
+  {
+    const int clientFd = accept(listenFd, nullptr, nullptr);
+
+    if (clientFd < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      std::cout << "Failed to accept a client: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    ControlConnection client(clientFd);
+    std::string job;
+
+    if (!client.setTimeout(CLIENT_TIMEOUT_SEC))
+    {
+      std::cout << "Failed to set the client's timeout: " << strerror(errno) << std::endl;
+      continue;
+    }
+
+    if (client.readLine(job))
+    {
+      std::cout << "Job: " << job << std::endl;
+
+      runJob(state, job, client);
+      flushAsyncLog();
+    }
+    else
+    {
+      std::cout << "Client sent no job" << std::endl;
+    }
+  }
+
+  std::cout << "Shutting down" << std::endl;
+
+  state.metrics.printSummary();
+
+  if (traceOption != nullptr)
+  {
+    writeTrace(traceOption);
+  }
+
+  if (state.configured)
+  {
+    state.device->stop();
+  }
+
+  close(listenFd);
+  unlink(socketPath.c_str());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "SharedIqRing.h"
+
+#include <cmath>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <complex>
+#include <thread>
+
+const double REPORT_PERIOD_SEC = 1;
+const std::chrono::microseconds IDLE_SLEEP(200); // between polls while the ring has nothing new
+
+// Sum of |x|^2 over a block of either sample width
+template <typename T>
+double sumPower(const void* iq, const std::uint32_t numSamples)
+{
+  const std::complex<T>* samples = static_cast<const std::complex<T>*>(iq);
+  double sum = 0;
+
+  for (std::uint32_t ii = 0; ii < numSamples; ii++)
+  {
+    const double re = samples[ii].real();
+    const double im = samples[ii].imag();
+
+    sum += re*re + im*im;
+  }
+
+  return sum;
+}
+
+int main(const int argc, const char *argv[])
+{
+  if (argc < 2 || argc > 3)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <name> [durationSec]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\tFollows the live I/Q a recorder run with --shm=<name> publishes" << std::endl;
+    std::cout << "\tand reports its rate, power and any blocks this reader missed." << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const double durationSec = (argc == 3) ? atof(argv[2]) : INFINITY;
+
+  SharedIqRingReader ring;
+
+  if (!ring.open(argv[1]))
+  {
+    return __LINE__;
+  }
+
+  const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point reportTime = startTime;
+
+  std::uint64_t numBlocks = 0;
+  std::uint64_t numSamples = 0;
+  std::uint64_t numTorn = 0;
+  std::uint64_t droppedAtReport = 0;
+  double power = 0;
+  IqPacket lastPacket = {};
+
+  while (std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() < durationSec)
+  {
+    SharedIqBlock block;
+
+    if (ring.next(block))
+    {
+      const IqPacket packet = *block.packet;
+      const double blockPower = (packet.bitWidth <= 8) ? sumPower<std::int8_t>(block.iq, packet.numSamples) : sumPower<std::int16_t>(block.iq, packet.numSamples);
+
+      // The writer may have lapped us while we were summing
+      if (ring.valid(block))
+      {
+        numBlocks++;
+        numSamples += packet.numSamples;
+        power += blockPower;
+        lastPacket = packet;
+      }
+      else
+      {
+        numTorn++;
+      }
+    }
+    else
+    {
+      std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double elapsedSec = std::chrono::duration<double>(now - reportTime).count();
+
+    if (elapsedSec >= REPORT_PERIOD_SEC)
+    {
+      const double rmsMagnitude = (numSamples > 0) ? std::sqrt(power/numSamples) : 0;
+
+      std::cout << std::fixed << std::setprecision(3) << lastPacket.sampleStartTime << ": " << numBlocks << " blocks, " << numSamples/elapsedSec*1e-6 << " Msps at " << lastPacket.frequencyHz*1e-6 << " MHz, RMS " << rmsMagnitude << ", " << ring.dropped() - droppedAtReport << " dropped, " << numTorn << " torn" << std::endl;
+
+      reportTime = now;
+      numBlocks = 0;
+      numSamples = 0;
+      numTorn = 0;
+      power = 0;
+      droppedAtReport = ring.dropped();
+    }
+  }
+
+  std::cout << "Dropped " << ring.dropped() << " blocks in all" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#include "AsyncLog.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// String arguments that together are longer than a record's text are cut
+// short, and those that come after the text is full are logged empty,
+// without writing past the end of the record.
+
+namespace
+{
+  const char GUARD = 0x5a;
+
+  struct GuardedRecord
+  {
+    LogRecord record;
+    char guard[64];
+  };
+}
+
+int main()
+{
+  GuardedRecord guarded;
+  std::memset(guarded.guard, GUARD, sizeof(guarded.guard));
+
+  LogRecord &record = guarded.record;
+  record.numArgs = 0;
+  record.textLength = 0;
+
+  const std::string first(200, 'a');
+  const std::string second(50, 'b');
+
+  record.add(first);
+  record.add(second);
+  record.add("c");
+
+  for (const char byte : guarded.guard)
+  {
+    if (byte != GUARD)
+    {
+      std::cout << "Text written past the end of the record" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  if (record.textLength > LOG_TEXT_BYTES)
+  {
+    std::cout << "Text length " << record.textLength << " is past the end of the record" << std::endl;
+    return __LINE__;
+  }
+
+  if (std::string(&record.text[record.args[0].textOffset]) != first.substr(0, LOG_TEXT_BYTES - 1))
+  {
+    std::cout << "First string wasn't truncated to the record's text" << std::endl;
+    return __LINE__;
+  }
+
+  for (std::size_t ii = 1; ii < record.numArgs; ii++)
+  {
+    if (record.args[ii].textOffset >= LOG_TEXT_BYTES || record.text[record.args[ii].textOffset] != '\0')
+    {
+      std::cout << "String " << ii << " after the text was full isn't empty" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  std::cout << "Strings past the end of a record's text are dropped" << std::endl;
+
+  return 0;
+}
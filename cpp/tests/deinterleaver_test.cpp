@@ -0,0 +1,127 @@
+#include "Deinterleaver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Two emitters on the same frequency and pulse width, so they share a
+// cluster, heard in short dwells half a second apart the way
+// usrp_predict_event hears them. Each has to keep one id from the first
+// dwell on, across the searches that find their trains and across a dwell
+// the second one is missing from.
+
+namespace
+{
+  const double DWELL_SEC = 20e-3;
+  const double DWELL_INTERVAL_SEC = 0.5;
+  const std::size_t NUM_DWELLS = 12;
+  const std::size_t MISSING_DWELL = 5; // the second emitter is quiet for this one
+
+  struct TestEmitter
+  {
+    double priSec;
+    double phaseSec;
+  };
+
+  const TestEmitter EMITTERS[] = {{100.3e-6, 3.1e-6}, {137.1e-6, 51.7e-6}};
+
+  // PDWs of both emitters in the dwell, in TOA order, and which emitter each is from
+  void makeDwell(const std::size_t dwell, std::vector<Pdw> &pdws, std::vector<std::size_t> &truth)
+  {
+    const double start = 1000 + dwell*DWELL_INTERVAL_SEC;
+    std::map<double, std::size_t> toas;
+
+    for (std::size_t ee = 0; ee < 2; ee++)
+    {
+      if (ee == 1 && dwell == MISSING_DWELL)
+      {
+        continue;
+      }
+
+      const double first = EMITTERS[ee].phaseSec + std::ceil((start - EMITTERS[ee].phaseSec)/EMITTERS[ee].priSec)*EMITTERS[ee].priSec;
+
+      for (double toa = first; toa < start + DWELL_SEC; toa += EMITTERS[ee].priSec)
+      {
+        toas[toa] = ee;
+      }
+    }
+
+    pdws.clear();
+    truth.clear();
+
+    for (const std::pair<const double, std::size_t> &toa : toas)
+    {
+      Pdw pdw = {};
+      pdw.toa = toa.first;
+      pdw.freqHz = 1e9;
+      pdw.pwSec = 1e-6;
+
+      pdws.push_back(pdw);
+      truth.push_back(toa.second);
+    }
+  }
+}
+
+int main()
+{
+  Deinterleaver deinterleaver(1e6, 0.2, 10e-3, 1e-6);
+  std::vector<Pdw> pdws;
+  std::vector<std::size_t> truth;
+  std::vector<std::uint32_t> emitterIds;
+  std::uint32_t ids[2] = {0, 0};
+
+  for (std::size_t dwell = 0; dwell < NUM_DWELLS; dwell++)
+  {
+    makeDwell(dwell, pdws, truth);
+
+    deinterleaver.add(pdws, emitterIds);
+    deinterleaver.update();
+    deinterleaver.relabel(pdws, emitterIds);
+
+    // The id most of each emitter's PDWs got in this dwell
+    for (std::size_t ee = 0; ee < 2; ee++)
+    {
+      std::map<std::uint32_t, std::size_t> counts;
+      std::size_t total = 0;
+
+      for (std::size_t ii = 0; ii < pdws.size(); ii++)
+      {
+        if (truth[ii] == ee)
+        {
+          counts[emitterIds[ii]]++;
+          total++;
+        }
+      }
+
+      if (total == 0)
+      {
+        continue;
+      }
+
+      const std::pair<const std::uint32_t, std::size_t> &majority = *std::max_element(counts.begin(), counts.end(), [](const auto &a, const auto &b) { return a.second < b.second; });
+
+      if (ids[ee] == 0)
+      {
+        ids[ee] = majority.first;
+      }
+
+      if (majority.first != ids[ee] || majority.second < 0.95*total)
+      {
+        std::cout << "Dwell " << dwell << ": " << majority.second << " of the " << total << " PDWs of emitter " << ee << " got id " << majority.first << ", it had " << ids[ee] << std::endl;
+        return __LINE__;
+      }
+    }
+
+    if (ids[0] == ids[1])
+    {
+      std::cout << "Dwell " << dwell << ": both emitters got id " << ids[0] << std::endl;
+      return __LINE__;
+    }
+  }
+
+  std::cout << "Emitters kept ids " << ids[0] << " and " << ids[1] << " over " << NUM_DWELLS << " dwells" << std::endl;
+
+  return 0;
+}
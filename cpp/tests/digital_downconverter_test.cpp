@@ -0,0 +1,157 @@
+#include "DigitalDownconverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Pulls a sub-band out of a 56 Msps stream and checks what the recorders rely
+// on: the output doesn't depend on how the input is split across process()
+// calls, so the NCO phase and filter state carry over exactly; a tone at the
+// NCO offset comes out at DC with a steady phase; a tone elsewhere in the
+// band comes out at its offset from the NCO at unity gain; and tones outside
+// the band that would alias into it are stopped.
+
+namespace
+{
+  const double FS = 56e6;
+  const double OFFSET_HZ = 7e6;
+  const double BANDWIDTH_HZ = 2e6;
+  const std::size_t NUM_SAMPLES = 560000; // 10 ms
+  const double AMPLITUDE = 20000;
+  const std::size_t SETTLE_OUTPUTS = 64; // left out while the filters fill
+  const double MIN_REJECTION_DB = 55;
+
+  std::vector<std::complex<std::int16_t>> makeTone(const double freqHz, const double amplitude)
+  {
+    std::vector<std::complex<std::int16_t>> iq(NUM_SAMPLES);
+
+    for (std::size_t ii = 0; ii < iq.size(); ii++)
+    {
+      const double angle = 2*M_PI*std::remainder(freqHz*ii/FS, 1.0);
+      iq[ii] = {std::int16_t(std::lround(amplitude*std::cos(angle))), std::int16_t(std::lround(amplitude*std::sin(angle)))};
+    }
+
+    return iq;
+  }
+
+  // The whole input in calls of the given sizes, taken in turn
+  std::vector<std::complex<std::int16_t>> downconvert(const std::vector<std::complex<std::int16_t>> &iq, const std::vector<std::size_t> &callSizes)
+  {
+    DigitalDownconverter ddc(FS, OFFSET_HZ, BANDWIDTH_HZ);
+    std::vector<std::complex<std::int16_t>> out(ddc.maxOutputSamples(iq.size()) + callSizes.size()*iq.size());
+    std::size_t numOutputs = 0;
+    std::size_t call = 0;
+
+    for (std::size_t start = 0; start < iq.size(); call++)
+    {
+      const std::size_t length = std::min(callSizes[call % callSizes.size()], iq.size() - start);
+
+      numOutputs += ddc.process(&iq[start], length, &out[numOutputs]);
+      start += length;
+    }
+
+    out.resize(numOutputs);
+
+    return out;
+  }
+
+  double meanPower(const std::vector<std::complex<std::int16_t>> &out)
+  {
+    double sum = 0;
+
+    for (std::size_t ii = SETTLE_OUTPUTS; ii < out.size(); ii++)
+    {
+      sum += std::norm(std::complex<double>(out[ii].real(), out[ii].imag()));
+    }
+
+    return sum/(out.size() - SETTLE_OUTPUTS);
+  }
+}
+
+int main()
+{
+  const DigitalDownconverter ddc(FS, OFFSET_HZ, BANDWIDTH_HZ);
+  const double outputRate = ddc.outputSampleRate();
+
+  // A tone in the band, split every way against one call
+  {
+    const std::vector<std::complex<std::int16_t>> iq = makeTone(OFFSET_HZ + 300e3, AMPLITUDE);
+    const std::vector<std::complex<std::int16_t>> expected = downconvert(iq, {NUM_SAMPLES});
+
+    for (const std::vector<std::size_t> &callSizes : std::vector<std::vector<std::size_t>>{{1}, {1000}, {333}, {70000}, {12345}, {1, 1000, 333, 70000, 12345}})
+    {
+      const std::vector<std::complex<std::int16_t>> out = downconvert(iq, callSizes);
+
+      if (out != expected)
+      {
+        std::size_t first = 0;
+
+        while (first < std::min(out.size(), expected.size()) && out[first] == expected[first])
+        {
+          first++;
+        }
+
+        std::cout << "Calls of " << callSizes[0] << (callSizes.size() > 1 ? "..." : "") << " samples gave " << out.size() << " outputs instead of " << expected.size() << ", differing from output " << first << std::endl;
+        return __LINE__;
+      }
+    }
+
+    // Comes out 300 kHz from DC at the input amplitude
+    double cycles = 0;
+
+    for (std::size_t ii = SETTLE_OUTPUTS + 1; ii < expected.size(); ii++)
+    {
+      const std::complex<double> a(expected[ii-1].real(), expected[ii-1].imag());
+      const std::complex<double> b(expected[ii].real(), expected[ii].imag());
+
+      cycles += std::arg(b*std::conj(a))/(2*M_PI);
+    }
+
+    const double freqHz = cycles/(expected.size() - SETTLE_OUTPUTS - 1)*outputRate;
+    const double gainDb = 10*std::log10(meanPower(expected)/(AMPLITUDE*AMPLITUDE));
+
+    if (std::abs(freqHz - 300e3) > 100 || std::abs(gainDb) > 0.5)
+    {
+      std::cout << "Tone 300 kHz into the band came out at " << freqHz*1e-3 << " kHz, " << gainDb << " dB" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  // A tone on the NCO frequency lands on DC, so the NCO's phase has to hold
+  // still across every call
+  {
+    const std::vector<std::complex<std::int16_t>> out = downconvert(makeTone(OFFSET_HZ, AMPLITUDE), {1, 1000, 333, 70000, 12345});
+    const double startPhase = std::arg(std::complex<double>(out[SETTLE_OUTPUTS].real(), out[SETTLE_OUTPUTS].imag()));
+
+    for (std::size_t ii = SETTLE_OUTPUTS; ii < out.size(); ii++)
+    {
+      const double phase = std::arg(std::complex<double>(out[ii].real(), out[ii].imag()));
+
+      if (std::abs(std::remainder(phase - startPhase, 2*M_PI)) > 1e-3)
+      {
+        std::cout << "Phase at DC moved by " << std::remainder(phase - startPhase, 2*M_PI) << " rad by output " << ii << std::endl;
+        return __LINE__;
+      }
+    }
+  }
+
+  // Tones that decimation would fold back into the band, either side of it
+  // and from as far out as the CIC's aliases. Those folding into the
+  // transition band instead come out beside the band and aren't checked.
+  for (const double awayHz : {outputRate - 300e3, -outputRate - 500e3, 2*outputRate + 200e3, 20e6})
+  {
+    const std::vector<std::complex<std::int16_t>> out = downconvert(makeTone(OFFSET_HZ + awayHz, AMPLITUDE), {NUM_SAMPLES});
+    const double rejectionDb = -10*std::log10(std::max(meanPower(out), 1e-3)/(AMPLITUDE*AMPLITUDE));
+
+    if (rejectionDb < MIN_REJECTION_DB)
+    {
+      std::cout << "Tone " << awayHz*1e-6 << " MHz from the band center only " << rejectionDb << " dB down" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+#include "Deinterleaver.h"
+#include "EventTracker.h"
+#include "QuadraticFit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Two scanning emitters on the same frequency and pulse width, interleaved in
+// the same dwells, go through the deinterleaver and event tracker the way
+// usrp_predict_event runs them: each dwell's PDWs are grouped by emitter id,
+// the peak of each group's SNR is fitted and handed to the tracker under that
+// id. Each emitter has to end up with one track that has learnt its scan
+// period, which it only can if its id survives the searches in between,
+// including one after a dwell the second emitter is missing from.
+
+namespace
+{
+  const double DWELL_SEC = 150e-3;
+  const std::size_t NUM_DWELLS = 14;
+  const std::size_t MISSING_DWELL = 6; // the second emitter is quiet for this one
+  const double EVENT_HALF_WIDTH_SEC = 25e-3;
+  const double PEAK_SNR_DB = 40;
+
+  struct TestEmitter
+  {
+    double priSec;
+    double phaseSec;
+    double scanPeriodSec;
+    double firstEventSec; // into the first dwell
+  };
+
+  const TestEmitter EMITTERS[] = {{100.3e-6, 3.1e-6, 1.0, 50e-3}, {137.1e-6, 51.7e-6, 1.002, 80e-3}};
+
+  double dwellStart(const std::size_t dwell)
+  {
+    return 1000 + dwell*EMITTERS[0].scanPeriodSec;
+  }
+
+  // PDWs of both emitters in the dwell, in TOA order, and which emitter each
+  // is from. The SNR of each emitter's pulses falls away from its event peak.
+  void makeDwell(const std::size_t dwell, std::vector<Pdw> &pdws, std::vector<std::size_t> &truth)
+  {
+    const double start = dwellStart(dwell);
+    std::map<double, std::size_t> toas;
+
+    for (std::size_t ee = 0; ee < 2; ee++)
+    {
+      if (ee == 1 && dwell == MISSING_DWELL)
+      {
+        continue;
+      }
+
+      const double first = EMITTERS[ee].phaseSec + std::ceil((start - EMITTERS[ee].phaseSec)/EMITTERS[ee].priSec)*EMITTERS[ee].priSec;
+
+      for (double toa = first; toa < start + DWELL_SEC; toa += EMITTERS[ee].priSec)
+      {
+        toas[toa] = ee;
+      }
+    }
+
+    pdws.clear();
+    truth.clear();
+
+    for (const std::pair<const double, std::size_t> &toa : toas)
+    {
+      const TestEmitter &emitter = EMITTERS[toa.second];
+      const double offset = (toa.first - dwellStart(0) - emitter.firstEventSec - dwell*emitter.scanPeriodSec)/EVENT_HALF_WIDTH_SEC;
+
+      Pdw pdw = {};
+      pdw.toa = toa.first;
+      pdw.freqHz = 1e9;
+      pdw.pwSec = 1e-6;
+      pdw.snrDb = PEAK_SNR_DB - 20*offset*offset;
+
+      pdws.push_back(pdw);
+      truth.push_back(toa.second);
+    }
+  }
+}
+
+int main()
+{
+  Deinterleaver deinterleaver(1e6, 0.2, 10e-3, 1e-6);
+  EventTracker eventTracker;
+  QuadraticFit eventFit;
+  std::vector<Pdw> pdws;
+  std::vector<std::size_t> truth;
+  std::vector<std::uint32_t> emitterIds;
+  std::vector<std::size_t> pdwOrder;
+  std::map<std::uint32_t, std::size_t> emitterOfId;
+
+  for (std::size_t dwell = 0; dwell < NUM_DWELLS; dwell++)
+  {
+    makeDwell(dwell, pdws, truth);
+
+    deinterleaver.add(pdws, emitterIds);
+    deinterleaver.update();
+    deinterleaver.relabel(pdws, emitterIds);
+
+    pdwOrder.resize(pdws.size());
+
+    for (std::size_t ii = 0; ii < pdwOrder.size(); ii++)
+    {
+      pdwOrder[ii] = ii;
+    }
+
+    std::stable_sort(pdwOrder.begin(), pdwOrder.end(), [&](const std::size_t a, const std::size_t b) { return emitterIds[a] < emitterIds[b]; });
+
+    bool seen[2] = {false, false};
+
+    for (std::size_t first = 0; first < pdwOrder.size();)
+    {
+      const std::uint32_t emitterId = emitterIds[pdwOrder[first]];
+      std::size_t last = first;
+      std::size_t counts[2] = {0, 0};
+
+      eventFit.clear();
+
+      for (; last < pdwOrder.size() && emitterIds[pdwOrder[last]] == emitterId; last++)
+      {
+        eventFit.add(pdws[pdwOrder[last]].toa, pdws[pdwOrder[last]].snrDb);
+        counts[truth[pdwOrder[last]]]++;
+      }
+
+      first = last;
+
+      const double eventPeakTime = eventFit.peakTime();
+
+      if (eventFit.size() > 10 && std::isfinite(eventPeakTime))
+      {
+        const std::size_t emitter = counts[1] > counts[0];
+
+        // An id only ever belongs to one emitter
+        if (emitterOfId.count(emitterId) > 0 && emitterOfId[emitterId] != emitter)
+        {
+          std::cout << "Dwell " << dwell << ": id " << emitterId << " moved to emitter " << emitter << std::endl;
+          return __LINE__;
+        }
+
+        emitterOfId[emitterId] = emitter;
+        seen[emitter] = true;
+
+        eventTracker.addEvent(emitterId, eventPeakTime, EVENT_HALF_WIDTH_SEC);
+      }
+    }
+
+    for (std::size_t ee = 0; ee < 2; ee++)
+    {
+      if (!seen[ee] && !(ee == 1 && dwell == MISSING_DWELL))
+      {
+        std::cout << "Dwell " << dwell << ": no event for emitter " << ee << std::endl;
+        return __LINE__;
+      }
+    }
+  }
+
+  // One track per emitter, each with its own scan period
+  if (eventTracker.size() != 2 || emitterOfId.size() != 2)
+  {
+    std::cout << "Expected 2 tracks, got " << eventTracker.size() << " from " << emitterOfId.size() << " ids" << std::endl;
+    return __LINE__;
+  }
+
+  std::vector<EventPrediction> predictions;
+  eventTracker.predict(dwellStart(NUM_DWELLS), 1e-3, 3, predictions);
+
+  for (const std::pair<const std::uint32_t, std::size_t> &id : emitterOfId)
+  {
+    const double period = eventTracker.period(id.first);
+
+    if (std::abs(period - EMITTERS[id.second].scanPeriodSec) > 1e-4)
+    {
+      std::cout << "Track " << id.first << " of emitter " << id.second << " has period " << period << " instead of " << EMITTERS[id.second].scanPeriodSec << std::endl;
+      return __LINE__;
+    }
+
+    if (std::none_of(predictions.begin(), predictions.end(), [&](const EventPrediction &prediction) { return prediction.trackId == id.first; }))
+    {
+      std::cout << "Track " << id.first << " makes no prediction" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  std::cout << "Both event tracks survived " << NUM_DWELLS << " searches" << std::endl;
+
+  return 0;
+}
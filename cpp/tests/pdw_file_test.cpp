@@ -0,0 +1,179 @@
+#include "PdwFile.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// PDWs written with PdwFileWriter come back from PdwFileReader with their
+// epoch, and files the reader can't trust are handled without mapping
+// anything outside the file: an index entry pointing past the end makes it
+// walk the blocks instead, and a version 2 file gets an epoch of 0 whatever
+// its header holds, since its TOAs are absolute. A writer whose disk is full
+// has to say so rather than leave a short file behind silently.
+
+namespace
+{
+  const std::uint32_t EPOCH_SEC = 1700000000;
+  const std::size_t NUM_PDWS = 1000;
+  const std::uint32_t BLOCK_CAPACITY = 300;
+
+  std::string tempName()
+  {
+    char name[] = "/tmp/pdw_file_testXXXXXX";
+    const int fd = mkstemp(name);
+
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+
+    return name;
+  }
+
+  std::vector<Pdw> makePdws()
+  {
+    std::vector<Pdw> pdws(NUM_PDWS);
+
+    for (std::size_t ii = 0; ii < pdws.size(); ii++)
+    {
+      std::memset(&pdws[ii], 0, sizeof(Pdw));
+      pdws[ii].toa = ii*100e-6;
+      pdws[ii].freqHz = 1e6 + ii;
+      pdws[ii].snrDb = 20;
+    }
+
+    return pdws;
+  }
+
+  std::vector<char> readAll(const std::string &filename)
+  {
+    std::ifstream fin(filename, std::ifstream::binary);
+
+    return std::vector<char>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+  }
+
+  void writeAll(const std::string &filename, const std::vector<char> &bytes)
+  {
+    std::ofstream fout(filename, std::ofstream::binary | std::ofstream::trunc);
+    fout.write(bytes.data(), bytes.size());
+  }
+
+  // Every PDW read back, in order, with the TOA it was written with
+  bool checkPdws(PdwFileReader &reader, const std::vector<Pdw> &expected)
+  {
+    std::vector<Pdw> pdws;
+    reader.query(-1e300, 1e300, -1e300, 1e300, pdws);
+
+    if (pdws.size() != expected.size())
+    {
+      std::cout << "Read " << pdws.size() << " PDWs instead of " << expected.size() << std::endl;
+      return false;
+    }
+
+    for (std::size_t ii = 0; ii < pdws.size(); ii++)
+    {
+      if (pdws[ii].toa != expected[ii].toa || pdws[ii].freqHz != expected[ii].freqHz)
+      {
+        std::cout << "PDW " << ii << " read back as " << pdws[ii].toa << " s, " << pdws[ii].freqHz << " Hz" << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+int main()
+{
+  const std::vector<Pdw> pdws = makePdws();
+  const std::string filename = tempName();
+  PdwFileWriter writer;
+
+  if (!writer.open(filename, EPOCH_SEC, BLOCK_CAPACITY) || !writer.write(pdws) || !writer.close())
+  {
+    std::cout << "Failed writing " << filename << std::endl;
+    return __LINE__;
+  }
+
+  PdwFileReader reader;
+
+  if (!reader.open(filename) || reader.epochSec() != EPOCH_SEC || reader.truncated() || reader.numBlocks() != 4 || !checkPdws(reader, pdws))
+  {
+    std::cout << "Written file read back with epoch " << reader.epochSec() << ", " << reader.numBlocks() << " blocks" << std::endl;
+    return __LINE__;
+  }
+
+  reader.close();
+
+  const std::vector<char> original = readAll(filename);
+
+  // An index entry whose block would run past the end of the file
+  {
+    std::vector<char> bytes = original;
+    PdwFileTrailer trailer;
+    std::memcpy(&trailer, &bytes[bytes.size() - sizeof(trailer)], sizeof(trailer));
+
+    PdwBlockIndex entry;
+    const std::size_t entryOffset = trailer.indexOffset + 2*sizeof(PdwBlockIndex);
+    std::memcpy(&entry, &bytes[entryOffset], sizeof(entry));
+    entry.offset = bytes.size() - 8;
+    std::memcpy(&bytes[entryOffset], &entry, sizeof(entry));
+
+    writeAll(filename, bytes);
+
+    // The blocks themselves are all there, only the index is bad
+    if (!reader.open(filename) || reader.numBlocks() != 4 || !checkPdws(reader, pdws))
+    {
+      std::cout << "File with a bad index entry read back " << reader.numBlocks() << " blocks" << std::endl;
+      return __LINE__;
+    }
+
+    reader.close();
+  }
+
+  // A version 2 file, whose TOAs are absolute
+  {
+    std::vector<char> bytes = original;
+    PdwFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    header.version = 2;
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    writeAll(filename, bytes);
+
+    if (!reader.open(filename) || reader.epochSec() != 0 || !checkPdws(reader, pdws))
+    {
+      std::cout << "Version 2 file read back with epoch " << reader.epochSec() << std::endl;
+      return __LINE__;
+    }
+
+    reader.close();
+  }
+
+  std::remove(filename.c_str());
+
+  // A full disk
+  {
+    bool wrote = writer.open("/dev/full", EPOCH_SEC, BLOCK_CAPACITY);
+
+    for (std::size_t ii = 0; ii < 100 && wrote; ii++)
+    {
+      wrote = writer.write(pdws);
+    }
+
+    if (wrote || writer.close())
+    {
+      std::cout << "Writing to a full disk didn't fail" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include "StreamingPdwExtractor.h"
+
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <vector>
+
+// TOAs of a pulse train a week into a recording's epoch have to give back its
+// PRI to within a sample: absolute UTC seconds in a double only resolve to
+// 238 ns, which turned a 100.3 us PRI into 100.374 and 100.136 us. A second
+// dwell starting anywhere later gets its own start time, and a block that
+// doesn't follow on from the last drops the pulse in progress.
+
+namespace
+{
+  const double FS = 56e6;
+  const double PRI_SEC = 100.3e-6;
+  const std::size_t PULSE_SAMPLES = 56;
+  const std::size_t NUM_PULSES = 50;
+  const std::size_t BLOCK_SIZE = 4096;
+  const double WEEK_SEC = 7*24*3600.0;
+
+  // A noiseless train of NUM_PULSES pulses every PRI_SEC, pulse k starting at
+  // the sample nearest k*PRI_SEC
+  std::vector<std::complex<float>> makeTrain()
+  {
+    std::vector<std::complex<float>> iq(std::ceil(NUM_PULSES*PRI_SEC*FS));
+
+    for (std::size_t kk = 0; kk < NUM_PULSES; kk++)
+    {
+      const std::size_t start = std::llround(kk*PRI_SEC*FS);
+
+      for (std::size_t ii = 0; ii < PULSE_SAMPLES; ii++)
+      {
+        iq[start + ii] = 0.5f;
+      }
+    }
+
+    return iq;
+  }
+
+  void extract(StreamingPdwExtractor &extractor, const std::vector<std::complex<float>> &iq, std::vector<Pdw> &pdws)
+  {
+    for (std::size_t blockStart = 0; blockStart < iq.size(); blockStart += BLOCK_SIZE)
+    {
+      extractor.process(&iq[blockStart], std::min(BLOCK_SIZE, iq.size() - blockStart), blockStart, 0.01f, 0.01f, pdws);
+    }
+  }
+
+  // Every TOA within a nanosecond of the sample its pulse starts on, so every
+  // PRI is within a sample of the true one
+  bool checkToas(const std::vector<Pdw> &pdws, const double startTime)
+  {
+    if (pdws.size() != NUM_PULSES)
+    {
+      std::cout << "Expected " << NUM_PULSES << " PDWs, got " << pdws.size() << std::endl;
+      return false;
+    }
+
+    for (std::size_t kk = 0; kk < pdws.size(); kk++)
+    {
+      const double expected = std::llround(kk*PRI_SEC*FS)/FS;
+
+      if (std::abs((pdws[kk].toa - startTime) - expected) > 1e-9)
+      {
+        std::cout << "TOA " << kk << " is " << (pdws[kk].toa - startTime)*1e6 << " us into the dwell instead of " << expected*1e6 << " us" << std::endl;
+        return false;
+      }
+
+      if (kk > 0 && std::abs(pdws[kk].toa - pdws[kk-1].toa - PRI_SEC) > 1/FS)
+      {
+        std::cout << "PRI " << kk << " is " << (pdws[kk].toa - pdws[kk-1].toa)*1e6 << " us instead of " << PRI_SEC*1e6 << " us" << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+int main()
+{
+  const std::vector<std::complex<float>> iq = makeTrain();
+  StreamingPdwExtractor extractor(FS, 1e9, 0.9999);
+  std::vector<Pdw> pdws;
+
+  // First dwell a week and a bit after the epoch
+  const double firstDwell = WEEK_SEC + 0.123456789;
+
+  extractor.startStream(firstDwell);
+  extract(extractor, iq, pdws);
+
+  if (!checkToas(pdws, firstDwell))
+  {
+    return __LINE__;
+  }
+
+  // The next dwell, not contiguous with the first
+  const double secondDwell = firstDwell + 0.25 + 17/FS;
+
+  pdws.clear();
+  extractor.startStream(secondDwell);
+  extract(extractor, iq, pdws);
+
+  if (!checkToas(pdws, secondDwell))
+  {
+    return __LINE__;
+  }
+
+  // A pulse straddling a gap in the stream is dropped rather than joined up
+  // with whatever comes after the gap
+  const std::size_t pulseStart = std::llround(PRI_SEC*FS);
+
+  pdws.clear();
+  extractor.startStream(0);
+  extractor.process(&iq[0], pulseStart + PULSE_SAMPLES/2, 0, 0.01f, 0.01f, pdws);
+  extractor.process(&iq[pulseStart + PULSE_SAMPLES/2 + 10], 100, pulseStart + PULSE_SAMPLES/2 + 10, 0.01f, 0.01f, pdws);
+
+  // The first pulse of the train, then what's left of the second after the gap
+  if (pdws.size() != 2 || std::llround(pdws[1].toa*FS) != std::int64_t(pulseStart + PULSE_SAMPLES/2 + 10) || std::llround(pdws[1].pwSec*FS) != std::int64_t(PULSE_SAMPLES/2 - 10))
+  {
+    std::cout << "Pulse across a gap gave " << pdws.size() << " PDWs" << std::endl;
+    return __LINE__;
+  }
+
+  std::cout << "TOAs resolve the PRI to within a sample" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include "QuadraticFit.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// The SNR vs. TOA fits that find an event's peak. Two things are checked:
+// that the fit keeps its precision when the points sit far from the first one
+// compared with their spread (the moments are accumulated about a running
+// mean for this), and that robustFit finds the peak when some of the pulses
+// are far below the parabola, as happens when they overlap another
+// emitter's, while a plain fit of the same points is pulled off it.
+
+namespace
+{
+  const double PEAK_SNR_DB = 40;
+  const double EPOCH_SEC = 1.7e9; // UTC, so TOAs need the fit to remove an origin
+
+  double parabola(const double t, const double peakTime, const double curvature)
+  {
+    return PEAK_SNR_DB - curvature*(t - peakTime)*(t - peakTime);
+  }
+}
+
+int main()
+{
+  // One point 100 s before a cluster 2 ms wide, all on the parabola
+  {
+    const double PEAK_TIME = EPOCH_SEC + 100.001;
+    const double CURVATURE = 1e6; // dB/s^2
+    QuadraticFit fit;
+
+    fit.add(EPOCH_SEC, parabola(EPOCH_SEC, PEAK_TIME, CURVATURE));
+
+    for (int ii = 0; ii < 200; ii++)
+    {
+      const double t = EPOCH_SEC + 100 + ii*1e-5;
+      fit.add(t, parabola(t, PEAK_TIME, CURVATURE));
+    }
+
+    const double error = fit.peakTime() - PEAK_TIME;
+
+    if (!(std::abs(error) < 1e-4))
+    {
+      std::cout << "Peak of a distant cluster is off by " << error << " s" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  // Weights of 0 leave a point out
+  {
+    QuadraticFit fit;
+
+    fit.add(0, 0);
+    fit.add(1, 1, 0);
+    fit.add(2, 0, -1);
+
+    if (fit.size() != 1 || std::isfinite(fit.peakTime()))
+    {
+      std::cout << "Points without a positive weight were counted" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  // An event 100 ms long with noisy SNRs, a tenth of whose pulses on the
+  // falling side are 20 dB down
+  {
+    const double PEAK_TIME = EPOCH_SEC + 0.05;
+    const double CURVATURE = 4e3; // dB/s^2, 10 dB down at the ends
+    const double NOISE_DB = 0.5;
+    const double MAX_PEAK_ERROR = 1e-3; // sec
+
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, NOISE_DB);
+    std::vector<double> toas;
+    std::vector<double> snrs;
+    QuadraticFit plainFit;
+
+    for (int ii = 0; ii < 1000; ii++)
+    {
+      const double t = EPOCH_SEC + ii*100e-6;
+      double snr = parabola(t, PEAK_TIME, CURVATURE) + noise(rng);
+
+      if (t > PEAK_TIME && ii%5 == 0)
+      {
+        snr -= 20;
+      }
+
+      toas.push_back(t);
+      snrs.push_back(snr);
+      plainFit.add(t, snr);
+    }
+
+    const double plainError = plainFit.peakTime() - PEAK_TIME;
+    const QuadraticFit robustFit = QuadraticFit::robustFit(toas, snrs);
+    const double robustError = robustFit.peakTime() - PEAK_TIME;
+
+    if (!(std::abs(robustError) < MAX_PEAK_ERROR))
+    {
+      std::cout << "Robust fit peak is off by " << robustError << " s with " << robustFit.size() << " of " << toas.size() << " points kept" << std::endl;
+      return __LINE__;
+    }
+
+    // Otherwise the outliers aren't doing anything to test
+    if (!(std::abs(plainError) > 5*MAX_PEAK_ERROR))
+    {
+      std::cout << "Plain fit peak is only off by " << plainError << " s" << std::endl;
+      return __LINE__;
+    }
+
+    if (robustFit.size() < 850 || robustFit.size() > 910)
+    {
+      std::cout << "Robust fit kept " << robustFit.size() << " of " << toas.size() << " points" << std::endl;
+      return __LINE__;
+    }
+  }
+
+  // Too few points to refit leaves the plain fit
+  {
+    const std::vector<double> toas = {0, 1, 2};
+    const std::vector<double> snrs = {0, 1, 0};
+    const QuadraticFit fit = QuadraticFit::robustFit(toas, snrs);
+
+    if (fit.size() != 3 || std::abs(fit.peakTime() - 1) > 1e-12)
+    {
+      std::cout << "Robust fit of three points has peak " << fit.peakTime() << std::endl;
+      return __LINE__;
+    }
+  }
+
+  return 0;
+}
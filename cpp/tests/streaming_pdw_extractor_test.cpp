@@ -0,0 +1,207 @@
+#include "StreamingPdwExtractor.h"
+#include "CfarDetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Feeds the same synthetic recording through the PDW extractor in blocks of
+// many sizes, with a fixed threshold and with CFAR thresholds, and checks
+// every block size gives the PDWs of a single pass: the same TOAs and pulse
+// widths to the sample, and the same amplitude and frequency up to float
+// rounding. CFAR thresholds computed a block at a time have to match those
+// of the whole recording too, and samples of a short buffer that have no
+// reference cells must not be taken for one long pulse.
+
+namespace
+{
+  const double FS = 56e6;
+  const double FC = 1e9;
+  const float SAMP_MAX = 0.9999;
+  const float NOISE_SIGMA = 0.01;
+  const float NOISE_FLOOR = 0.0118; // median magnitude of the noise
+  const std::size_t NUM_SAMPLES = 1 << 19;
+  const std::size_t MAX_PULSE_SAMPLES = 4096;
+  const std::size_t CFAR_TRAINING_CELLS = 2048;
+  const std::size_t CFAR_GUARD_CELLS = 8192; // longer than the longest pulse
+
+  struct Pulse
+  {
+    std::size_t start;
+    std::size_t length;
+    float amplitude;
+    double freqOffsetHz;
+  };
+
+  std::vector<std::complex<float>> makeRecording(const std::vector<Pulse> &pulses)
+  {
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0, NOISE_SIGMA);
+    std::vector<std::complex<float>> iq(NUM_SAMPLES);
+
+    for (std::complex<float> &sample : iq)
+    {
+      sample = {noise(rng), noise(rng)};
+    }
+
+    for (const Pulse &pulse : pulses)
+    {
+      for (std::size_t ii = 0; ii < pulse.length; ii++)
+      {
+        iq[pulse.start + ii] += std::polar(pulse.amplitude, float(2*M_PI*pulse.freqOffsetHz*ii/FS));
+      }
+    }
+
+    return iq;
+  }
+
+  // cfarThreshold is that of the whole recording, or empty for a fixed threshold
+  std::vector<Pdw> extract(const std::vector<std::complex<float>> &iq, const std::size_t blockSize, const std::vector<float> &cfarThreshold)
+  {
+    StreamingPdwExtractor extractor(FS, FC, SAMP_MAX);
+    std::vector<Pdw> pdws;
+
+    extractor.enableIntrapulseAnalysis(MAX_PULSE_SAMPLES);
+    extractor.startStream(0);
+
+    for (std::size_t blockStart = 0; blockStart < iq.size(); blockStart += blockSize)
+    {
+      const std::size_t blockLength = std::min(blockSize, iq.size() - blockStart);
+
+      if (!cfarThreshold.empty())
+      {
+        extractor.process(&iq[blockStart], blockLength, blockStart, &cfarThreshold[blockStart], NOISE_FLOOR, pdws);
+      }
+      else
+      {
+        extractor.process(&iq[blockStart], blockLength, blockStart, 0.01f, NOISE_FLOOR, pdws);
+      }
+    }
+
+    return pdws;
+  }
+
+  bool samePdws(const std::vector<Pdw> &expected, const std::vector<Pdw> &actual)
+  {
+    if (actual.size() != expected.size())
+    {
+      std::cout << "Expected " << expected.size() << " PDWs, got " << actual.size() << std::endl;
+      return false;
+    }
+
+    for (std::size_t ii = 0; ii < expected.size(); ii++)
+    {
+      const Pdw &a = expected[ii];
+      const Pdw &b = actual[ii];
+
+      if (a.toa != b.toa || a.pwSec != b.pwSec || std::abs(a.amp - b.amp) > 1e-4*a.amp || std::abs(a.snrDb - b.snrDb) > 1e-3 || std::abs(a.freqHz - b.freqHz) > 1e3 || a.modulation != b.modulation)
+      {
+        std::cout << "PDW " << ii << " differs: toa " << a.toa << " vs " << b.toa << ", pw " << a.pwSec << " vs " << b.pwSec;
+        std::cout << ", amp " << a.amp << " vs " << b.amp << ", freq " << a.freqHz << " vs " << b.freqHz << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+int main()
+{
+  // Pulses straddling the boundaries of most of the block sizes below, one
+  // longer than the intrapulse analysis keeps and one a single chunk long
+  const std::vector<Pulse> pulses = {
+    {1000, 56, 0.5, 1e6},
+    {4090, 200, 0.3, -2e6},
+    {65500, 1000, 0.4, 3e6},
+    {131000, 8000, 0.2, 0.5e6},
+    {262140, 64, 0.6, -4e6},
+    {400003, 5601, 0.25, 2e6},
+  };
+
+  const std::vector<std::complex<float>> iq = makeRecording(pulses);
+  const std::vector<std::size_t> blockSizes = {1, 7, 64, 1000, 4096, 65537};
+
+  CfarDetector cfar(CFAR_TRAINING_CELLS, CFAR_GUARD_CELLS, 10);
+  std::vector<float> cfarThreshold(iq.size());
+
+  cfar.computeThreshold(iq.data(), iq.size(), 0, iq.size(), cfarThreshold.data());
+
+  for (const std::size_t blockSize : {1000, 4096, 65537})
+  {
+    std::vector<float> blockThreshold(blockSize);
+
+    for (std::size_t blockStart = 0; blockStart < iq.size(); blockStart += blockSize)
+    {
+      const std::size_t blockLength = std::min(blockSize, iq.size() - blockStart);
+
+      cfar.computeThreshold(iq.data(), iq.size(), blockStart, blockLength, blockThreshold.data());
+
+      for (std::size_t ii = 0; ii < blockLength; ii++)
+      {
+        if (std::abs(blockThreshold[ii] - cfarThreshold[blockStart + ii]) > 1e-4*cfarThreshold[blockStart + ii])
+        {
+          std::cout << "CFAR threshold of sample " << blockStart + ii << " is " << blockThreshold[ii] << " in blocks of " << blockSize << ", " << cfarThreshold[blockStart + ii] << " in one" << std::endl;
+          return __LINE__;
+        }
+      }
+    }
+  }
+
+  // Shorter than twice the guard cells, so the samples in the middle have no
+  // reference cells on either side. Only the first two pulses are in it.
+  for (const CfarDetector::Mode mode : {CfarDetector::Mode::CellAveraging, CfarDetector::Mode::OrderStatistic})
+  {
+    const std::vector<std::complex<float>> shortIq(iq.begin(), iq.begin() + CFAR_GUARD_CELLS*3/2);
+    CfarDetector shortCfar(CFAR_TRAINING_CELLS, CFAR_GUARD_CELLS, 10, mode);
+    std::vector<float> shortThreshold(shortIq.size());
+
+    shortCfar.computeThreshold(shortIq.data(), shortIq.size(), 0, shortIq.size(), shortThreshold.data());
+
+    for (const Pdw &pdw : extract(shortIq, shortIq.size(), shortThreshold))
+    {
+      if (std::llround(pdw.pwSec*FS) > std::int64_t(pulses[1].length))
+      {
+        std::cout << "Short buffer gave a PDW " << pdw.pwSec*FS << " samples long at " << pdw.toa*FS << std::endl;
+        return __LINE__;
+      }
+    }
+  }
+
+  for (const bool useCfar : {false, true})
+  {
+    const std::vector<float> &threshold = useCfar ? cfarThreshold : std::vector<float>();
+    const std::vector<Pdw> expected = extract(iq, iq.size(), threshold);
+
+    if (expected.size() != pulses.size())
+    {
+      std::cout << "Expected a PDW per pulse, got " << expected.size() << (useCfar ? " with CFAR" : "") << std::endl;
+      return __LINE__;
+    }
+
+    for (std::size_t ii = 0; ii < pulses.size(); ii++)
+    {
+      if (std::llround(expected[ii].toa*FS) != std::int64_t(pulses[ii].start) || std::llround(expected[ii].pwSec*FS) != std::int64_t(pulses[ii].length))
+      {
+        std::cout << "Pulse " << ii << " found at " << expected[ii].toa*FS << " for " << expected[ii].pwSec*FS << " samples" << std::endl;
+        return __LINE__;
+      }
+    }
+
+    for (const std::size_t blockSize : blockSizes)
+    {
+      if (!samePdws(expected, extract(iq, blockSize, threshold)))
+      {
+        std::cout << "Block size " << blockSize << (useCfar ? " with CFAR" : "") << " changed the PDWs" << std::endl;
+        return __LINE__;
+      }
+    }
+  }
+
+  std::cout << "PDWs independent of block size" << std::endl;
+
+  return 0;
+}
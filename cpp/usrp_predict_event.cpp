@@ -8,6 +8,20 @@
 #include <boost/thread.hpp>
 
 #include "IqPacket.h"
+#include "Helper.h"
+#include "QuadraticFit.h"
+#include "StreamingPdwExtractor.h"
+#include "PdwFile.h"
+#include "NoiseFloorEstimator.h"
+#include "CfarDetector.h"
+#include "Deinterleaver.h"
+#include "EventTracker.h"
+#include "DwellScheduler.h"
+#include "ThreadPool.h"
+#include "ThreadConfig.h"
+#include "PipelineMetrics.h"
+#include "PipelineTrace.h"
+#include "AsyncLog.h"
 
 #include <cstring>
 #include <ctime>
@@ -15,41 +29,16 @@
 
 #include <bit>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <chrono>
 #include <algorithm>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <iterator>
-#include <execution>
 
 #include <Eigen/Dense>
-#include <Eigen/QR>
-
-const double get_event_peak_time(const std::vector<double> &t, const std::vector<double> &v)
-{
-	// Create Matrix Placeholder of size n x k, n = number of datapoints, k = order of polynomial, for example k = 3 for cubic polynomial
-	Eigen::MatrixXd T(t.size(), 3);
-	Eigen::VectorXd V = Eigen::VectorXd::Map(&v.front(), v.size());
-	Eigen::Vector3d p;
-
-	// check to make sure inputs are correct
-	assert(t.size() == v.size());
-	assert(t.size() >= 3);
-
-	// Populate the matrix
-	for(size_t i = 0 ; i < t.size(); ++i)
-	{
-		for(size_t j = 0; j < 3; ++j)
-		{
-			T(i, j) = pow(t.at(i), j);
-		}
-	}
-
-	// Solve for linear least square fit
-	p = T.householderQr().solve(V);
-
-	return (-p[1]/(2*p[2])); // this represents the peak of the parabola as estimated by a quadratic polynomial fit
-}
 
 void getFilenameStr(char* filenameStr)
 {
@@ -74,7 +63,24 @@ void getFilenameStr(char* filenameStr)
 
 int UHD_SAFE_MAIN(int argc, char *argv[])
 {
-	uhd::set_thread_priority_safe();
+	// Without a placement asked for, fall back on UHD's best effort priority boost
+	ThreadConfig threads;
+
+	if (!parseThreadConfig(argc, argv, threads))
+	{
+		return __LINE__;
+	}
+
+	if (threads.rx.active)
+	{
+		applyThreadPlacement("RX", threads.rx);
+	}
+	else
+	{
+		uhd::set_thread_priority_safe();
+	}
+
+	const int numPositionalArgs = countPositionalArgs(argc, argv);
 
 	std::int32_t status = EXIT_SUCCESS;
 	uhd::rx_metadata_t meta;
@@ -98,9 +104,71 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 	std::int32_t rxGain = atoi(argv[4]);
 	const float dwellDuration = atof(argv[5]);
 	const float collectionDuration = atof(argv[6]);
+	const std::uint32_t eventWindowLength = (numPositionalArgs > 7) ? atoi(argv[7]) : 64; // Number of event intervals the median of each track is taken over
+	const char* pdwFilename = (numPositionalArgs > 8) ? argv[8] : nullptr; // Optionally save every PDW generated
+	const char* metricsOption = findOption(argc, argv, "metrics"); // Optionally export stage times and error counts to this Prometheus text file
+	const char* traceOption = findOption(argc, argv, "trace"); // Optionally record a timeline of every stage to this Chrome trace JSON file
+	PipelineMetrics metrics("usrp_predict_event", dwellDuration);
+
+	// Track the events of every emitter separately, each started from the
+	// median of a bounded window of its event intervals and then followed by a
+	// filter whose prediction uncertainty sizes the dwell over its next event
+	EventTracker eventTracker(eventWindowLength);
+	std::vector<EventPrediction> predictions;
+	std::vector<ScheduledDwell> schedule;
+	ScheduledDwell dwell;
+	std::vector<std::uint32_t> eventTrackIds;
+	const double SCHEDULE_LEAD_TIME = 100e-3; // sec, time needed to get a timed stream command to the device
+	const double DWELL_SETUP_TIME = 10e-3; // sec, predicted windows closer together than this share a dwell
+	const double MIN_EVENT_HALF_WIDTH = 1e-3; // sec, least a dwell covers either side of a predicted event
+	const double PREDICTION_SIGMAS = 3; // a dwell covers this many sigma of the predicted event time
+	QuadraticFit eventFit;
+	std::vector<double> eventToas;
+	std::vector<double> eventSnrs;
+	NoiseFloorEstimator noiseFloor;
+	const float SNR_THRESHOLD = 20; // dB
+	const std::size_t CFAR_TRAINING_CELLS = 16384; // samples on each side of the cell under test
+	const std::size_t CFAR_GUARD_CELLS = 16384; // must be longer than the longest pulse expected
+	const std::size_t CFAR_BLOCK_SIZE = 262144;
+	CfarDetector cfar(CFAR_TRAINING_CELLS, CFAR_GUARD_CELLS, SNR_THRESHOLD);
+	std::vector<float> thresholdPower(CFAR_BLOCK_SIZE);
+	std::vector<Pdw> pdws;
+	PdwFileWriter pdwFile;
+	const double EMITTER_FREQ_TOLERANCE = 1e6; // Hz
+	const double EMITTER_PW_TOLERANCE = 0.2; // fraction of the pulse width
+	const double MAX_PRI = 10e-3; // sec
+	const double PRI_RESOLUTION = 1e-6; // sec
+	Deinterleaver deinterleaver(EMITTER_FREQ_TOLERANCE, EMITTER_PW_TOLERANCE, MAX_PRI, PRI_RESOLUTION);
+	std::unique_ptr<ThreadPool> dspPool; // emitter searches run on the DSP CPUs when given some
+	std::vector<std::uint32_t> emitterIds;
+	std::vector<std::size_t> pdwOrder;
+
+	// Started before the DSP threads so they get their events up front too
+	if (traceOption != nullptr)
+	{
+		startTrace();
+		nameTraceThread("RX");
+	}
+
+	if (findOption(argc, argv, "dsp-threads") != nullptr)
+	{
+		dspPool = std::make_unique<ThreadPool>(threads.dsp.cpus.empty() ? std::thread::hardware_concurrency() : threads.dsp.cpus.size(), [&threads] { nameTraceThread("DSP", TRACE_POOL_EVENTS); applyThreadPlacement("DSP", threads.dsp); });
+	}
 
-	std::vector<double> eventTimeList;
-	double nextEventTime = 0;
+	// PDW TOAs are kept from this second rather than as absolute UTC, which a
+	// double only resolves to 238 ns
+	const std::uint32_t epochSec = std::chrono::system_clock::now().time_since_epoch() / std::chrono::seconds(1);
+
+	if (pdwFilename != nullptr && !pdwFile.open(pdwFilename, epochSec))
+	{
+		std::cout << "Failed to open " << pdwFilename << std::endl;
+		return __LINE__;
+	}
+
+	if (metricsOption != nullptr && !metrics.startExport(metricsOption))
+	{
+		return __LINE__;
+	}
 
 	//create a usrp device
 
@@ -134,6 +202,8 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 	std::cout <<  "Sample Rate = " << receivedSampleRate*1e-6 << " Msps" << std::endl;
 	const float fs = receivedSampleRate;
 
+	StreamingPdwExtractor pdwExtractor(fs, frequencyHz, SAMP_MAX);
+
 	// Set analog bandwidth of device
 
 	usrp->set_rx_bandwidth(requestedBandwidthHz);
@@ -172,11 +242,14 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 	const std::uint32_t sampleLength = dwellDuration*receivedSampleRate;
 
 	// setup streaming
-	uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+	uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE); // Give us the number of samples we want and then finish
 	stream_cmd.num_samps  = sampleLength;
 	stream_cmd.stream_now = true;
 	stream_cmd.time_spec  = uhd::time_spec_t();
 
+	// Predicted event windows are merged in to dwells no longer than the buffer
+	DwellScheduler dwellScheduler(dwellDuration, DWELL_SETUP_TIME);
+
 	// Specify the endianness of the recording
 
 	if constexpr (std::endian::native == std::endian::big)
@@ -196,12 +269,19 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 
 	packet.frequencyHz = frequencyHz;
 	packet.bandwidthHz = receivedBandwidthHz;
-	packet.sampleRate = receivedSampleRate;
+	packet.sampleRateSps = receivedSampleRate;
 	packet.numSamples = sampleLength;
 
 	// Allocate the host buffer the device will be streaming to
 	Eigen::VectorXcf iq = Eigen::VectorXcf(sampleLength);
 
+	// Reserve room for the PDWs up front so the processing loop doesn't allocate
+	pdws.reserve(1 << 16);
+
+	// Messages from the loop are written out on a background thread, so a
+	// slow console can't hold up a dwell
+	startAsyncLog();
+
 	const std::chrono::system_clock::time_point startTime = std::chrono::system_clock::now();
 	std::chrono::system_clock::time_point currentTime;
 
@@ -210,13 +290,18 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 		// If we're saturated, then drop the receive gain down by 1 dB
 		if (saturated)
 		{
+			TraceScope trace("retune");
+
 			usrp->set_rx_gain(--rxGain);
 			rxGain = usrp->get_rx_gain();
 
-			std::cout << "Gain = " << rxGain << " dB" << std::endl;
+			// The noise floor history no longer applies at the new gain
+			noiseFloor.clear();
+
+			logAsync("Gain = {} dB", rxGain);
 		}
 
-		packet.rxGain = rxGain;
+		packet.rxGainDb = rxGain;
 		saturated = false;
 		badSamples = false;
 
@@ -225,31 +310,62 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 		memset(&meta, 0, sizeof(meta));
 
 		size_t num_accum_samps = 0;
+		double dwellStartTime = 0;
+		double dwellStartToa = 0; // dwellStartTime from the epoch
+
+		// Schedule the next dwell around the earliest predicted events of all the
+		// tracks. Each window covers how long that emitter's events last plus
+		// 3 sigma of the uncertainty in when the next one will be, so dwells
+		// shrink as the tracks settle, up to a full dwell for uncertain ones.
+		const std::uint64_t scheduleStart = readTsc();
+		const double deviceTime = usrp->get_time_now().get_real_secs();
 
-		if (nextEventTime > 0)
+		predictions.clear();
+		eventTracker.predict(deviceTime + SCHEDULE_LEAD_TIME, MIN_EVENT_HALF_WIDTH, PREDICTION_SIGMAS, predictions);
+		dwellScheduler.schedule(predictions, schedule);
+
+		traceSince("schedule", scheduleStart);
+
+		if (!schedule.empty())
 		{
-			//std::cout << "Scheduling next RX for " << nextEventTime - (dwellDuration/2) << std::endl;
+			dwell = schedule.front();
+
+			//std::cout << "Scheduling next RX for " << dwell.startTime << std::endl;
 			stream_cmd.stream_now  = false;
-			stream_cmd.time_spec   = uhd::time_spec_t(nextEventTime - (dwellDuration/2));
-			nextEventTime = 0;
+			stream_cmd.time_spec   = uhd::time_spec_t(dwell.startTime);
 		}
 		else
 		{
-			//std::cout << "Missed event, scheduling next RX for now" << std::endl;
+			//std::cout << "No event predicted, scheduling next RX for now" << std::endl;
+			dwell.startTime = deviceTime;
+			dwell.endTime = deviceTime + dwellDuration;
+			dwell.trackIds.clear();
+
 			stream_cmd.stream_now  = true;
 			stream_cmd.time_spec   = uhd::time_spec_t();
 		}
 
-		stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS;
+		const std::size_t dwellSamples = std::min<std::size_t>(std::ceil(dwell.duration()*fs), sampleLength);
+		const double recvTimeout = std::max(0.0, dwell.startTime - deviceTime) + dwell.duration() + 500e-3;
 
+		stream_cmd.num_samps = dwellSamples;
+
+		const std::uint64_t recvStart = readTsc();
 		rx_stream->issue_stream_cmd(stream_cmd);
 
-		while(num_accum_samps < sampleLength)
+		while(num_accum_samps < dwellSamples)
 		{
 			const std::int32_t startIndex = num_accum_samps;
-			const std::int32_t remainingSize = sampleLength-num_accum_samps;
+			const std::int32_t remainingSize = dwellSamples-num_accum_samps;
 
-			num_accum_samps += rx_stream->recv(&iq(startIndex), remainingSize, meta, 30.0, true);
+			num_accum_samps += rx_stream->recv(&iq(startIndex), remainingSize, meta, recvTimeout, true);
+
+			// The metadata time is that of the first sample of this recv, so hang on to the first one
+			if (startIndex == 0)
+			{
+				dwellStartTime = meta.time_spec.get_real_secs();
+				dwellStartToa = (meta.time_spec.get_full_secs() - epochSec) + meta.time_spec.get_frac_secs();
+			}
 
 			// Handle streaming error codes
 			switch (meta.error_code)
@@ -259,123 +375,174 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 					break;
 
 				case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT: // I get this error on the expected last iteration of the while loop
-					std::cout << "ERROR_CODE_TIMEOUT: Got timeout before all samples received" << std::endl;
+					logAsync("ERROR_CODE_TIMEOUT: Got timeout before all samples received");
+					metrics.timeouts++;
+					traceInstant("timeout");
 					badSamples = true;
 					break;
 
 				case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
 					overrunCounter++;
-					std::cout << "ERROR_CODE_OVERFLOW: Overflowed" << std::endl;
+					metrics.overruns++;
+					traceInstant("overrun");
+					logAsync("ERROR_CODE_OVERFLOW: Overflowed");
 					badSamples = true;
 					break;
 
 				default:
-					std::cout << "Got error code: " << meta.strerror() << std::endl;
+					logAsync("Got error code: {}", meta.strerror());
 					badSamples = true;
 					break;
 			}
 		}
 
-		stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
-		stream_cmd.stream_now  = true;
-		stream_cmd.time_spec   = uhd::time_spec_t();
-		rx_stream->issue_stream_cmd(stream_cmd);
+		metrics.recv.recordSince(recvStart);
+		traceSince("recv", recvStart);
+		const std::uint64_t processStart = readTsc();
+		std::uint64_t writeTicks = 0; // of the PDWs, which isn't processing
+
+		if (badSamples)
+		{
+			metrics.shortReads++;
+		}
 
 		// If we received a full set of samples with no error
 		if (badSamples == false)
 		{
-			// Compute the noise floor as the mean of the magnitude of the I/Q data
-			Eigen::VectorXf mag = iq.cwiseAbs();
-			const float NOISE_FLOOR = mag.mean();
-			const float SNR_THRESHOLD = 20; // dB
-			const float PULSE_THRESHOLD = NOISE_FLOOR * pow(10,SNR_THRESHOLD/10);
-
-			bool pulseActive = false; // keeps track of whether pulse is active
-			bool pulseSaturated = false; // keeps track of whether pulse was ever saturated
-			std::uint32_t toa = 0; // this is sufficient as long as we don't ever record more than ~35 seconds of samples at 60 Msps in one buffer
-			double amp = 0;
-			std::vector<double> toaList;
-			std::vector<double> snrList;
-
-			// Loop through I/Q and generate PDWs
-			for(std::uint32_t jj = 0; jj < num_accum_samps; jj++)
+			// The noise floor is the median magnitude of the I/Q data rather than
+			// the mean, so the pulses in the dwell don't pull it up. Half of the
+			// previous dwells' history is kept so the estimate settles over time.
+			const std::uint64_t detectStart = readTsc();
+
+			noiseFloor.decay(0.5);
+			noiseFloor.update(iq.data(), num_accum_samps);
+			const float NOISE_FLOOR = noiseFloor.median();
+
+			// Find the leading and trailing edges of every pulse against a CFAR
+			// threshold so a noise floor that drifts during the dwell is followed.
+			// The buffer is thresholded in blocks that stay resident in cache.
+			// Pulses that run off the end of one block carry over into the next.
+			// Dwells aren't contiguous so the extractor starts fresh on each one.
+			pdws.clear();
+			pdwExtractor.startStream(dwellStartToa);
+
+			for (std::size_t blockStart = 0; blockStart < num_accum_samps; blockStart += CFAR_BLOCK_SIZE)
 			{
-				// Look for a leading edge
-				if (pulseActive == false)
+				const std::size_t blockLength = std::min<std::size_t>(CFAR_BLOCK_SIZE, num_accum_samps - blockStart);
+
+				cfar.computeThreshold(iq.data(), num_accum_samps, blockStart, blockLength, thresholdPower.data());
+				pdwExtractor.process(&iq(blockStart), blockLength, blockStart, thresholdPower.data(), NOISE_FLOOR, pdws);
+			}
+
+			traceSince("detect", detectStart);
+
+			if (pdwFile.isOpen())
+			{
+				const std::uint64_t writeStart = readTsc();
+
+				if (!pdwFile.write(pdws))
 				{
-					if (mag(jj) >= PULSE_THRESHOLD)
-					{
-						pulseActive = true; // a pulse is now active
-						toa = jj; // initialize the time of arrival to current index
-						pulseSaturated = false; // initialize whether the pulse was ever saturated
-						amp = mag(jj);
-					}
+					logAsync("Failed writing PDWs to {}, no more will be saved", pdwFilename);
 				}
-				else // Look for a trailing edge now that pulse is active
-				{
-					if (mag(jj) <= PULSE_THRESHOLD) // Declare a trailing edge
-					{
-						pulseActive = false; // the pulse is no longer active
 
-						// compute the UTC time of the time of arrival of the pulse
-						const double thisToa = (toa/fs);
-						toaList.push_back(thisToa);
+				writeTicks = readTsc() - writeStart;
+				metrics.write.record(writeTicks);
+				traceSince("write", writeStart);
+			}
 
-						// compute the amplitude as the mean magnitude over the entire pulse
-						amp /= (jj-toa);
+			// Separate out the emitters in this dwell and order the PDWs by
+			// emitter so each emitter's events are found on their own
+			const std::uint64_t deinterleaveStart = readTsc();
 
-						// compute the SNR for this pulse given the
-						// amplitude and noise floor for this channelizer bin
-						const double thisSnr = 10*log10(amp/NOISE_FLOOR);
-						snrList.push_back(thisSnr);
-					}
-					else // Otherwise we're still measuring a pulse
-					{
-						amp += mag(jj); // continue accumulating the magnitude of the pulse
+			deinterleaver.add(pdws, emitterIds);
+			deinterleaver.update(dspPool.get());
+			deinterleaver.relabel(pdws, emitterIds);
 
-						if (std::abs(iq(jj).real()) >= SAMP_MAX || std::abs(iq(jj).imag()) >= SAMP_MAX)
-						{
-							pulseSaturated = true;
-							saturated = true;
-						}
-					}
-				}
+			traceSince("deinterleave", deinterleaveStart);
+
+			pdwOrder.resize(pdws.size());
+
+			for (std::size_t ii = 0; ii < pdwOrder.size(); ii++)
+			{
+				pdwOrder[ii] = ii;
+
+				saturated |= pdws[ii].saturated;
 			}
 
-			// Now that we've generated the PDWs, let's go through and see if an
-			// event occurred
+			std::stable_sort(pdwOrder.begin(), pdwOrder.end(), [&](const std::size_t a, const std::size_t b) { return emitterIds[a] < emitterIds[b]; });
+
+			eventTrackIds.clear();
 
-			if (toaList.size() > 10)
+			for (std::size_t first = 0; first < pdwOrder.size();)
 			{
-				const double thisEventTime = get_event_peak_time(toaList, snrList) + meta.time_spec.get_real_secs();
-				std::cout << std::setprecision(15) << "Event was " << thisEventTime << std::endl;
-				eventTimeList.push_back(thisEventTime);
+				const std::uint32_t emitterId = emitterIds[pdwOrder[first]];
+				const std::size_t groupStart = first;
+				std::size_t last = first;
+
+				// Fit SNR vs. TOA to find the peak of this emitter's event, leaving
+				// out PDWs whose SNR is far off the parabola (e.g. a pulse that
+				// overlapped another emitter's)
+				eventToas.clear();
+				eventSnrs.clear();
 
-				if (eventTimeList.size() > 5)
+				for (; last < pdwOrder.size() && emitterIds[pdwOrder[last]] == emitterId; last++)
 				{
-					std::vector<double> diffEventList;
+					eventToas.push_back(pdws[pdwOrder[last]].toa);
+					eventSnrs.push_back(pdws[pdwOrder[last]].snrDb);
+				}
 
-					// Compute the difference list of event times
-					for (std::uint32_t kk = 1; kk < eventTimeList.size(); kk++)
-					{
-						diffEventList.push_back(eventTimeList[kk] - eventTimeList[kk-1]);
-					}
+				eventFit = QuadraticFit::robustFit(eventToas, eventSnrs);
 
-					// Compute the median time of the difference of event times
-					std::sort(std::execution::par_unseq, diffEventList.begin(), diffEventList.end());
+				first = last;
 
-					const double medDiffEvent = diffEventList[diffEventList.size()/2];
+				// Now see if an event occurred for this emitter
+
+				const double eventPeakToa = eventFit.peakTime(); // this represents the peak of the parabola as estimated by a quadratic polynomial fit
+
+				if (eventFit.size() > 10 && std::isfinite(eventPeakToa))
+				{
+					// The tracker schedules against the device clock, so it gets UTC
+					const double eventPeakTime = epochSec + eventPeakToa;
 
-					std::cout << "Median of diffEvent: " << medDiffEvent << std::endl;
+					logAsync("Emitter {} event was {}", emitterId, eventPeakTime);
 
-					nextEventTime = thisEventTime + medDiffEvent;
-					std::cout << std::setprecision(15) << "Next event will be " << nextEventTime << std::endl;
+					// How far the event reached either side of its peak, which is only
+					// a lower bound if its pulses ran up to either end of the dwell
+					const double firstToa = pdws[pdwOrder[groupStart]].toa;
+					const double lastToa = pdws[pdwOrder[last - 1]].toa;
+					const double eventHalfWidth = std::max(eventPeakToa - firstToa, lastToa - eventPeakToa);
+					const bool truncated = firstToa - dwellStartToa < MAX_PRI || dwellStartToa + num_accum_samps/fs - lastToa < MAX_PRI;
+
+					eventTracker.addEvent(emitterId, eventPeakTime, eventHalfWidth, truncated);
+					eventTrackIds.push_back(emitterId);
+
+					const double period = eventTracker.period(emitterId);
+
+					if (period > 0)
+					{
+						logAsync("Period of emitter {}: {} +/- {}", emitterId, period, eventTracker.periodSigma(emitterId));
+					}
+				}
+			}
+
+			// Tracks this dwell was scheduled for that didn't turn up lose confidence
+			for (const std::uint32_t trackId : dwell.trackIds)
+			{
+				if (std::find(eventTrackIds.begin(), eventTrackIds.end(), trackId) == eventTrackIds.end())
+				{
+					logAsync("Missed event of emitter {}", trackId);
+
+					eventTracker.missed(trackId);
 				}
 			}
 		}
 
+		metrics.process.record(readTsc() - processStart - writeTicks);
+		traceSince("process", processStart);
+		metrics.dwells++;
+
 		packet.numSamples = num_accum_samps;
-		packet.sampleStartTime = meta.time_spec.get_real_secs();
+		packet.sampleStartTime = dwellStartTime;
 
 		getFilenameStr(filenameStr);
 
@@ -393,9 +560,30 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
 	stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
 	rx_stream->issue_stream_cmd(stream_cmd);
 
+	flushAsyncLog();
+
 	std::cout << "Disabled RX" << std::endl;
 
+	if (pdwFile.isOpen())
+	{
+		if (pdwFile.close())
+		{
+			std::cout << "Saved " << pdwFile.size() << " PDWs to " << pdwFilename << std::endl;
+		}
+		else
+		{
+			std::cout << "Failed writing PDWs to " << pdwFilename << std::endl;
+		}
+	}
+
 	std::cout << "There were " << overrunCounter << " overruns." << std::endl;
 
+	metrics.printSummary();
+
+	if (traceOption != nullptr)
+	{
+		writeTrace(traceOption);
+	}
+
 	return status;
 }
@@ -3,8 +3,18 @@
 
 #include "IqPacket.h"
 #include "Helper.h"
-
+#include "EnergyGate.h"
+#include "DigitalDownconverter.h"
+#include "SharedIqRing.h"
+#include "BufferPool.h"
+#include "ThreadConfig.h"
+#include "PipelineMetrics.h"
+#include "PipelineTrace.h"
+#include "AsyncLog.h"
+
+#include <cmath>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <chrono>
 #include <complex>
@@ -21,10 +31,10 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
   char filenameStr[FILENAME_LENGTH];
   std::uint32_t overrunCounter = 0;
 
-  if (argc != 8)
+  if (countPositionalArgs(argc, argv) != 8)
   {
     std::cout << std::endl << "\tUsage:" << std::endl;
-    std::cout << "\t\t" << argv[0] << " <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec> <durationSec> <filter delay>" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <dwellSec> <durationSec> <filter delay> [--gate-snr-db=<dB>] [--ddc-offset-mhz=<MHz>] [--ddc-bw-mhz=<MHz>] [--shm=<name>] [--metrics=<file>] [--trace=<file>] [--rx-threads=<cpus>[:<priority>]]" << std::endl;
     std::cout << std::endl;
     return __LINE__;
   }
@@ -40,6 +50,23 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
   const float dwellDurationSec = atof(argv[5]);
   const float collectionDurationSec = atof(argv[6]);
   const std::int32_t FILTER_DELAY = atoi(argv[7]); // Number of initial zero'd samples induced by filter delay
+  const char* gateSnrOption = findOption(argc, argv, "gate-snr-db"); // Optionally only write dwells with a peak this far above the noise
+  const char* ddcOffsetOption = findOption(argc, argv, "ddc-offset-mhz"); // Center of the sub-band to record relative to the LO
+  const char* ddcBandwidthOption = findOption(argc, argv, "ddc-bw-mhz"); // Optionally record just a sub-band this wide
+  const char* shmOption = findOption(argc, argv, "shm"); // Optionally publish every dwell to local readers in this shared memory ring
+  const char* metricsOption = findOption(argc, argv, "metrics"); // Optionally export stage times and error counts to this Prometheus text file
+  const char* traceOption = findOption(argc, argv, "trace"); // Optionally record a timeline of every stage to this Chrome trace JSON file
+
+  // The receive thread does everything here. Placed before the device is
+  // opened so the library's own transfer threads start out placed the same.
+  ThreadConfig threads;
+
+  if (!parseThreadConfig(argc, argv, threads))
+  {
+    return __LINE__;
+  }
+
+  applyThreadPlacement("RX", threads.rx);
 
   //create a usrp device
 
@@ -174,13 +201,123 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
   // Precompute the filter delay in seconds
   const std::double_t filterDelaySecs = FILTER_DELAY*1.0/packet.sampleRateSps;
 
-  // Allocate the host buffer the device will be streaming to
+  // Optionally record just a sub-band of the stream instead of all of it,
+  // mixed down to DC and decimated. The sub-band is always written as 16-bit
+  // samples, with its own center frequency, bandwidth and sample rate.
+
+  const bool useDdc = (ddcBandwidthOption != nullptr);
+  const double ddcOffsetHz = (ddcOffsetOption != nullptr) ? atof(ddcOffsetOption)*1e6 : 0;
+  const double ddcBandwidthHz = useDdc ? atof(ddcBandwidthOption)*1e6 : DigitalDownconverter::maxBandwidth(packet.sampleRateSps);
+  const float DDC_OUTPUT_SCALE = 256; // 8-bit samples to 16-bit full scale
+
+  if (useDdc && (ddcBandwidthHz <= 0 || ddcBandwidthHz > DigitalDownconverter::maxBandwidth(packet.sampleRateSps) || std::abs(ddcOffsetHz) + ddcBandwidthHz/2 > packet.sampleRateSps/2.0))
+  {
+    std::cout << "Sub-band of " << ddcBandwidthHz*1e-6 << " MHz at " << ddcOffsetHz*1e-6 << " MHz doesn't fit in " << packet.sampleRateSps*1e-6 << " Msps" << std::endl;
+    return __LINE__;
+  }
+
+  DigitalDownconverter ddc(packet.sampleRateSps, ddcOffsetHz, ddcBandwidthHz, DDC_OUTPUT_SCALE);
 
-  std::complex<std::int8_t>* iq = new std::complex<std::int8_t>[requested_num_samples];
+  IqPacket ddcPacket = packet;
+  ddcPacket.frequencyHz = std::llround(packet.frequencyHz + ddc.offsetHz());
+  ddcPacket.bandwidthHz = ddcBandwidthHz;
+  ddcPacket.sampleRateSps = std::llround(ddc.outputSampleRate());
+  ddcPacket.bitWidth = 16; // signed 16-bit integer
+
+  BufferPool ddcPool(ddc.maxOutputSamples(requested_num_samples)*sizeof(std::complex<std::int16_t>), 1);
+  std::complex<std::int16_t>* ddcIq = useDdc ? ddcPool.acquire<std::complex<std::int16_t>>() : nullptr;
+
+  if (useDdc && ddcIq == nullptr)
+  {
+    return __LINE__;
+  }
+
+  if (useDdc)
+  {
+    std::cout << "Recording " << ddcPacket.bandwidthHz*1e-6 << " MHz at " << ddcPacket.frequencyHz*1e-6 << " MHz, " << ddcPacket.sampleRateSps*1e-6 << " Msps" << std::endl;
+  }
+
+  // Allocate the host buffer the device will be streaming to. It's on huge
+  // pages, faulted in up front, so the dwell isn't slowed by page faults.
+
+  BufferPool iqPool(requested_num_samples*sizeof(std::complex<std::int8_t>), 1);
+  std::complex<std::int8_t>* iq = iqPool.acquire<std::complex<std::int8_t>>();
+
+  if (iq == nullptr)
+  {
+    return __LINE__;
+  }
 
   const std::chrono::system_clock::time_point startTime = std::chrono::system_clock::now();
   std::chrono::system_clock::time_point currentTime = startTime;
 
+  // Every complete dwell is published as it comes in, written or not, for
+  // other processes to follow live
+
+  SharedIqRingWriter liveRing;
+
+  if (shmOption != nullptr)
+  {
+    // Big enough for two whole dwells, so a reader can take one while the
+    // next goes in
+    const std::uint64_t channelBytes = useDdc ? ddc.maxOutputSamples(requested_num_samples)*sizeof(std::complex<std::int16_t>) : requested_num_samples*sizeof(std::complex<std::int8_t>);
+    const std::uint32_t numSlots = SharedIqRingWriter::slotsForDwells(channelBytes, 1);
+
+    if (!liveRing.create(shmOption, numSlots))
+    {
+      return __LINE__;
+    }
+
+    std::cout << "Publishing dwells to shared memory " << shmOption << ", " << numSlots*(SHARED_IQ_SLOT_BYTES/1024)/1024 << " MB" << std::endl;
+  }
+
+  // Dwells holding nothing but noise aren't written when gating, but every
+  // dwell still gets a line in the summary so coverage can be audited
+  EnergyGate energyGate(gateSnrOption != nullptr ? atof(gateSnrOption) : 0);
+  std::ofstream gateSummary;
+  std::uint32_t dwellCounter = 0;
+  std::uint32_t writtenCounter = 0;
+
+  if (gateSnrOption != nullptr)
+  {
+    getFilenameStr(startTime, filenameStr, FILENAME_LENGTH, "csv");
+
+    gateSummary.open(filenameStr);
+    gateSummary << "sampleStartTime,noiseFloor,peak,peakSnrDb,noisePeakSnrDb,short,written" << std::endl;
+
+    std::cout << "Gating dwells at " << gateSnrOption << " dB, summary in " << filenameStr << std::endl;
+
+    // The peak is of single samples, so noise alone peaks this far above the floor
+    const float noisePeakSnrDb = EnergyGate::noisePeakSnrDb(useDdc ? ddc.maxOutputSamples(requested_num_samples - FILTER_DELAY) : requested_num_samples - FILTER_DELAY);
+
+    std::cout << "A dwell of pure noise peaks about " << noisePeakSnrDb << " dB above the noise floor" << std::endl;
+
+    if (atof(gateSnrOption) <= noisePeakSnrDb)
+    {
+      std::cout << "Warning: dwells of noise alone will pass a gate at " << gateSnrOption << " dB" << std::endl;
+    }
+  }
+
+  // Where each dwell's time goes, timed with the TSC
+  PipelineMetrics metrics("usrp_record_iq_08bit", dwellDurationSec);
+
+  if (metricsOption != nullptr && !metrics.startExport(metricsOption))
+  {
+    return __LINE__;
+  }
+
+  // Every stage of every dwell on a timeline, to see what else was going on
+  // around an overrun
+  if (traceOption != nullptr)
+  {
+    startTrace();
+    nameTraceThread("RX");
+  }
+
+  // Messages from the loop are written out on a background thread, so a
+  // slow console can't hold up a dwell
+  startAsyncLog();
+
   while(((currentTime - startTime) / std::chrono::milliseconds(1) * 1e-3) <= collectionDurationSec)
   {
     meta.reset();
@@ -188,6 +325,7 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
     stream_cmd.time_spec = uhd::time_spec_t(usrp->get_time_now().get_real_secs() + 100e-3);
 
     // Issue the command to get the samples we requested
+    const std::uint64_t recvStart = readTsc();
     rx_stream->issue_stream_cmd(stream_cmd);
 
     // Block until all of the samples are received
@@ -195,7 +333,11 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
     packet.numSamples -= FILTER_DELAY;
     packet.sampleStartTime = meta.time_spec.get_real_secs() + filterDelaySecs;
 
-    std::cout << "Received " << packet.numSamples << std::endl;
+    metrics.recv.recordSince(recvStart);
+    traceSince("recv", recvStart);
+    const std::uint64_t processStart = readTsc();
+
+    logAsync("Received {}", packet.numSamples);
 
     // Handle streaming error codes
     switch (meta.error_code)
@@ -204,36 +346,118 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
         break;
 
       case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT:
-        std::cout << "ERROR_CODE_TIMEOUT: Got timeout before all samples received" << std::endl;
+        logAsync("ERROR_CODE_TIMEOUT: Got timeout before all samples received");
+        metrics.timeouts++;
+        traceInstant("timeout");
         break;
 
       case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
         overrunCounter++;
-        std::cout << "ERROR_CODE_OVERFLOW: Overflowed" << std::endl;
+        metrics.overruns++;
+        traceInstant("overrun");
+        logAsync("ERROR_CODE_OVERFLOW: Overflowed");
         break;
 
       default:
-        std::cout << "Got error code: " << meta.strerror() << std::endl;
+        logAsync("Got error code: {}", meta.strerror());
         break;
     }
 
-    if (packet.numSamples == (requested_num_samples - FILTER_DELAY))
+    bool keepDwell = (packet.numSamples == (requested_num_samples - FILTER_DELAY));
+
+    if (!keepDwell)
+    {
+      metrics.shortReads++;
+    }
+
+    // Pull the sub-band out of the dwell, which is then what's gated and
+    // written. Dwells aren't contiguous so each starts the filters afresh.
+    if (keepDwell && useDdc)
+    {
+      TraceScope trace("channelize");
+
+      ddc.reset();
+      ddcPacket.numSamples = ddc.process(&iq[FILTER_DELAY], packet.numSamples, ddcIq);
+      ddcPacket.sampleStartTime = packet.sampleStartTime + ddc.outputTimeOffset()/packet.sampleRateSps;
+    }
+
+    if (keepDwell && shmOption != nullptr)
+    {
+      TraceScope trace("publish");
+
+      if (useDdc)
+      {
+        liveRing.publish(ddcPacket, ddcIq, ddcPacket.numSamples);
+      }
+      else
+      {
+        liveRing.publish(packet, &iq[FILTER_DELAY], packet.numSamples);
+      }
+    }
+
+    // A dwell cut short is never written, but still gets its line in the summary
+    if (!keepDwell && gateSnrOption != nullptr)
+    {
+      gateSummary << std::setprecision(15) << packet.sampleStartTime << ",,,,,1,0" << std::endl;
+    }
+    else if (gateSnrOption != nullptr)
     {
+      TraceScope trace("detect");
+
+      keepDwell = useDdc ? energyGate.process(ddcIq, ddcPacket.numSamples) : energyGate.process(&iq[FILTER_DELAY], packet.numSamples);
+
+      const std::size_t numGated = useDdc ? ddcPacket.numSamples : packet.numSamples;
+
+      gateSummary << std::setprecision(15) << packet.sampleStartTime << "," << energyGate.noiseFloor() << "," << energyGate.peak() << "," << energyGate.peakSnrDb() << "," << EnergyGate::noisePeakSnrDb(numGated) << ",0," << keepDwell << std::endl;
+    }
+
+    metrics.process.recordSince(processStart);
+    traceSince("process", processStart);
+    metrics.dwells++;
+
+    dwellCounter++;
+
+    if (keepDwell)
+    {
+      writtenCounter++;
+
+      const std::uint64_t writeStart = readTsc();
+
       getFilenameStr(currentTime, filenameStr, FILENAME_LENGTH);
 
       std::ofstream fout(filenameStr, std::ofstream::binary);
-      fout.write((const char*)&packet, sizeof(packet));
-      fout.write((const char*)&iq[FILTER_DELAY], (requested_num_samples-FILTER_DELAY)*sizeof(std::complex<std::int8_t>));
+
+      if (useDdc)
+      {
+        fout.write((const char*)&ddcPacket, sizeof(ddcPacket));
+        fout.write((const char*)ddcIq, ddcPacket.numSamples*sizeof(std::complex<std::int16_t>));
+      }
+      else
+      {
+        fout.write((const char*)&packet, sizeof(packet));
+        fout.write((const char*)&iq[FILTER_DELAY], (requested_num_samples-FILTER_DELAY)*sizeof(std::complex<std::int8_t>));
+      }
+
       fout.close();
+
+      metrics.write.recordSince(writeStart);
+      traceSince("write", writeStart);
     }
 
     currentTime = std::chrono::system_clock::now();
   }
 
+  flushAsyncLog();
+
   std::cout << "There were " << overrunCounter << " overruns." << std::endl;
+  std::cout << "Wrote " << writtenCounter << " of " << dwellCounter << " dwells." << std::endl;
+
+  metrics.printSummary();
 
-  // Free up the I/Q buffer we dynamically allocated
-  delete [] iq;
+  if (traceOption != nullptr)
+  {
+    writeTrace(traceOption);
+  }
 
   return status;
 }
@@ -0,0 +1,563 @@
+#include <uhd/utils/safe_main.hpp>
+#include <uhd/usrp/multi_usrp.hpp>
+
+#include "IqPacket.h"
+#include "Helper.h"
+#include "PreTriggerBuffer.h"
+#include "StreamingPdwExtractor.h"
+#include "NoiseFloorEstimator.h"
+#include "Deinterleaver.h"
+#include "QuadraticFit.h"
+#include "EventTracker.h"
+#include "ThreadPool.h"
+#include "ThreadConfig.h"
+#include "PipelineMetrics.h"
+#include "PipelineTrace.h"
+#include "AsyncLog.h"
+
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <complex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+const std::size_t BLOCK_SIZE = 65536; // samples received and searched for pulses at a time
+const float SAMP_MAX = 2047.0/2048; // full scale of the 12-bit samples over the wire
+const float SNR_THRESHOLD = 20; // dB
+const double NOISE_FLOOR_DECAY = 0.9; // weight kept of the noise floor history each block
+
+const double EMITTER_FREQ_TOLERANCE = 1e6; // Hz
+const double EMITTER_PW_TOLERANCE = 0.2; // fraction of the pulse width
+const double MAX_PRI = 10e-3; // sec
+const double PRI_RESOLUTION = 1e-6; // sec
+
+const double EVENT_GAP = 50e-3; // sec, an emitter quiet for this long has finished its event
+const std::size_t MIN_EVENT_PDWS = 10; // PDWs needed to fit the peak of an event
+const double MIN_EVENT_HALF_WIDTH = 1e-3; // sec, least a capture covers either side of a predicted event
+const double PREDICTION_SIGMAS = 3; // a capture covers this many sigma of the predicted event time
+const std::size_t MAX_QUEUED_CAPTURES = 4; // each up to half the ring
+
+// PDWs of one emitter since it was last quiet for EVENT_GAP
+struct EventBurst
+{
+  std::uint32_t emitterId;
+  std::vector<double> toas;
+  std::vector<double> snrs;
+  double firstToa;
+  double lastToa;
+};
+
+std::chrono::system_clock::time_point toTimePoint(const double utcSecs)
+{
+  return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(utcSecs)));
+}
+
+int UHD_SAFE_MAIN(int argc, char *argv[])
+{
+  std::int32_t status = EXIT_SUCCESS;
+  uhd::rx_metadata_t meta;
+  std::string device_args("");
+  std::string subdev("A:A");
+  std::string ant("RX2");
+  std::string ref("internal");
+  IqPacket packet;
+  std::uint32_t overrunCounter = 0;
+
+  const int numPositionalArgs = countPositionalArgs(argc, argv);
+
+  if (numPositionalArgs < 8 || numPositionalArgs > 10)
+  {
+    std::cout << std::endl << "\tUsage:" << std::endl;
+    std::cout << "\t\t" << argv[0] << " <freqMhz> <bwMhz> <sampleRateMsps> <gainDb> <bufferSec> <durationSec> <energy|event> [preTriggerSec] [postTriggerSec] [--metrics=<file>] [--trace=<file>] [--rx-threads=<cpus>[:<priority>]] [--dsp-threads=<cpus>[:<priority>]] [--writer-threads=<cpus>[:<priority>]]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\tStreams continuously into a ring buffer of the last bufferSec seconds" << std::endl;
+    std::cout << "\tand only writes the samples around a trigger to disk. The energy" << std::endl;
+    std::cout << "\ttrigger fires on every pulse detected; the event trigger fires on" << std::endl;
+    std::cout << "\tthe predicted events of each emitter once its period is known." << std::endl;
+    std::cout << std::endl;
+    return __LINE__;
+  }
+
+  const std::uint64_t requestedFrequencyHz = atof(argv[1])*1e6;
+  std::uint64_t receivedFrequencyHz = 0;
+  const std::uint32_t requestedBandwidthHz = atof(argv[2])*1e6;
+  std::uint32_t receivedBandwidthHz = 0;
+  const std::uint32_t requestedSampleRateSps = atof(argv[3])*1e6;
+  std::uint32_t receivedSampleRateSps = 0;
+  const float requestedRxGainDb = atof(argv[4]);
+  float receivedRxGainDb = 0;
+  const float bufferDurationSec = atof(argv[5]);
+  const float collectionDurationSec = atof(argv[6]);
+  const std::string triggerMode = argv[7];
+  const float preTriggerSec = (numPositionalArgs > 8) ? atof(argv[8]) : 10e-3;
+  const float postTriggerSec = (numPositionalArgs > 9) ? atof(argv[9]) : 10e-3;
+
+  const bool eventTrigger = (triggerMode == "event");
+
+  if (!eventTrigger && triggerMode != "energy")
+  {
+    std::cout << "Unknown trigger: " << triggerMode << std::endl;
+    return __LINE__;
+  }
+
+  // Placed before the device is made so UHD's own threads start out on the
+  // receive CPUs too
+  ThreadConfig threads;
+
+  if (!parseThreadConfig(argc, argv, threads))
+  {
+    return __LINE__;
+  }
+
+  applyThreadPlacement("RX", threads.rx);
+
+  //create a usrp device
+  uhd::usrp::multi_usrp::sptr usrp = uhd::usrp::multi_usrp::make(device_args);
+
+  // Save off information about the device being used
+
+  const std::string boardName = usrp->get_mboard_name();
+  strncpy(packet.boardName, boardName.c_str(), sizeof(packet.boardName) - 1);
+  std::cout << "Board Name: " << packet.boardName << std::endl;
+
+  uhd::dict<std::string, std::string> rx_info = usrp->get_usrp_rx_info();
+
+  const std::string serialNumber = rx_info.get("mboard_serial");
+  strncpy(packet.serialNumber, serialNumber.c_str(), sizeof(packet.serialNumber) - 1);
+  std::cout << "Serial Number: " << packet.serialNumber << std::endl;
+
+  uhd::device::sptr dev = usrp->get_device();
+  uhd::property_tree::sptr tree = dev->get_tree();
+  const uhd::fs_path& path = "/mboards/0/";
+
+  const std::string fpgaVersion = tree->access<std::string>(path / "fpga_version").get();
+  strncpy(packet.fpgaVersion, fpgaVersion.c_str(), sizeof(packet.fpgaVersion) - 1);
+  std::cout << "FPGA Version: " << packet.fpgaVersion << std::endl;
+
+  const std::string fwVersion = tree->access<std::string>(path / "fw_version").get();
+  strncpy(packet.fwVersion, fwVersion.c_str(), sizeof(packet.fwVersion) - 1);
+  std::cout << "FW Version: " << packet.fwVersion << std::endl;
+
+  // Lock mboard clocks
+  usrp->set_clock_source(ref);
+
+  //always select the subdevice first, the channel mapping affects the other settings
+  usrp->set_rx_subdev_spec(subdev);
+
+  std::cout << "Number of RX channels: " << usrp->get_rx_num_channels() << std::endl;
+
+  // Set the time on the device
+  const double timeInSecs = std::chrono::system_clock::now().time_since_epoch() / std::chrono::nanoseconds(1) * 1e-9;
+  usrp->set_time_now(uhd::time_spec_t(timeInSecs));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // create a receive streamer
+  uhd::stream_args_t stream_args("sc16","sc12"); // 16-bit integers on host, 12-bit integers over-the-wire
+  uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(stream_args);
+
+  // Set sample rate of device
+  usrp->set_rx_rate(requestedSampleRateSps);
+  receivedSampleRateSps = usrp->get_rx_rate();
+  std::cout << "Sample Rate = " << receivedSampleRateSps*1e-6 << " Msps\n";
+
+  // Set analog bandwidth of device
+  usrp->set_rx_bandwidth(requestedBandwidthHz);
+  receivedBandwidthHz = usrp->get_rx_bandwidth();
+  std::cout << "Bandwidth = " << receivedBandwidthHz*1e-6 << " MHz\n";
+
+  // Disable automatic gain control
+  usrp->set_rx_agc(false);
+  std::cout << "Disabled automatic gain control" << std::endl;
+
+  // Set gain of the device
+  usrp->set_rx_gain(requestedRxGainDb);
+  receivedRxGainDb = usrp->get_rx_gain();
+  std::cout << "Gain = " << receivedRxGainDb << " dB\n";
+
+  usrp->set_rx_antenna(ant);
+  std::cout << "Antenna = " << usrp->get_rx_antenna() << "\n";
+
+  std::cout << std::endl;
+
+  usrp->clear_command_time();
+
+  usrp->set_command_time(usrp->get_time_now() + uhd::time_spec_t(0.1)); //set cmd time for .1s in the future
+
+  // Set center frequency of device
+  uhd::tune_request_t tune_request(requestedFrequencyHz);
+  usrp->set_rx_freq(tune_request);
+  std::this_thread::sleep_for(std::chrono::milliseconds(110)); //sleep 110ms (~10ms after retune occurs) to allow LO to lock
+
+  usrp->clear_command_time();
+
+  // Get the frequency we're tuned to in case it differs from the one we requested
+  receivedFrequencyHz = usrp->get_rx_freq();
+  std::cout << "Frequency = " << receivedFrequencyHz*1e-6 << " MHz" << std::endl;
+
+  // Specify the endianness of the recording
+
+  if constexpr (std::endian::native == std::endian::big)
+  {
+    packet.endianness = 0x00000000;
+  }
+  else if constexpr (std::endian::native == std::endian::little)
+  {
+    packet.endianness = 0x03030303;
+  }
+  else
+  {
+    packet.endianness = 0xFFFFFFFF;
+  }
+
+  // Set information about the recording for data analysis purposes
+
+  packet.frequencyHz = receivedFrequencyHz;
+  packet.bandwidthHz = receivedBandwidthHz;
+  packet.sampleRateSps = receivedSampleRateSps;
+  packet.rxGainDb = receivedRxGainDb;
+  packet.bitWidth = 16; // signed 16-bit integer
+
+  const double fs = receivedSampleRateSps;
+
+  // The ring holds the last bufferSec of samples. Captures are written on
+  // their own thread so a slow disk never holds up the receive loop, from
+  // MAX_QUEUED_CAPTURES blocks allocated now; if the writer has all of them
+  // when another capture completes, that one is dropped.
+  PreTriggerBuffer buffer(bufferDurationSec*fs, preTriggerSec*fs, postTriggerSec*fs, MAX_QUEUED_CAPTURES);
+  PipelineMetrics metrics("usrp_record_triggered", BLOCK_SIZE/fs); // a block is the dwell here
+  const char* traceOption = findOption(argc, argv, "trace"); // Optionally record a timeline of every stage to this Chrome trace JSON file
+
+  // Started before the writer and DSP threads so they get their events up front too
+  if (traceOption != nullptr)
+  {
+    startTrace();
+    nameTraceThread("RX");
+  }
+
+  ThreadPool writer(1, [&threads] { nameTraceThread("Writer", TRACE_POOL_EVENTS); applyThreadPlacement("Writer", threads.writer); });
+  Capture capture;
+  std::uint64_t samplesStreamed = 0;
+  std::uint64_t samplesWritten = 0;
+  std::uint64_t capturesWritten = 0;
+  std::atomic<std::uint64_t> failedWrites(0);
+
+  std::vector<std::complex<std::int16_t>> iq(BLOCK_SIZE);
+  std::vector<std::complex<float>> iqFloat(BLOCK_SIZE);
+  NoiseFloorEstimator noiseFloor;
+  StreamingPdwExtractor pdwExtractor(fs, receivedFrequencyHz, SAMP_MAX);
+  std::vector<Pdw> pdws;
+
+  Deinterleaver deinterleaver(EMITTER_FREQ_TOLERANCE, EMITTER_PW_TOLERANCE, MAX_PRI, PRI_RESOLUTION);
+  std::vector<std::uint32_t> emitterIds;
+
+  // Given DSP CPUs the emitter searches run on them instead of the receive thread
+  std::unique_ptr<ThreadPool> dspPool;
+
+  if (eventTrigger && findOption(argc, argv, "dsp-threads") != nullptr)
+  {
+    dspPool = std::make_unique<ThreadPool>(threads.dsp.cpus.empty() ? std::thread::hardware_concurrency() : threads.dsp.cpus.size(), [&threads] { nameTraceThread("DSP", TRACE_POOL_EVENTS); applyThreadPlacement("DSP", threads.dsp); });
+  }
+
+  std::vector<EventBurst> bursts;
+  EventTracker eventTracker;
+  std::vector<EventPrediction> predictions;
+  std::vector<EventPrediction> awaiting; // predicted events captured but not yet seen
+
+  // Stream times, PDW TOAs and events are kept from this second rather than
+  // as absolute UTC, which a double only resolves to 238 ns
+  const std::uint32_t epochSec = std::chrono::system_clock::now().time_since_epoch() / std::chrono::seconds(1);
+  double streamStartTime = 0; // time of stream index 0 of the buffer from the epoch
+  bool restartStream = true;
+
+  // Write out every capture the buffer has finished with
+  auto writeCaptures = [&]()
+  {
+    while (buffer.pop(capture))
+    {
+      const double captureStartTime = epochSec + (streamStartTime + capture.startIndex/fs);
+
+      IqPacket header = packet;
+      header.numSamples = capture.numSamples;
+      header.sampleStartTime = captureStartTime;
+
+      samplesWritten += capture.numSamples;
+      capturesWritten++;
+
+      writer.submit([header, capture, &buffer, &metrics, &failedWrites]()
+      {
+        const std::uint64_t writeStart = readTsc();
+        char filenameStr[FILENAME_LENGTH];
+        getFilenameStr(toTimePoint(header.sampleStartTime), filenameStr, FILENAME_LENGTH);
+
+        std::ofstream fout(filenameStr, std::ofstream::binary);
+        fout.write((const char*)&header, sizeof(header));
+        fout.write((const char*)capture.iq, capture.numSamples*sizeof(std::complex<std::int16_t>));
+        fout.close();
+
+        buffer.release(capture);
+
+        if (!fout)
+        {
+          failedWrites++;
+          logAsync("Failed writing capture to {}", filenameStr);
+        }
+
+        metrics.write.recordSince(writeStart);
+        traceSince("write", writeStart);
+      });
+    }
+  };
+
+  const char* metricsOption = findOption(argc, argv, "metrics"); // Optionally export stage times and error counts to this Prometheus text file
+
+  if (metricsOption != nullptr && !metrics.startExport(metricsOption))
+  {
+    return __LINE__;
+  }
+
+  // setup streaming
+  uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+  stream_cmd.stream_now = false;
+  stream_cmd.time_spec  = uhd::time_spec_t(usrp->get_time_now().get_real_secs() + 100e-3);
+
+  rx_stream->issue_stream_cmd(stream_cmd);
+
+  const std::chrono::system_clock::time_point startTime = std::chrono::system_clock::now();
+  std::chrono::system_clock::time_point currentTime = startTime;
+
+  // Messages from the loop are written out on a background thread, so a
+  // slow console can't hold up a dwell
+  startAsyncLog();
+
+  while(((currentTime - startTime) / std::chrono::milliseconds(1) * 1e-3) <= collectionDurationSec)
+  {
+    const std::uint64_t recvStart = readTsc();
+    const std::size_t numSamples = rx_stream->recv(iq.data(), BLOCK_SIZE, meta, 1.0);
+
+    metrics.recv.recordSince(recvStart);
+    traceSince("recv", recvStart);
+    const std::uint64_t processStart = readTsc();
+
+    currentTime = std::chrono::system_clock::now();
+
+    // Handle streaming error codes
+    switch (meta.error_code)
+    {
+      case uhd::rx_metadata_t::ERROR_CODE_NONE:
+        break;
+
+      case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT:
+        logAsync("ERROR_CODE_TIMEOUT: Got timeout before all samples received");
+        metrics.timeouts++;
+        traceInstant("timeout");
+        break;
+
+      case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+        overrunCounter++;
+        metrics.overruns++;
+        traceInstant("overrun");
+        logAsync("ERROR_CODE_OVERFLOW: Overflowed");
+        // Samples were dropped so the stream has to start over at the next
+        // block's time
+        restartStream = true;
+        break;
+
+      default:
+        logAsync("Got error code: {}", meta.strerror());
+        restartStream = true;
+        break;
+    }
+
+    if (numSamples < BLOCK_SIZE)
+    {
+      metrics.shortReads++;
+    }
+
+    if (numSamples == 0)
+    {
+      continue;
+    }
+
+    if (restartStream)
+    {
+      // Captures still waiting are cut short at the gap, and written with the
+      // old stream's time
+      buffer.reset();
+      writeCaptures();
+
+      streamStartTime = (meta.time_spec.get_full_secs() - epochSec) + meta.time_spec.get_frac_secs();
+      restartStream = false;
+
+      pdwExtractor.startStream(streamStartTime);
+    }
+
+    const std::uint64_t blockStartIndex = buffer.samplesWritten();
+    const double blockStartTime = streamStartTime + blockStartIndex/fs;
+    const double blockEndTime = blockStartTime + numSamples/fs;
+
+    const std::uint64_t bufferStart = readTsc();
+
+    buffer.write(iq.data(), numSamples);
+
+    traceSince("buffer", bufferStart);
+    samplesStreamed += numSamples;
+
+    // Find the pulses in this block against a threshold SNR_THRESHOLD above
+    // the recent noise floor. Pulses running off the end of the block carry
+    // over to the next one.
+    const std::uint64_t convertStart = readTsc();
+
+    for (std::size_t ii = 0; ii < numSamples; ii++)
+    {
+      iqFloat[ii] = std::complex<float>(iq[ii].real(), iq[ii].imag())*(1.0f/32768);
+    }
+
+    traceSince("convert", convertStart);
+    const std::uint64_t detectStart = readTsc();
+
+    noiseFloor.decay(NOISE_FLOOR_DECAY);
+    noiseFloor.update(iqFloat.data(), numSamples);
+
+    const float NOISE_FLOOR = noiseFloor.median();
+    const float thresholdMagnitude = NOISE_FLOOR*std::pow(10.0f, SNR_THRESHOLD/10);
+
+    pdws.clear();
+    pdwExtractor.process(iqFloat.data(), numSamples, blockStartIndex, thresholdMagnitude*thresholdMagnitude, NOISE_FLOOR, pdws);
+
+    traceSince("detect", detectStart);
+
+    if (!eventTrigger)
+    {
+      for (const Pdw &pdw : pdws)
+      {
+        buffer.trigger(std::llround((pdw.toa - streamStartTime)*fs));
+      }
+    }
+    else
+    {
+      // Follow the events of each emitter the same way usrp_predict_event
+      // does, only over a continuous stream: an event is the run of an
+      // emitter's PDWs up to the point it goes quiet, and its time is the
+      // peak of the SNR fit over the run
+      const std::uint64_t deinterleaveStart = readTsc();
+
+      deinterleaver.add(pdws, emitterIds);
+      deinterleaver.update(dspPool.get());
+      deinterleaver.relabel(pdws, emitterIds);
+
+      traceSince("deinterleave", deinterleaveStart);
+
+      for (std::size_t ii = 0; ii < pdws.size(); ii++)
+      {
+        auto burst = std::find_if(bursts.begin(), bursts.end(), [&](const EventBurst &b) { return b.emitterId == emitterIds[ii]; });
+
+        if (burst == bursts.end())
+        {
+          bursts.push_back({emitterIds[ii], {}, {}, pdws[ii].toa, pdws[ii].toa});
+          burst = bursts.end() - 1;
+        }
+
+        burst->toas.push_back(pdws[ii].toa);
+        burst->snrs.push_back(pdws[ii].snrDb);
+        burst->lastToa = pdws[ii].toa;
+      }
+
+      for (auto burst = bursts.begin(); burst != bursts.end();)
+      {
+        if (blockEndTime - burst->lastToa < EVENT_GAP)
+        {
+          burst++;
+          continue;
+        }
+
+        // Leave out PDWs whose SNR is far off the parabola, e.g. pulses that
+        // overlapped another emitter's
+        const QuadraticFit fit = QuadraticFit::robustFit(burst->toas, burst->snrs);
+        const double eventPeakTime = fit.peakTime();
+
+        if (fit.size() > MIN_EVENT_PDWS && std::isfinite(eventPeakTime))
+        {
+          logAsync("Emitter {} event was {}", burst->emitterId, epochSec + eventPeakTime);
+
+          eventTracker.addEvent(burst->emitterId, eventPeakTime, std::max(eventPeakTime - burst->firstToa, burst->lastToa - eventPeakTime));
+
+          awaiting.erase(std::remove_if(awaiting.begin(), awaiting.end(), [&](const EventPrediction &p) { return p.trackId == burst->emitterId && std::abs(eventPeakTime - p.time) <= p.halfWidthSec; }), awaiting.end());
+        }
+
+        burst = bursts.erase(burst);
+      }
+
+      // Predicted events that came and went without being seen
+      for (auto prediction = awaiting.begin(); prediction != awaiting.end();)
+      {
+        if (blockEndTime > prediction->time + prediction->halfWidthSec + EVENT_GAP)
+        {
+          logAsync("Missed event of emitter {}", prediction->trackId);
+
+          eventTracker.missed(prediction->trackId);
+          prediction = awaiting.erase(prediction);
+        }
+        else
+        {
+          prediction++;
+        }
+      }
+
+      // Trigger on each predicted event while its window is still ahead of
+      // us, in the last block before it opens so each is triggered once
+      predictions.clear();
+      eventTracker.predict(blockEndTime, MIN_EVENT_HALF_WIDTH, PREDICTION_SIGMAS, predictions);
+
+      for (const EventPrediction &prediction : predictions)
+      {
+        if (prediction.time - prediction.halfWidthSec < blockEndTime + numSamples/fs)
+        {
+          const std::size_t halfWidthSamples = prediction.halfWidthSec*fs;
+
+          buffer.trigger(std::llround((prediction.time - streamStartTime)*fs), halfWidthSamples + preTriggerSec*fs, halfWidthSamples + postTriggerSec*fs);
+          awaiting.push_back(prediction);
+        }
+      }
+    }
+
+    writeCaptures();
+
+    metrics.process.recordSince(processStart);
+    traceSince("process", processStart);
+    metrics.dwells++;
+  }
+
+  stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
+  rx_stream->issue_stream_cmd(stream_cmd);
+
+  // Write whatever is left of the captures still waiting for samples
+  buffer.reset();
+  writeCaptures();
+  writer.wait();
+
+  flushAsyncLog();
+
+  std::cout << "There were " << overrunCounter << " overruns." << std::endl;
+  std::cout << "Wrote " << capturesWritten << " captures, " << samplesWritten << " of " << samplesStreamed << " samples";
+  std::cout << " (" << (samplesStreamed > 0 ? 100.0*samplesWritten/samplesStreamed : 0) << "%)" << std::endl;
+  std::cout << buffer.capturesDropped() << " captures dropped with the writer behind, " << failedWrites << " failed to write" << std::endl;
+
+  metrics.printSummary();
+
+  if (traceOption != nullptr)
+  {
+    writeTrace(traceOption);
+  }
+
+  return status;
+}
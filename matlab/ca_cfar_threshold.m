@@ -0,0 +1,21 @@
+function [threshold, noise] = ca_cfar_threshold(mag, trainingCells, guardCells, snrThresholdDb)
+% Cell averaging CFAR threshold for every sample of mag. The noise power of
+% each cell under test is the mean power of trainingCells samples on either
+% side of it, skipping guardCells samples next to it so a pulse doesn't
+% raise its own threshold. Works down each column, so a matrix of
+% channelized data (samples x bins) gets a threshold per bin.
+%
+% threshold and noise are magnitudes, like mag, so they can be compared
+% against mag directly. Cells that fall off either end are left out.
+
+power = abs(mag).^2;
+reach = guardCells + trainingCells;
+
+% movsum shrinks the window at the ends, so subtracting the guard region
+% from the whole region leaves just the reference cells on both sides
+referenceSum = movsum(power, [reach reach]) - movsum(power, [guardCells guardCells]);
+referenceCount = movsum(ones(size(power)), [reach reach]) - movsum(ones(size(power)), [guardCells guardCells]);
+
+noise = sqrt(referenceSum ./ referenceCount);
+threshold = noise * 10^(snrThresholdDb/10);
+end
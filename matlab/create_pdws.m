@@ -43,8 +43,13 @@ for ii = 1:length(listing)
         % statistic".
         NOISE_FLOOR = median(mag);
         SNR_THRESHOLD = 18 % dB
-        PULSE_THRESHOLD = NOISE_FLOOR*10^(SNR_THRESHOLD/10)
-        TRAILING_EDGE_THRESHOLD = NOISE_FLOOR*10^(3/10)
+
+        % Use a sliding CFAR threshold rather than one global threshold so a
+        % noise floor that drifts during the recording is followed
+        CFAR_TRAINING_CELLS = round(fs*300e-6);
+        CFAR_GUARD_CELLS = round(fs*300e-6); % must be longer than the longest pulse expected
+        [PULSE_THRESHOLD, CFAR_NOISE] = ca_cfar_threshold(mag, CFAR_TRAINING_CELLS, CFAR_GUARD_CELLS, SNR_THRESHOLD);
+        TRAILING_EDGE_THRESHOLD = CFAR_NOISE*10^(3/10);
 
         fprintf('%s - Generating PDWs\n', datetime)
 
@@ -54,13 +59,13 @@ for ii = 1:length(listing)
         for jj = 1:length(iq)
             % Look for a leading edge
             if ~pulseActive
-                if mag(jj) >= PULSE_THRESHOLD
+                if mag(jj) >= PULSE_THRESHOLD(jj)
                     pulseActive = true; % a pulse is now active
                     toa = jj; % initialize the time of arrival to current index
                     saturated = false; % initialize whether the pulse was ever saturated
                 end
             else % Look for a trailing edge now that pulse is active
-                if mag(jj) <= TRAILING_EDGE_THRESHOLD % Declare a trailing edge
+                if mag(jj) <= TRAILING_EDGE_THRESHOLD(jj) % Declare a trailing edge
                     pulseActive = false; % the pulse is no longer active
 
                     % compute the UTC time of the time of arrival of the pulse
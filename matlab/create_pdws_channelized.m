@@ -72,7 +72,12 @@ for ii = 1:length(listing)
         % statistic".
         NOISE_FLOOR = median(mag);
         SNR_THRESHOLD = 15 % dB
-        PULSE_THRESHOLD = NOISE_FLOOR*10^(SNR_THRESHOLD/10)
+
+        % Use a sliding CFAR threshold per bin rather than one threshold per
+        % bin so a noise floor that drifts during the recording is followed
+        CFAR_TRAINING_CELLS = round(fs*300e-6);
+        CFAR_GUARD_CELLS = round(fs*300e-6); % must be longer than the longest pulse expected
+        PULSE_THRESHOLD = ca_cfar_threshold(mag, CFAR_TRAINING_CELLS, CFAR_GUARD_CELLS, SNR_THRESHOLD);
 
         fprintf('%s - Generating PDWs\n', datetime)
 
@@ -85,13 +90,13 @@ for ii = 1:length(listing)
             for jj = 1:size(iq,1)
                 % Look for a leading edge
                 if ~pulseActive
-                    if mag(jj,bin) >= PULSE_THRESHOLD(bin)
+                    if mag(jj,bin) >= PULSE_THRESHOLD(jj,bin)
                         pulseActive = true; % a pulse is now active
                         toa = jj; % initialize the time of arrival to current index
                         saturated = false; % initialize whether the pulse was ever saturated
                     end
                 else % Look for a trailing edge now that pulse is active
-                    if mag(jj,bin) <= PULSE_THRESHOLD(bin) % Declare a trailing edge
+                    if mag(jj,bin) <= PULSE_THRESHOLD(jj,bin) % Declare a trailing edge
                         pulseActive = false; % the pulse is no longer active
 
                         % compute the UTC time of the time of arrival of the pulse
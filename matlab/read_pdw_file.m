@@ -0,0 +1,151 @@
+function pdw = read_pdw_file(filename, toaRange, freqRange)
+% Read PDWs written by PdwFileWriter (cpp/PdwFile.h) into the same pdw
+% struct the create_pdws scripts build. TOAs are seconds from the file's
+% epoch, a whole UTC second returned in pdw.epochSec; pdw.d holds the UTC
+% time of each PDW. toaRange ([min max] seconds from the epoch) and
+% freqRange ([min max] Hz) are optional; blocks whose extents fall outside
+% them are skipped without reading their columns.
+
+if nargin < 2 || isempty(toaRange)
+    toaRange = [-inf inf];
+end
+
+if nargin < 3 || isempty(freqRange)
+    freqRange = [-inf inf];
+end
+
+PDW_FILE_MAGIC = uint32(hex2dec('31574450'));
+PDW_INDEX_MAGIC = uint32(hex2dec('49574450'));
+BLOCK_HEADER_BYTES = 40;
+INDEX_ENTRY_BYTES = 48;
+TRAILER_BYTES = 32;
+
+[fid, message] = fopen(filename, 'r', 'l');
+
+if fid < 0
+    error('Could not open %s: %s', filename, message)
+end
+
+magic = fread(fid, 1, 'uint32=>uint32');
+version = fread(fid, 1, 'uint32=>double');
+fread(fid, 1, 'uint32=>uint32'); % block capacity
+epochSec = fread(fid, 1, 'uint32=>double');
+
+% TOAs only became relative to epochSec in version 3
+if version < 3
+    epochSec = 0;
+end
+
+if magic ~= PDW_FILE_MAGIC
+    fclose(fid);
+    error('%s is not a PDW file', filename)
+end
+
+% Find the block headers, either from the index at the end of the file or
+% by walking the blocks if the writer never got to write the index
+fseek(fid, 0, 'eof');
+fileSize = ftell(fid);
+
+offsets = [];
+headers = [];
+
+fseek(fid, fileSize - TRAILER_BYTES, 'bof');
+indexOffset = fread(fid, 1, 'uint64=>double');
+numBlocks = fread(fid, 1, 'uint64=>double');
+fread(fid, 1, 'uint64=>double'); % number of PDWs
+indexMagic = fread(fid, 1, 'uint32=>uint32');
+
+if indexMagic == PDW_INDEX_MAGIC && indexOffset + numBlocks*INDEX_ENTRY_BYTES + TRAILER_BYTES == fileSize
+    for ii = 1:numBlocks
+        fseek(fid, indexOffset + (ii-1)*INDEX_ENTRY_BYTES, 'bof');
+        offsets(ii) = fread(fid, 1, 'uint64=>double');
+        headers(ii,:) = read_block_header(fid);
+    end
+else
+    offset = 16;
+
+    while offset + BLOCK_HEADER_BYTES <= fileSize
+        fseek(fid, offset, 'bof');
+        header = read_block_header(fid);
+
+        if header(1) == 0 || offset + header(2) > fileSize
+            break
+        end
+
+        offsets(end+1) = offset;
+        headers(end+1,:) = header;
+        offset = offset + header(2);
+    end
+end
+
+pdw.toa = [];
+pdw.freq = [];
+pdw.pw = [];
+pdw.snr = [];
+pdw.mag = [];
+pdw.bin = [];
+pdw.sat = [];
+pdw.chirp = [];
+pdw.mod = [];
+pdw.chips = [];
+
+for ii = 1:length(offsets)
+    n = headers(ii,1);
+
+    % Skip blocks that can't hold anything in the requested ranges
+    if headers(ii,4) < toaRange(1) || headers(ii,3) > toaRange(2) || headers(ii,6) < freqRange(1) || headers(ii,5) > freqRange(2)
+        continue
+    end
+
+    fseek(fid, offsets(ii) + BLOCK_HEADER_BYTES, 'bof');
+    toa = fread(fid, n, 'double');
+    freq = fread(fid, n, 'double');
+    pw = fread(fid, n, 'single=>double');
+    snr = fread(fid, n, 'single=>double');
+    mag = fread(fid, n, 'single=>double');
+
+    % Version 1 files predate the intrapulse columns
+    if version >= 2
+        chirp = fread(fid, n, 'single=>double');
+    else
+        chirp = zeros(n,1);
+    end
+
+    bin = fread(fid, n, 'uint16=>double');
+    sat = fread(fid, n, 'uint8=>logical');
+
+    if version >= 2
+        mod = fread(fid, n, 'uint8=>double'); % 0 unmodulated, 1 LFM, 2 Barker, 3 other phase code
+        chips = fread(fid, n, 'uint8=>double');
+    else
+        mod = zeros(n,1);
+        chips = zeros(n,1);
+    end
+
+    keep = toa >= toaRange(1) & toa <= toaRange(2) & freq >= freqRange(1) & freq <= freqRange(2);
+
+    pdw.toa = [pdw.toa; toa(keep)];
+    pdw.freq = [pdw.freq; freq(keep)];
+    pdw.pw = [pdw.pw; pw(keep)];
+    pdw.snr = [pdw.snr; snr(keep)];
+    pdw.mag = [pdw.mag; mag(keep)];
+    pdw.bin = [pdw.bin; bin(keep)];
+    pdw.sat = [pdw.sat; sat(keep)];
+    pdw.chirp = [pdw.chirp; chirp(keep)];
+    pdw.mod = [pdw.mod; mod(keep)];
+    pdw.chips = [pdw.chips; chips(keep)];
+end
+
+fclose(fid);
+
+pdw.sat = pdw.sat == 1;
+pdw.epochSec = epochSec;
+pdw.d = datetime(1970,1,1,0,0,epochSec) + seconds(pdw.toa);
+end
+
+function header = read_block_header(fid)
+% [numPdws blockBytes minToa maxToa minFreqHz maxFreqHz]
+counts = fread(fid, 2, 'uint32=>double');
+extents = fread(fid, 4, 'double');
+header = [counts' extents'];
+end